@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Profiles and rules of the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "config.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "fn_input.hpp"
+
+namespace opengigabyte {
+
+namespace {
+
+const char *const kTriggers[] = { "ac", "battery", "thermal" };
+
+bool valid_trigger(const std::string &name)
+{
+	for (const char *t : kTriggers)
+		if (name == t)
+			return true;
+	return key_code(name) != 0;
+}
+
+/* Relative to /sys and never escaping it */
+bool valid_path(const std::string &path)
+{
+	return !path.empty() && path[0] != '/' && path.find("..") == std::string::npos;
+}
+
+} // namespace
+
+const Profile *Config::find_profile(const std::string &name) const
+{
+	for (const Profile &p : profiles)
+		if (p.name == name)
+			return &p;
+	return nullptr;
+}
+
+const std::vector<Action> *Config::find_rules(const std::string &trigger) const
+{
+	auto it = rules.find(trigger);
+
+	return it == rules.end() ? nullptr : &it->second;
+}
+
+Config load_config(const std::string &path)
+{
+	std::ifstream in(path);
+	std::string line;
+	unsigned int lineno = 0;
+	Config cfg;
+
+	if (!in)
+		throw std::runtime_error(path + ": cannot open");
+
+	auto fail = [&](const std::string &msg) {
+		return std::runtime_error(path + ":" + std::to_string(lineno) + ": " + msg);
+	};
+
+	while (std::getline(in, line)) {
+		std::istringstream words(line.substr(0, line.find('#')));
+		std::string keyword;
+
+		lineno++;
+		if (!(words >> keyword))
+			continue;
+
+		if (keyword == "profile") {
+			Profile profile;
+			std::string setting;
+
+			if (!(words >> profile.name))
+				throw fail("profile needs a name");
+			if (cfg.find_profile(profile.name))
+				throw fail("duplicate profile " + profile.name);
+			while (words >> setting) {
+				std::size_t eq = setting.find('=');
+
+				if (eq == std::string::npos || eq == 0)
+					throw fail("expected <file>=<value>, got " + setting);
+				Setting s { setting.substr(0, eq), setting.substr(eq + 1) };
+				if (!valid_path(s.path))
+					throw fail("setting path must be relative to /sys: " + s.path);
+				profile.settings.push_back(s);
+			}
+			cfg.profiles.push_back(profile);
+		} else if (keyword == "on") {
+			std::string trigger, type;
+			Action action;
+
+			if (!(words >> trigger >> type))
+				throw fail("expected on <trigger> <action>");
+			if (!valid_trigger(trigger))
+				throw fail("unknown trigger " + trigger);
+
+			if (type == "profile") {
+				action.type = ActionType::Profile;
+				words >> action.arg;
+			} else if (type == "cycle") {
+				action.type = ActionType::Cycle;
+			} else if (type == "exec") {
+				action.type = ActionType::Exec;
+				std::getline(words >> std::ws, action.arg);
+			} else {
+				throw fail("unknown action " + type);
+			}
+			if (action.type != ActionType::Cycle && action.arg.empty())
+				throw fail(type + " needs an argument");
+			cfg.rules[trigger].push_back(action);
+		} else if (keyword == "workload") {
+			std::string profile, name;
+
+			if (!(words >> profile))
+				throw fail("expected workload <profile> <process name>...");
+			if (!cfg.workload_profile.empty() && profile != cfg.workload_profile)
+				throw fail("all workloads must use one profile");
+			cfg.workload_profile = profile;
+			while (words >> name)
+				cfg.workloads.insert(name.substr(0, kCommLen));
+		} else if (keyword == "workload_hold") {
+			double seconds;
+
+			if (!(words >> seconds) || seconds < 0)
+				throw fail("expected workload_hold <seconds>");
+			cfg.workload_hold_ms = static_cast<unsigned int>(seconds * 1000);
+		} else if (keyword == "sensor_interval") {
+			double seconds;
+
+			if (!(words >> seconds) || seconds < 0.1)
+				throw fail("expected sensor_interval <seconds>, at least 0.1");
+			cfg.sensor_interval_ms = static_cast<unsigned int>(seconds * 1000);
+		} else {
+			throw fail("unknown keyword " + keyword);
+		}
+	}
+
+	/* Profiles may be declared after the rules that use them */
+	for (const auto &rule : cfg.rules)
+		for (const Action &a : rule.second)
+			if (a.type == ActionType::Profile && !cfg.find_profile(a.arg))
+				throw std::runtime_error(path + ": unknown profile " + a.arg);
+	if (!cfg.workload_profile.empty() && !cfg.find_profile(cfg.workload_profile))
+		throw std::runtime_error(path + ": unknown profile " + cfg.workload_profile);
+	return cfg;
+}
+
+} // namespace opengigabyte
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Profiles and rules of the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Loaded from a line based file, see opengigabyte-daemon.conf.
+ */
+#ifndef OPENGIGABYTE_CONFIG_HPP
+#define OPENGIGABYTE_CONFIG_HPP
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace opengigabyte {
+
+/* One sysfs write: @value goes to /sys/@path */
+struct Setting {
+	std::string path;
+	std::string value;
+};
+
+/* A fan / power profile: the sysfs writes that select it */
+struct Profile {
+	std::string name;
+	std::vector<Setting> settings;
+};
+
+enum class ActionType {
+	Profile,	/* Switch to profile arg */
+	Cycle,		/* Switch to the profile after the current one */
+	Exec,		/* Run arg with /bin/sh */
+};
+
+struct Action {
+	ActionType type;
+	std::string arg;
+};
+
+/* Process names are truncated like the kernel's comm */
+constexpr std::size_t kCommLen = 15;
+
+struct Config {
+	std::vector<Profile> profiles;		/* In file order, which cycle follows */
+	/* Trigger name (ac, battery, thermal, KEY_PROG1, ...) to its actions */
+	std::unordered_map<std::string, std::vector<Action>> rules;
+
+	/* Profile held while any of workloads runs, empty for none */
+	std::string workload_profile;
+	std::unordered_set<std::string> workloads;	/* comm names, one lookup per exec */
+	unsigned int workload_hold_ms = 10000;		/* Kept after the last one exits */
+
+	/* Sensor sampling period while a client has the status block open */
+	unsigned int sensor_interval_ms = 2000;
+
+	const Profile *find_profile(const std::string &name) const;
+	const std::vector<Action> *find_rules(const std::string &trigger) const;
+};
+
+/* Throws std::runtime_error naming the file and line on a bad entry */
+Config load_config(const std::string &path);
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_CONFIG_HPP */
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Control socket of the OpenGigabyte daemon, see ipc.hpp.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "control.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <grp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace opengigabyte {
+
+namespace {
+
+constexpr int kBacklog = 16;
+
+std::runtime_error sys_error(const std::string &what)
+{
+	return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+ControlServer::ControlServer(const std::string &path, const std::string &group)
+	: path_(path)
+{
+	sockaddr_un addr {};
+	std::string dir = path.substr(0, path.rfind('/'));
+	const struct group *gr = group.empty() ? nullptr : getgrnam(group.c_str());
+	mode_t mask;
+
+	if (path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error(path + ": path too long");
+	if (!dir.empty())
+		mkdir(dir.c_str(), 0755);
+
+	fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd_ < 0)
+		throw sys_error("control socket");
+
+	addr.sun_family = AF_UNIX;
+	std::memcpy(addr.sun_path, path.c_str(), path.size());
+	unlink(path.c_str());
+	/* Owner only until the group is set, so nobody connects in between */
+	mask = umask(0177);
+	if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+		int err = errno;
+
+		umask(mask);
+		close(fd_);
+		errno = err;
+		throw sys_error(path);
+	}
+	umask(mask);
+
+	/* Switching profiles changes fans and power: the group's members only */
+	if (gr) {
+		if (chown(path.c_str(), -1, gr->gr_gid) < 0 || chmod(path.c_str(), 0660) < 0)
+			std::fprintf(stderr, "%s: %s, root only\n", path.c_str(),
+				     std::strerror(errno));
+	} else if (!group.empty()) {
+		std::fprintf(stderr, "%s: no group %s, root only\n", path.c_str(), group.c_str());
+	}
+
+	if (listen(fd_, kBacklog) < 0) {
+		int err = errno;
+
+		close(fd_);
+		unlink(path.c_str());
+		errno = err;
+		throw sys_error(path);
+	}
+}
+
+ControlServer::~ControlServer()
+{
+	close(fd_);
+	unlink(path_.c_str());
+}
+
+int ControlServer::accept_client()
+{
+	return accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
+
+int control_receive(int fd, IpcRequest &req)
+{
+	ssize_t len = recv(fd, &req, sizeof(req), 0);
+
+	if (len < 0)
+		return errno == EAGAIN || errno == EINTR ? 0 : -1;
+	if (len != sizeof(req))
+		return -1;
+	req.arg[sizeof(req.arg) - 1] = '\0';
+	return 1;
+}
+
+void control_reply(int fd, const IpcReply &reply)
+{
+	/* A client that doesn't read its replies loses them */
+	send(fd, &reply, sizeof(reply), MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+} // namespace opengigabyte
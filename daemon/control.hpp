@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Control socket of the OpenGigabyte daemon, see ipc.hpp.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+#ifndef OPENGIGABYTE_CONTROL_HPP
+#define OPENGIGABYTE_CONTROL_HPP
+
+#include <string>
+
+#include "ipc.hpp"
+
+namespace opengigabyte {
+
+class ControlServer {
+public:
+	/*
+	 * Socket at @path, open to root and the members of @group. Without
+	 * that group (or with an empty name) only root may connect.
+	 */
+	ControlServer(const std::string &path, const std::string &group);
+	~ControlServer();
+
+	ControlServer(const ControlServer &) = delete;
+	ControlServer &operator=(const ControlServer &) = delete;
+
+	int fd() const { return fd_; }
+
+	/* A pending client's fd (non-blocking), -1 once there is none */
+	int accept_client();
+
+private:
+	std::string path_;
+	int fd_ = -1;
+};
+
+/*
+ * Next request on client @fd. Returns 1 with @req filled, 0 when none is
+ * pending and -1 when the client is gone or sent something else than a
+ * request. The version is left to the caller to check.
+ */
+int control_receive(int fd, IpcRequest &req);
+void control_reply(int fd, const IpcReply &reply);
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_CONTROL_HPP */
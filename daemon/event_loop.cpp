@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * epoll event loop for the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "event_loop.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace opengigabyte {
+
+namespace {
+
+constexpr int kMaxEvents = 16;
+
+std::runtime_error sys_error(const std::string &what)
+{
+	return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+EventLoop::EventLoop()
+{
+	epfd_ = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd_ < 0)
+		throw sys_error("epoll_create1");
+}
+
+EventLoop::~EventLoop()
+{
+	close(epfd_);
+}
+
+void EventLoop::add(int fd, std::uint32_t events, Handler handler)
+{
+	epoll_event ev {};
+
+	ev.events = events;
+	ev.data.fd = fd;
+	if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+		throw sys_error("epoll_ctl");
+	handlers_[fd] = std::move(handler);
+}
+
+void EventLoop::remove(int fd)
+{
+	epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+	handlers_.erase(fd);
+}
+
+void EventLoop::run()
+{
+	epoll_event events[kMaxEvents];
+
+	while (!stopping_) {
+		int n = epoll_wait(epfd_, events, kMaxEvents, -1);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			throw sys_error("epoll_wait");
+		}
+		wakeups_++;
+
+		for (int i = 0; i < n; i++) {
+			/* An earlier handler in this batch may have removed it */
+			auto it = handlers_.find(events[i].data.fd);
+
+			if (it == handlers_.end())
+				continue;
+			/* Copy: the handler may remove itself */
+			Handler handler = it->second;
+			handler(events[i].events);
+		}
+	}
+}
+
+} // namespace opengigabyte
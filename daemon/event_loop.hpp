@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * epoll event loop for the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Every input of the daemon is a file descriptor. There are no timers:
+ * run() sleeps in epoll_wait() until one of them is readable.
+ */
+#ifndef OPENGIGABYTE_EVENT_LOOP_HPP
+#define OPENGIGABYTE_EVENT_LOOP_HPP
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+namespace opengigabyte {
+
+class EventLoop {
+public:
+	using Handler = std::function<void(std::uint32_t events)>;
+
+	EventLoop();
+	~EventLoop();
+
+	EventLoop(const EventLoop &) = delete;
+	EventLoop &operator=(const EventLoop &) = delete;
+
+	/* Call @handler with the epoll events whenever @fd is ready */
+	void add(int fd, std::uint32_t events, Handler handler);
+	/* Safe from inside a handler; the fd is not closed */
+	void remove(int fd);
+
+	/* Dispatch events until stop() is called */
+	void run();
+	void stop() { stopping_ = true; }
+
+	/* Returns from epoll_wait(), i.e. times the daemon woke up */
+	std::uint64_t wakeups() const { return wakeups_; }
+
+private:
+	int epfd_ = -1;
+	bool stopping_ = false;
+	std::uint64_t wakeups_ = 0;
+	std::unordered_map<int, Handler> handlers_;
+};
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_EVENT_LOOP_HPP */
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Fn key input for the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "fn_input.hpp"
+
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+
+namespace opengigabyte {
+
+namespace {
+
+struct KeyName {
+	const char *name;
+	std::uint16_t code;
+};
+
+/* Keys the Fn Keys device can send that the desktop leaves alone */
+constexpr KeyName kKeyNames[] = {
+	{ "KEY_PROG1", KEY_PROG1 },
+	{ "KEY_PROG2", KEY_PROG2 },
+	{ "KEY_PROG3", KEY_PROG3 },
+	{ "KEY_PROG4", KEY_PROG4 },
+	{ "KEY_FN_ESC", KEY_FN_ESC },
+};
+
+} // namespace
+
+std::vector<std::string> list_event_nodes()
+{
+	std::vector<std::string> nodes;
+	DIR *dir = opendir("/dev/input");
+
+	if (!dir)
+		return nodes;
+	while (dirent *de = readdir(dir))
+		if (std::strncmp(de->d_name, "event", 5) == 0)
+			nodes.push_back(std::string("/dev/input/") + de->d_name);
+	closedir(dir);
+	return nodes;
+}
+
+int open_fn_keys(const std::string &devnode)
+{
+	char name[64] = {};
+	int fd = open(devnode.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+	if (fd < 0)
+		return -1;
+	if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name) < 0 ||
+	    std::strcmp(name, kFnKeysName) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+std::string key_name(std::uint16_t code)
+{
+	for (const KeyName &k : kKeyNames)
+		if (k.code == code)
+			return k.name;
+	return {};
+}
+
+std::uint16_t key_code(const std::string &name)
+{
+	for (const KeyName &k : kKeyNames)
+		if (name == k.name)
+			return k.code;
+	return 0;
+}
+
+} // namespace opengigabyte
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Fn key input for the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * gigabytekbd and gigabytekbd-user both expose the keys the desktop has
+ * no use for (Fn+F12 as KEY_PROG1, Fn+ESC as KEY_PROG2) on an input
+ * device named "Gigabyte Fn Keys". The daemon reads it through evdev.
+ */
+#ifndef OPENGIGABYTE_FN_INPUT_HPP
+#define OPENGIGABYTE_FN_INPUT_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <linux/input.h>
+#include <unistd.h>
+
+namespace opengigabyte {
+
+constexpr char kFnKeysName[] = "Gigabyte Fn Keys";
+
+/* /dev/input/eventN nodes currently present */
+std::vector<std::string> list_event_nodes();
+
+/* Open @devnode non-blocking if it is a Fn Keys device, else return -1 */
+int open_fn_keys(const std::string &devnode);
+
+/*
+ * Read what is pending on @fd and call fn(keycode) for each key press.
+ * Returns false once the device is gone.
+ */
+template <typename Fn>
+bool read_fn_keys(int fd, Fn &&fn)
+{
+	input_event events[16];
+
+	for (;;) {
+		ssize_t len = read(fd, events, sizeof(events));
+
+		if (len < 0)
+			return errno == EAGAIN || errno == EINTR;
+		if (len == 0)
+			return false;
+		for (std::size_t i = 0; i < static_cast<std::size_t>(len) / sizeof(events[0]); i++)
+			if (events[i].type == EV_KEY && events[i].value == 1)
+				fn(events[i].code);
+	}
+}
+
+/* KEY_PROG1 and friends, for the config file; empty / 0 if unknown */
+std::string key_name(std::uint16_t code);
+std::uint16_t key_code(const std::string &name);
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_FN_INPUT_HPP */
@@ -0,0 +1,85 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Idle wakeup benchmark for opengigabyte-daemon.
+#
+# Starts the daemon, lets it settle and counts its context switches
+# while nothing happens: with perf stat when available (per second
+# intervals, the first one dropped) and otherwise from
+# /proc/<pid>/status (the counters pidstat -w reports).
+#
+# Every exec wakes the daemon once for workload detection, so nothing
+# is exec'd inside the measured window: the wait is bash's read -t.
+# Battery capacity uevents are sent by the kernel on its own schedule
+# and wake it briefly too; run on AC for a clean number.
+#
+# Usage: idle_bench.sh [daemon] [seconds]
+
+DAEMON=${1:-./opengigabyte-daemon}
+IDLE=${2:-30}
+CONFIG=${CONFIG:-./opengigabyte-daemon.conf}
+STATUS=${STATUS:-}
+CONTROL=${CONTROL:-}
+
+ctxt_switches() {
+	local key value total=0
+
+	while read -r key value _; do
+		case $key in
+		*ctxt_switches:) total=$((total + value)) ;;
+		esac
+	done < "/proc/$1/status"
+	echo $total
+}
+
+# sleep(1) without an exec
+FIFO=$(mktemp -u)
+mkfifo "$FIFO"
+exec 3<>"$FIFO"
+rm -f "$FIFO"
+idle() {
+	read -r -t "$1" -u 3
+}
+
+"$DAEMON" --foreground --config "$CONFIG" --status "$STATUS" --control "$CONTROL" &
+PID=$!
+trap 'kill $PID 2>/dev/null' EXIT
+idle 1
+if ! kill -0 $PID 2>/dev/null; then
+	echo "$DAEMON did not start" >&2
+	exit 1
+fi
+
+if command -v perf >/dev/null 2>&1; then
+	TOOL="perf stat"
+	OUT=$(mktemp)
+	perf stat -x, -I 1000 -e context-switches -p $PID -o "$OUT" &
+	PERF=$!
+	idle $((IDLE + 2))
+	kill -INT $PERF
+	wait $PERF
+	# Interval lines: time,count,unit,event,...; the first covers perf's own start
+	WAKEUPS=$(awk -F, -v n="$IDLE" '$4 == "context-switches" && ++i > 1 && i <= n + 1 { s += $2 }
+		   END { print s + 0 }' "$OUT")
+	rm -f "$OUT"
+else
+	TOOL="/proc/$PID/status"
+	BEFORE=$(ctxt_switches $PID)
+	idle "$IDLE"
+	WAKEUPS=$(( $(ctxt_switches $PID) - BEFORE ))
+fi
+
+case $WAKEUPS in
+''|*[!0-9]*)
+	echo "could not count context switches with $TOOL" >&2
+	exit 1
+	;;
+esac
+
+echo "idle wakeups    $WAKEUPS in $IDLE s ($TOOL)"
+if [ "$WAKEUPS" -eq 0 ]; then
+	echo "target: 0 idle wakeups: PASS"
+else
+	echo "target: 0 idle wakeups: FAIL"
+	exit 1
+fi
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Control protocol of the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Clients connect to a SOCK_SEQPACKET socket and send fixed size
+ * requests; each gets one fixed size reply. No parsing, no framing:
+ * one packet is one message. State is read from the status block
+ * (status.hpp), the socket is only for changing it.
+ */
+#ifndef OPENGIGABYTE_IPC_HPP
+#define OPENGIGABYTE_IPC_HPP
+
+#include <cstdint>
+
+#include "status.hpp"
+
+namespace opengigabyte {
+
+constexpr char kControlPath[] = "/run/opengigabyte/control";
+constexpr std::uint16_t kIpcVersion = 1;
+
+enum IpcOp : std::uint16_t {
+	kIpcSetProfile = 1,	/* arg: profile name */
+	kIpcCycleProfile = 2,	/* Like the cycle action */
+};
+
+struct IpcRequest {
+	std::uint16_t version;		/* kIpcVersion */
+	std::uint16_t op;		/* IpcOp */
+	char arg[kStatusNameLen];	/* NUL terminated */
+};
+
+struct IpcReply {
+	std::int32_t error;		/* 0 or a negative errno */
+	char profile[kStatusNameLen];	/* Profile in effect afterwards */
+};
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_IPC_HPP */
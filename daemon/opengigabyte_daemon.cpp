@@ -0,0 +1,730 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * OpenGigabyte daemon
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Switches fan / power profiles and runs user actions on Fn keys
+ * (KEY_PROG1, KEY_PROG2), AC adapter changes and thermal events, and
+ * holds a performance profile while heavy workloads run. All inputs are
+ * file descriptors on one epoll loop: the Fn Keys evdev device, the
+ * kernel uevent socket, the proc connector, pidfds of running workloads,
+ * the control socket and its clients, the touchpad and backlight sysfs
+ * attributes the kernel notifies, and a signalfd. The state is
+ * published in a shared memory status block (see status.hpp) and can be
+ * changed through the control socket (see ipc.hpp). The only timers are
+ * the workload hold, armed after the last workload exits, and the sensor
+ * sampling, armed while a client has the status block open, so while
+ * nothing happens the daemon never wakes up.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "config.hpp"
+#include "control.hpp"
+#include "event_loop.hpp"
+#include "fn_input.hpp"
+#include "power.hpp"
+#include "proc_events.hpp"
+#include "sensors.hpp"
+#include "status_writer.hpp"
+#include "uevent.hpp"
+
+using namespace opengigabyte;
+
+namespace {
+
+constexpr char kDefaultConfig[] = "/etc/opengigabyte/daemon.conf";
+constexpr char kControlGroup[] = "opengigabyte";
+constexpr std::size_t kMaxClients = 64;
+
+/* One shot unless @repeat; 0 disarms */
+void arm_timer(int fd, unsigned int ms, bool repeat)
+{
+	itimerspec its {};
+
+	its.it_value.tv_sec = ms / 1000;
+	its.it_value.tv_nsec = static_cast<long>(ms % 1000) * 1000000;
+	if (repeat)
+		its.it_interval = its.it_value;
+	timerfd_settime(fd, 0, &its, nullptr);
+}
+
+bool timer_expired(int fd)
+{
+	std::uint64_t expirations;
+
+	return read(fd, &expirations, sizeof(expirations)) == sizeof(expirations);
+}
+
+std::uint8_t status_power(PowerSource source)
+{
+	switch (source) {
+	case PowerSource::AC:
+		return kStatusPowerAC;
+	case PowerSource::Battery:
+		return kStatusPowerBattery;
+	default:
+		return kStatusPowerUnknown;
+	}
+}
+
+class Daemon {
+public:
+	Daemon(const std::string &config_path, const std::string &status_path,
+	       const std::string &control_path, const std::string &control_group,
+	       bool verbose);
+	~Daemon();
+
+	int run();
+
+private:
+	void load_config();
+	void handle_signals();
+	void handle_uevents();
+	void add_fn_keys(const std::string &devnode);
+	void handle_fn_keys(int fd);
+
+	void reset_workloads();
+	void handle_exec(pid_t pid);
+	void workload_exited(pid_t pid);
+	void handle_hold();
+	void end_workload();
+
+	void handle_readers();
+	void handle_sensors();
+	void reset_driver_state();
+	void handle_driver_state();
+	void publish();
+
+	void handle_control();
+	void handle_client(int fd);
+	IpcReply handle_request(const IpcRequest &req);
+
+	void update_power_source();
+	void trigger(const std::string &name);
+	void run_action(const Action &action, const std::string &trigger);
+	void set_profile(const Profile &profile, const std::string &reason);
+	bool apply_current(const std::string &reason);
+	void spawn(const std::string &command, const std::string &trigger);
+
+	std::string config_path_;
+	bool verbose_;
+	Config config_;
+	EventLoop loop_;
+	UeventMonitor uevents_;
+	int signal_fd_ = -1;
+	sigset_t signals_;
+	std::map<int, std::string> fn_keys_;	/* fd to devnode */
+	PowerSource source_ = PowerSource::Unknown;
+
+	std::unique_ptr<ProcEvents> proc_;	/* Only while workloads are configured */
+	std::unordered_map<pid_t, int> workloads_;	/* Running workload pid to pidfd */
+	bool workload_active_ = false;		/* Also true during the hold */
+	int hold_fd_ = -1;
+
+	std::unique_ptr<StatusWriter> status_;	/* Null if the file can't be created */
+	std::unique_ptr<Sensors> sensors_;	/* Only while a client reads the status */
+	std::unique_ptr<DriverState> driver_state_;
+	StatusData status_data_ {};
+	int sensor_fd_ = -1;
+
+	std::unique_ptr<ControlServer> control_;
+	std::unordered_set<int> clients_;	/* Connected control clients */
+
+	std::string base_profile_;		/* Picked by the rules */
+	std::string profile_;			/* Applied: the workload's or the base */
+};
+
+Daemon::Daemon(const std::string &config_path, const std::string &status_path,
+	       const std::string &control_path, const std::string &control_group,
+	       bool verbose)
+	: config_path_(config_path), verbose_(verbose)
+{
+	/* Signals arrive through the loop like everything else */
+	sigemptyset(&signals_);
+	sigaddset(&signals_, SIGINT);
+	sigaddset(&signals_, SIGTERM);
+	sigaddset(&signals_, SIGHUP);
+	sigaddset(&signals_, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &signals_, nullptr);
+	signal_fd_ = signalfd(-1, &signals_, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (signal_fd_ < 0)
+		throw std::runtime_error(std::string("signalfd: ") + std::strerror(errno));
+	hold_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	sensor_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (hold_fd_ < 0 || sensor_fd_ < 0)
+		throw std::runtime_error(std::string("timerfd: ") + std::strerror(errno));
+
+	status_data_.touchpad = -1;
+	status_data_.backlight_power = -1;
+	status_data_.backlight = -1;
+	status_data_.backlight_max = -1;
+	if (!status_path.empty()) {
+		try {
+			status_ = std::make_unique<StatusWriter>(status_path);
+		} catch (const std::exception &e) {
+			std::fprintf(stderr, "%s, no status block\n", e.what());
+		}
+	}
+	if (!control_path.empty()) {
+		try {
+			control_ = std::make_unique<ControlServer>(control_path, control_group);
+		} catch (const std::exception &e) {
+			std::fprintf(stderr, "%s, no control socket\n", e.what());
+		}
+	}
+
+	load_config();
+}
+
+Daemon::~Daemon()
+{
+	for (const auto &fn : fn_keys_)
+		close(fn.first);
+	for (const auto &w : workloads_)
+		close(w.second);
+	for (int fd : clients_)
+		close(fd);
+	close(sensor_fd_);
+	close(hold_fd_);
+	close(signal_fd_);
+}
+
+void Daemon::load_config()
+{
+	try {
+		config_ = opengigabyte::load_config(config_path_);
+		if (verbose_)
+			std::fprintf(stderr, "Loaded %s: %zu profiles, %zu triggers\n",
+				     config_path_.c_str(), config_.profiles.size(),
+				     config_.rules.size());
+	} catch (const std::exception &e) {
+		/* Keep what we had; on startup that is no rules at all */
+		std::fprintf(stderr, "%s\n", e.what());
+	}
+}
+
+void Daemon::handle_signals()
+{
+	signalfd_siginfo si;
+	bool reload = false;
+
+	while (read(signal_fd_, &si, sizeof(si)) == sizeof(si)) {
+		switch (si.ssi_signo) {
+		case SIGHUP:
+			reload = true;
+			break;
+		case SIGCHLD:
+			while (waitpid(-1, nullptr, WNOHANG) > 0)
+				;
+			break;
+		default:
+			loop_.stop();
+			break;
+		}
+	}
+
+	if (reload) {
+		load_config();
+		/* Re-apply the source's profile and rescan with the new rules */
+		reset_workloads();
+		source_ = PowerSource::Unknown;
+		update_power_source();
+		apply_current("reload");
+	}
+}
+
+/* Forget tracked workloads and pick up the running ones from scratch */
+void Daemon::reset_workloads()
+{
+	for (const auto &w : workloads_) {
+		loop_.remove(w.second);
+		close(w.second);
+	}
+	workloads_.clear();
+	workload_active_ = false;
+	arm_timer(hold_fd_, 0, false);
+
+	if (config_.workloads.empty()) {
+		if (proc_)
+			loop_.remove(proc_->fd());
+		proc_.reset();
+		return;
+	}
+
+	if (!proc_) {
+		try {
+			proc_ = std::make_unique<ProcEvents>();
+			loop_.add(proc_->fd(), EPOLLIN, [this](std::uint32_t) {
+				proc_->drain([this](pid_t pid) { handle_exec(pid); });
+			});
+		} catch (const std::exception &e) {
+			proc_.reset();
+			std::fprintf(stderr, "%s, workload detection off\n", e.what());
+			return;
+		}
+	}
+
+	if (DIR *dir = opendir("/proc")) {
+		while (dirent *de = readdir(dir)) {
+			pid_t pid = static_cast<pid_t>(std::atoi(de->d_name));
+
+			if (pid > 0)
+				handle_exec(pid);
+		}
+		closedir(dir);
+	}
+}
+
+/* One comm read and one hash lookup per exec; only workloads go further */
+void Daemon::handle_exec(pid_t pid)
+{
+	std::string name = process_name(pid);
+	int fd;
+
+	if (!config_.workloads.count(name) || workloads_.count(pid))
+		return;
+	fd = open_pidfd(pid);
+	if (fd < 0)
+		return;
+
+	workloads_[pid] = fd;
+	loop_.add(fd, EPOLLIN, [this, pid](std::uint32_t) { workload_exited(pid); });
+	if (verbose_)
+		std::fprintf(stderr, "Workload %s (%d) started\n", name.c_str(), pid);
+
+	arm_timer(hold_fd_, 0, false);
+	if (!workload_active_) {
+		workload_active_ = true;
+		if (!apply_current("workload " + name))
+			publish();
+	}
+}
+
+void Daemon::workload_exited(pid_t pid)
+{
+	auto it = workloads_.find(pid);
+
+	if (it == workloads_.end())
+		return;
+	loop_.remove(it->second);
+	close(it->second);
+	workloads_.erase(it);
+
+	/* Builds run short compiler processes back to back: don't flap */
+	if (workloads_.empty()) {
+		if (config_.workload_hold_ms)
+			arm_timer(hold_fd_, config_.workload_hold_ms, false);
+		else
+			end_workload();
+	}
+}
+
+void Daemon::handle_hold()
+{
+	/* Nothing to read if a new workload disarmed it meanwhile */
+	if (timer_expired(hold_fd_))
+		end_workload();
+}
+
+void Daemon::end_workload()
+{
+	if (!workload_active_ || !workloads_.empty())
+		return;
+	workload_active_ = false;
+	if (!apply_current("workloads ended"))
+		publish();
+}
+
+/* Sample sensors while at least one client has the status block open */
+void Daemon::handle_readers()
+{
+	unsigned int readers = status_->update_readers();
+
+	if (readers && !sensors_) {
+		if (verbose_)
+			std::fprintf(stderr, "Status block opened, sampling sensors\n");
+		sensors_ = std::make_unique<Sensors>();
+		sensors_->sample(status_data_);
+		publish();
+		arm_timer(sensor_fd_, config_.sensor_interval_ms, true);
+	} else if (!readers && sensors_) {
+		if (verbose_)
+			std::fprintf(stderr, "Status block closed, sensors idle\n");
+		arm_timer(sensor_fd_, 0, false);
+		sensors_.reset();
+	}
+}
+
+void Daemon::handle_sensors()
+{
+	if (!timer_expired(sensor_fd_) || !sensors_)
+		return;
+
+	/* Also picks up bl_power writes, which the backlight core doesn't notify */
+	bool changed = sensors_->sample(status_data_);
+	if (driver_state_->read(status_data_) || changed)
+		publish();
+}
+
+/* Reopen the notified attributes; their devices come and go with modules */
+void Daemon::reset_driver_state()
+{
+	if (driver_state_)
+		for (int fd : driver_state_->fds())
+			loop_.remove(fd);
+
+	driver_state_ = std::make_unique<DriverState>();
+	for (int fd : driver_state_->fds())
+		loop_.add(fd, EPOLLPRI, [this](std::uint32_t) { handle_driver_state(); });
+	if (driver_state_->read(status_data_))
+		publish();
+}
+
+void Daemon::handle_driver_state()
+{
+	if (driver_state_->read(status_data_)) {
+		if (verbose_)
+			std::fprintf(stderr, "Touchpad %d, backlight %d at %d\n",
+				     status_data_.touchpad, status_data_.backlight_power,
+				     status_data_.backlight);
+		publish();
+	}
+}
+
+void Daemon::handle_control()
+{
+	int fd;
+
+	while ((fd = control_->accept_client()) >= 0) {
+		if (clients_.size() >= kMaxClients) {
+			close(fd);
+			continue;
+		}
+		clients_.insert(fd);
+		loop_.add(fd, EPOLLIN, [this, fd](std::uint32_t) { handle_client(fd); });
+	}
+}
+
+void Daemon::handle_client(int fd)
+{
+	IpcRequest req;
+	int ret;
+
+	while ((ret = control_receive(fd, req)) > 0)
+		control_reply(fd, handle_request(req));
+	if (ret < 0) {
+		loop_.remove(fd);
+		clients_.erase(fd);
+		close(fd);
+	}
+}
+
+IpcReply Daemon::handle_request(const IpcRequest &req)
+{
+	IpcReply reply {};
+
+	if (req.version != kIpcVersion) {
+		reply.error = -EPROTO;
+	} else if (req.op == kIpcSetProfile) {
+		const Profile *profile = config_.find_profile(req.arg);
+
+		if (profile)
+			set_profile(*profile, "client");
+		else
+			reply.error = -ENOENT;
+	} else if (req.op == kIpcCycleProfile) {
+		run_action({ ActionType::Cycle, {} }, "client");
+	} else {
+		reply.error = -EOPNOTSUPP;
+	}
+	std::snprintf(reply.profile, sizeof(reply.profile), "%s", profile_.c_str());
+	return reply;
+}
+
+void Daemon::publish()
+{
+	timespec now;
+
+	if (!status_)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	status_data_.updated_ns = static_cast<std::uint64_t>(now.tv_sec) * 1000000000 +
+				  static_cast<std::uint64_t>(now.tv_nsec);
+	std::snprintf(status_data_.profile, sizeof(status_data_.profile), "%s", profile_.c_str());
+	status_data_.power = status_power(source_);
+	status_data_.workload = workload_active_;
+	status_->publish(status_data_);
+}
+
+void Daemon::handle_uevents()
+{
+	Uevent ev;
+
+	while (uevents_.receive(ev)) {
+		if (ev.subsystem == "input") {
+			if (ev.action == "add" && ev.devname.compare(0, 11, "input/event") == 0)
+				add_fn_keys("/dev/" + ev.devname);
+		} else if (ev.subsystem == "power_supply") {
+			/* Capacity updates of the battery itself can't change the source */
+			if (ev.get("POWER_SUPPLY_TYPE") != "Battery")
+				update_power_source();
+		} else if (ev.subsystem == "thermal") {
+			trigger("thermal");
+		} else if ((ev.subsystem == "hid" && ev.get("DRIVER") == "gigabytekbd" &&
+			    (ev.action == "bind" || ev.action == "unbind")) ||
+			   (ev.subsystem == "backlight" &&
+			    (ev.action == "add" || ev.action == "remove"))) {
+			reset_driver_state();
+		}
+	}
+}
+
+void Daemon::add_fn_keys(const std::string &devnode)
+{
+	int fd = open_fn_keys(devnode);
+
+	if (fd < 0)
+		return;
+	if (verbose_)
+		std::fprintf(stderr, "Listening on %s\n", devnode.c_str());
+	fn_keys_[fd] = devnode;
+	loop_.add(fd, EPOLLIN, [this, fd](std::uint32_t) { handle_fn_keys(fd); });
+}
+
+void Daemon::handle_fn_keys(int fd)
+{
+	bool alive = read_fn_keys(fd, [this](std::uint16_t code) {
+		std::string name = key_name(code);
+
+		if (!name.empty())
+			trigger(name);
+	});
+
+	if (!alive) {
+		if (verbose_)
+			std::fprintf(stderr, "%s went away\n", fn_keys_[fd].c_str());
+		loop_.remove(fd);
+		fn_keys_.erase(fd);
+		close(fd);
+	}
+}
+
+/* Act on real source changes only; adapters report other properties too */
+void Daemon::update_power_source()
+{
+	PowerSource source = read_power_source();
+
+	if (source == source_)
+		return;
+	source_ = source;
+	if (verbose_)
+		std::fprintf(stderr, "Running on %s\n", power_source_name(source));
+	trigger(power_source_name(source));
+	publish();
+}
+
+void Daemon::trigger(const std::string &name)
+{
+	const std::vector<Action> *actions = config_.find_rules(name);
+
+	if (!actions)
+		return;
+	for (const Action &action : *actions)
+		run_action(action, name);
+}
+
+void Daemon::run_action(const Action &action, const std::string &trigger)
+{
+	switch (action.type) {
+	case ActionType::Profile:
+		if (const Profile *p = config_.find_profile(action.arg))
+			set_profile(*p, trigger);
+		break;
+	case ActionType::Cycle: {
+		const std::vector<Profile> &profiles = config_.profiles;
+		std::size_t next = 0;
+
+		if (profiles.empty())
+			break;
+		for (std::size_t i = 0; i < profiles.size(); i++)
+			if (profiles[i].name == base_profile_)
+				next = (i + 1) % profiles.size();
+		set_profile(profiles[next], trigger);
+		break;
+	}
+	case ActionType::Exec:
+		spawn(action.arg, trigger);
+		break;
+	}
+}
+
+/* Rules set the base profile; a running workload holds its own over it */
+void Daemon::set_profile(const Profile &profile, const std::string &reason)
+{
+	base_profile_ = profile.name;
+	apply_current(reason);
+}
+
+/* Returns true if the profile changed, which also publishes it */
+bool Daemon::apply_current(const std::string &reason)
+{
+	const std::string &name = workload_active_ ? config_.workload_profile : base_profile_;
+	const Profile *profile = config_.find_profile(name);
+
+	/* Each setting may be an EC write; don't repeat them */
+	if (!profile || name == profile_)
+		return false;
+	if (verbose_)
+		std::fprintf(stderr, "Profile %s (%s)\n", name.c_str(), reason.c_str());
+	apply_profile(*profile, verbose_);
+	profile_ = name;
+	publish();
+	return true;
+}
+
+void Daemon::spawn(const std::string &command, const std::string &trigger)
+{
+	pid_t pid = fork();
+
+	if (pid < 0) {
+		std::perror("fork");
+		return;
+	}
+	if (pid > 0)
+		return;
+
+	/* Reaped through SIGCHLD on the signalfd */
+	sigprocmask(SIG_UNBLOCK, &signals_, nullptr);
+	setenv("OPENGIGABYTE_TRIGGER", trigger.c_str(), 1);
+	setenv("OPENGIGABYTE_PROFILE", profile_.c_str(), 1);
+	execl("/bin/sh", "sh", "-c", command.c_str(), nullptr);
+	_exit(127);
+}
+
+int Daemon::run()
+{
+	loop_.add(signal_fd_, EPOLLIN, [this](std::uint32_t) { handle_signals(); });
+	loop_.add(uevents_.fd(), EPOLLIN, [this](std::uint32_t) { handle_uevents(); });
+	loop_.add(hold_fd_, EPOLLIN, [this](std::uint32_t) { handle_hold(); });
+	loop_.add(sensor_fd_, EPOLLIN, [this](std::uint32_t) { handle_sensors(); });
+	if (status_)
+		loop_.add(status_->watch_fd(), EPOLLIN, [this](std::uint32_t) { handle_readers(); });
+	if (control_)
+		loop_.add(control_->fd(), EPOLLIN, [this](std::uint32_t) { handle_control(); });
+
+	/* Listen first, then scan, so a device added in between isn't missed */
+	for (const std::string &devnode : list_event_nodes())
+		add_fn_keys(devnode);
+	reset_driver_state();
+	update_power_source();
+	reset_workloads();
+
+	loop_.run();
+	if (verbose_)
+		std::fprintf(stderr, "Exiting after %llu wakeups\n",
+			     static_cast<unsigned long long>(loop_.wakeups()));
+	return 0;
+}
+
+void usage(const char *prog)
+{
+	std::fprintf(stderr,
+		     "Usage: %s [-F] [-v] [-c config] [-s status] [-C control] [-g group]\n"
+		     "  -F, --foreground  don't detach from the terminal\n"
+		     "  -v, --verbose     log what is done and why\n"
+		     "  -c, --config      config file (default: %s)\n"
+		     "  -s, --status      status block, empty for none (default: %s)\n"
+		     "  -C, --control     control socket, empty for none (default: %s)\n"
+		     "  -g, --group       group allowed to use the control socket, empty for\n"
+		     "                    root only (default: %s)\n"
+		     "SIGHUP reloads the config.\n", prog, kDefaultConfig, kStatusPath,
+		     kControlPath, kControlGroup);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	static const option long_options[] = {
+		{ "foreground", no_argument, nullptr, 'F' },
+		{ "verbose", no_argument, nullptr, 'v' },
+		{ "config", required_argument, nullptr, 'c' },
+		{ "status", required_argument, nullptr, 's' },
+		{ "control", required_argument, nullptr, 'C' },
+		{ "group", required_argument, nullptr, 'g' },
+		{ "help", no_argument, nullptr, 'h' },
+		{ nullptr, 0, nullptr, 0 },
+	};
+	std::string config = kDefaultConfig;
+	std::string status = kStatusPath;
+	std::string control = kControlPath;
+	std::string group = kControlGroup;
+	bool foreground = false;
+	bool verbose = false;
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "Fvc:s:C:g:h", long_options, nullptr)) != -1) {
+		switch (opt) {
+		case 'F':
+			foreground = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		case 'c':
+			config = optarg;
+			break;
+		case 's':
+			status = optarg;
+			break;
+		case 'C':
+			control = optarg;
+			break;
+		case 'g':
+			group = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	/* daemon() changes to / */
+	if (char *path = realpath(config.c_str(), nullptr)) {
+		config = path;
+		std::free(path);
+	}
+	if (!foreground && daemon(0, 0) < 0) {
+		std::perror("daemon");
+		return 1;
+	}
+
+	try {
+		Daemon d(config, status, control, group, verbose);
+
+		return d.run();
+	} catch (const std::exception &e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Print the OpenGigabyte daemon's status block
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Reference client for status.hpp: maps the block read-only, takes a
+ * seqlock copy and, with -w, prints again on every update while
+ * sleeping on the futex in between.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "status.hpp"
+
+using namespace opengigabyte;
+
+namespace {
+
+const char *power_name(std::uint8_t power)
+{
+	switch (power) {
+	case kStatusPowerAC:
+		return "ac";
+	case kStatusPowerBattery:
+		return "battery";
+	default:
+		return "unknown";
+	}
+}
+
+void print_status(const StatusData &d)
+{
+	std::printf("profile    %s%s\n", d.profile[0] ? d.profile : "-",
+		    d.workload ? " (workload)" : "");
+	std::printf("power      %s\n", power_name(d.power));
+	std::printf("touchpad   %s\n", d.touchpad < 0 ? "unknown" : d.touchpad ? "on" : "off");
+	if (d.backlight >= 0)
+		std::printf("backlight  %d/%d%s\n", d.backlight, d.backlight_max,
+			    d.backlight_power == 0 ? " (off)" : "");
+	for (std::uint32_t i = 0; i < d.fan_count && i < kStatusFans; i++)
+		std::printf("fan%u       %d rpm\n", i + 1, d.fan_rpm[i]);
+	for (std::uint32_t i = 0; i < d.temp_count && i < kStatusTemps; i++)
+		std::printf("%-10.16s %.1f C\n", d.temp_label[i], d.temp_mc[i] / 1000.0);
+	std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	std::string path = kStatusPath;
+	bool watch = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "ws:h")) != -1) {
+		switch (opt) {
+		case 'w':
+			watch = true;
+			break;
+		case 's':
+			path = optarg;
+			break;
+		default:
+			std::fprintf(stderr, "Usage: %s [-w] [-s status]\n", argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	/* Kept open for as long as we run: that's what keeps sensors sampled */
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(errno));
+		return 1;
+	}
+	void *map = mmap(nullptr, sizeof(StatusBlock), PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(errno));
+		return 1;
+	}
+	const auto *block = static_cast<const StatusBlock *>(map);
+	if (!status_valid(block)) {
+		std::fprintf(stderr, "%s: not a version %u status block\n", path.c_str(),
+			     kStatusVersion);
+		return 1;
+	}
+
+	StatusData data;
+	std::uint32_t seq = status_read(block, data);
+
+	print_status(data);
+	while (watch) {
+		int ret = status_wait(block, seq, nullptr);
+
+		if (ret && ret != -EINTR)
+			break;
+		seq = status_read(block, data);
+		std::printf("\n");
+		print_status(data);
+	}
+	return 0;
+}
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Power source and profile switching for the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "power.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace opengigabyte {
+
+namespace {
+
+constexpr char kPowerSupplyDir[] = "/sys/class/power_supply/";
+
+std::string read_line(const std::string &path)
+{
+	std::ifstream in(path);
+	std::string line;
+
+	std::getline(in, line);
+	return line;
+}
+
+} // namespace
+
+const char *power_source_name(PowerSource source)
+{
+	switch (source) {
+	case PowerSource::AC:
+		return "ac";
+	case PowerSource::Battery:
+		return "battery";
+	default:
+		return "unknown";
+	}
+}
+
+PowerSource read_power_source()
+{
+	DIR *dir = opendir(kPowerSupplyDir);
+	bool have_adapter = false;
+
+	if (!dir)
+		return PowerSource::AC;
+	while (dirent *de = readdir(dir)) {
+		std::string base = std::string(kPowerSupplyDir) + de->d_name + "/";
+
+		if (de->d_name[0] == '.' || read_line(base + "type") == "Battery")
+			continue;
+		have_adapter = true;
+		if (read_line(base + "online") == "1") {
+			closedir(dir);
+			return PowerSource::AC;
+		}
+	}
+	closedir(dir);
+	return have_adapter ? PowerSource::Battery : PowerSource::AC;
+}
+
+unsigned int apply_profile(const Profile &profile, bool verbose)
+{
+	unsigned int failed = 0;
+
+	for (const Setting &s : profile.settings) {
+		std::string path = "/sys/" + s.path;
+		int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+
+		if (fd < 0 && errno == ENOENT) {
+			if (verbose)
+				std::fprintf(stderr, "%s: not on this machine, skipped\n", path.c_str());
+			continue;
+		}
+		/* One write(2): sysfs stores take the value in a single call */
+		if (fd < 0 || write(fd, s.value.data(), s.value.size()) !=
+			      static_cast<ssize_t>(s.value.size())) {
+			std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(errno));
+			failed++;
+		}
+		if (fd >= 0)
+			close(fd);
+	}
+	return failed;
+}
+
+} // namespace opengigabyte
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Power source and profile switching for the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+#ifndef OPENGIGABYTE_POWER_HPP
+#define OPENGIGABYTE_POWER_HPP
+
+#include <string>
+
+#include "config.hpp"
+
+namespace opengigabyte {
+
+enum class PowerSource {
+	Unknown,
+	AC,
+	Battery,
+};
+
+const char *power_source_name(PowerSource source);
+
+/* Any adapter online, or no power supplies at all (desktop), counts as AC */
+PowerSource read_power_source();
+
+/*
+ * Write every setting of @profile. Settings whose file doesn't exist on
+ * this machine are skipped; returns the number of writes that failed.
+ */
+unsigned int apply_profile(const Profile &profile, bool verbose);
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_POWER_HPP */
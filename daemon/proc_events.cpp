@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Process exec events for the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "proc_events.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/filter.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+namespace opengigabyte {
+
+namespace {
+
+/* Offsets of the fields the socket filter looks at */
+constexpr std::uint32_t kCnIdxOffset = NLMSG_HDRLEN + offsetof(cn_msg, id.idx);
+constexpr std::uint32_t kWhatOffset = NLMSG_HDRLEN + sizeof(cn_msg) + offsetof(proc_event, what);
+
+std::runtime_error sys_error(const std::string &what)
+{
+	return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+/*
+ * Keep proc connector exec events, drop everything else. BPF_ABS loads
+ * are big endian, hence htonl() on the host endian values compared.
+ */
+void attach_exec_filter(int fd)
+{
+	sock_filter code[] = {
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, kCnIdxOffset),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(CN_IDX_PROC), 0, 3),
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, kWhatOffset),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(proc_event::PROC_EVENT_EXEC), 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+		BPF_STMT(BPF_RET | BPF_K, 0),
+	};
+	sock_fprog prog = { sizeof(code) / sizeof(code[0]), code };
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0)
+		throw sys_error("proc connector filter");
+}
+
+} // namespace
+
+ProcEvents::ProcEvents()
+{
+	sockaddr_nl addr {};
+
+	fd_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+	if (fd_ < 0)
+		throw sys_error("proc connector socket");
+
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+	try {
+		/* Before bind, so no unfiltered event is ever queued */
+		attach_exec_filter(fd_);
+		if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+			throw sys_error("proc connector bind");
+		subscribe(true);
+	} catch (...) {
+		close(fd_);
+		throw;
+	}
+}
+
+ProcEvents::~ProcEvents()
+{
+	subscribe(false);
+	close(fd_);
+}
+
+void ProcEvents::subscribe(bool on)
+{
+	alignas(nlmsghdr) char buf[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))] = {};
+	auto *nl = reinterpret_cast<nlmsghdr *>(buf);
+	auto *cn = static_cast<cn_msg *>(NLMSG_DATA(nl));
+	proc_cn_mcast_op op = on ? PROC_CN_MCAST_LISTEN : PROC_CN_MCAST_IGNORE;
+
+	nl->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(op));
+	nl->nlmsg_type = NLMSG_DONE;
+	nl->nlmsg_pid = static_cast<std::uint32_t>(getpid());
+	cn->id.idx = CN_IDX_PROC;
+	cn->id.val = CN_VAL_PROC;
+	cn->len = sizeof(op);
+	std::memcpy(cn->data, &op, sizeof(op));
+
+	/* Without CAP_NET_ADMIN this succeeds but no event ever arrives */
+	if (send(fd_, buf, nl->nlmsg_len, 0) < 0 && on)
+		throw sys_error("proc connector subscribe");
+}
+
+pid_t ProcEvents::next_exec()
+{
+	alignas(nlmsghdr) char buf[256];
+
+	for (;;) {
+		ssize_t len = recv(fd_, buf, sizeof(buf), 0);
+
+		if (len < 0) {
+			/* ENOBUFS: exec storm overflowed the socket, some were lost */
+			if (errno == EINTR || errno == ENOBUFS)
+				continue;
+			return 0;
+		}
+
+		auto *nl = reinterpret_cast<nlmsghdr *>(buf);
+		if (!NLMSG_OK(nl, static_cast<std::size_t>(len)) ||
+		    nl->nlmsg_len < NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_event)))
+			continue;
+
+		auto *cn = static_cast<cn_msg *>(NLMSG_DATA(nl));
+		auto *ev = reinterpret_cast<proc_event *>(cn->data);
+		if (ev->what == proc_event::PROC_EVENT_EXEC)
+			return ev->event_data.exec.process_tgid;
+	}
+}
+
+std::string process_name(pid_t pid)
+{
+	char buf[32];
+	std::string path = "/proc/" + std::to_string(pid) + "/comm";
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	ssize_t len;
+
+	if (fd < 0)
+		return {};
+	len = read(fd, buf, sizeof(buf));
+	close(fd);
+	if (len <= 0)
+		return {};
+	if (buf[len - 1] == '\n')
+		len--;
+	return std::string(buf, static_cast<std::size_t>(len));
+}
+
+int open_pidfd(pid_t pid)
+{
+	return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+} // namespace opengigabyte
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Process exec events for the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Subscribes to the kernel's proc connector. A socket filter drops
+ * every event but exec in the kernel, so fork and exit storms never
+ * reach the daemon: it wakes once per exec. Exits of the processes it
+ * cares about are watched with pidfds instead. Needs CAP_NET_ADMIN.
+ */
+#ifndef OPENGIGABYTE_PROC_EVENTS_HPP
+#define OPENGIGABYTE_PROC_EVENTS_HPP
+
+#include <string>
+#include <sys/types.h>
+
+namespace opengigabyte {
+
+class ProcEvents {
+public:
+	ProcEvents();
+	~ProcEvents();
+
+	ProcEvents(const ProcEvents &) = delete;
+	ProcEvents &operator=(const ProcEvents &) = delete;
+
+	int fd() const { return fd_; }
+
+	/* Call fn(pid) for every pending exec event */
+	template <typename Fn>
+	void drain(Fn &&fn)
+	{
+		pid_t pid;
+
+		while ((pid = next_exec()) > 0)
+			fn(pid);
+	}
+
+private:
+	/* Next exec'd process, 0 once none is pending */
+	pid_t next_exec();
+	void subscribe(bool on);
+
+	int fd_ = -1;
+};
+
+/* The process' name as in /proc/<pid>/comm, empty if it is gone */
+std::string process_name(pid_t pid);
+
+/* pidfd that becomes readable when @pid exits, -1 if it already has */
+int open_pidfd(pid_t pid);
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_PROC_EVENTS_HPP */
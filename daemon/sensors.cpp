@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Sensor and driver state readings for the status block.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "sensors.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../driver/gigabytekbd_driver.h"
+
+namespace opengigabyte {
+
+namespace {
+
+constexpr char kHwmonDir[] = "/sys/class/hwmon/";
+constexpr char kBacklightDir[] = "/sys/class/backlight/";
+constexpr char kKbdDriverDir[] = "/sys/bus/hid/drivers/gigabytekbd/";
+
+/* sysfs value, -1 if unreadable */
+int read_value(int fd)
+{
+	char buf[24];
+	ssize_t len;
+
+	if (fd < 0)
+		return -1;
+	len = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+	return std::atoi(buf);
+}
+
+std::string read_name(const std::string &path)
+{
+	char buf[64];
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	ssize_t len = fd >= 0 ? read(fd, buf, sizeof(buf)) : -1;
+
+	if (fd >= 0)
+		close(fd);
+	if (len <= 0)
+		return {};
+	return std::string(buf, static_cast<std::size_t>(len - (buf[len - 1] == '\n')));
+}
+
+std::vector<std::string> list_dir(const char *path)
+{
+	std::vector<std::string> names;
+
+	if (DIR *dir = opendir(path)) {
+		while (dirent *de = readdir(dir))
+			if (de->d_name[0] != '.')
+				names.push_back(de->d_name);
+		closedir(dir);
+	}
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+/* Prefer the panel gigabytekbd controls, else the first one */
+std::string find_backlight()
+{
+	std::vector<std::string> names = list_dir(kBacklightDir);
+
+	for (const std::string &name : names)
+		if (name == GIGABYTE_KBD_BACKLIGHT_DEVICE_NAME)
+			return name;
+	return names.empty() ? std::string() : names[0];
+}
+
+} // namespace
+
+Sensors::Sensors()
+{
+	for (const std::string &hwmon : list_dir(kHwmonDir)) {
+		std::string base = kHwmonDir + hwmon + "/";
+		std::string name = read_name(base + "name");
+
+		for (const std::string &file : list_dir(base.c_str())) {
+			bool fan = file.compare(0, 3, "fan") == 0;
+			bool temp = file.compare(0, 4, "temp") == 0;
+
+			if ((!fan && !temp) || file.size() < 6 ||
+			    file.compare(file.size() - 6, 6, "_input") != 0)
+				continue;
+			if ((fan && fans_.size() >= kStatusFans) ||
+			    (temp && temps_.size() >= kStatusTemps))
+				continue;
+			/* One temperature per chip: the first is the package or zone */
+			if (temp && !temps_.empty() && temps_.back().label == name)
+				continue;
+
+			int fd = open((base + file).c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+				continue;
+			(fan ? fans_ : temps_).push_back({ fd, name });
+		}
+	}
+}
+
+Sensors::~Sensors()
+{
+	for (const Input &in : fans_)
+		close(in.fd);
+	for (const Input &in : temps_)
+		close(in.fd);
+}
+
+bool Sensors::sample(StatusData &data)
+{
+	StatusData old = data;
+
+	data.fan_count = static_cast<std::uint32_t>(fans_.size());
+	for (std::size_t i = 0; i < fans_.size(); i++)
+		data.fan_rpm[i] = read_value(fans_[i].fd);
+
+	data.temp_count = static_cast<std::uint32_t>(temps_.size());
+	for (std::size_t i = 0; i < temps_.size(); i++) {
+		data.temp_mc[i] = read_value(temps_[i].fd);
+		std::strncpy(data.temp_label[i], temps_[i].label.c_str(),
+			     sizeof(data.temp_label[i]) - 1);
+	}
+
+	return std::memcmp(&old, &data, sizeof(data)) != 0;
+}
+
+DriverState::DriverState()
+{
+	/* Every bound interface shows the same touchpad state; take the first */
+	for (const std::string &name : list_dir(kKbdDriverDir)) {
+		touchpad_fd_ = open((kKbdDriverDir + name + "/touchpad").c_str(),
+				    O_RDONLY | O_CLOEXEC);
+		if (touchpad_fd_ >= 0)
+			break;
+	}
+
+	std::string backlight = find_backlight();
+	if (!backlight.empty()) {
+		std::string base = kBacklightDir + backlight + "/";
+		int fd = open((base + "max_brightness").c_str(), O_RDONLY | O_CLOEXEC);
+
+		max_brightness_ = read_value(fd);
+		if (fd >= 0)
+			close(fd);
+		brightness_fd_ = open((base + "actual_brightness").c_str(), O_RDONLY | O_CLOEXEC);
+		bl_power_fd_ = open((base + "bl_power").c_str(), O_RDONLY | O_CLOEXEC);
+	}
+
+	for (int fd : { touchpad_fd_, brightness_fd_, bl_power_fd_ })
+		if (fd >= 0)
+			fds_.push_back(fd);
+}
+
+DriverState::~DriverState()
+{
+	for (int fd : fds_)
+		close(fd);
+}
+
+bool DriverState::read(StatusData &data)
+{
+	int touchpad = read_value(touchpad_fd_);
+	int bl_power = read_value(bl_power_fd_);
+	int brightness = read_value(brightness_fd_);
+	bool changed = false;
+
+	auto update = [&changed](auto &field, int value) {
+		if (field != value) {
+			field = value;
+			changed = true;
+		}
+	};
+	update(data.touchpad, touchpad < 0 ? -1 : touchpad != 0);
+	update(data.backlight, brightness);
+	update(data.backlight_max, max_brightness_);
+	/* FB_BLANK_UNBLANK is 0, anything else is some level of off */
+	update(data.backlight_power, bl_power < 0 ? -1 : bl_power == 0);
+	return changed;
+}
+
+} // namespace opengigabyte
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Sensor and driver state readings for the status block.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * The sysfs files are found and opened once; a read is one pread() per
+ * value. Fan speeds often come from the EC, so the daemon samples them
+ * only while a client is looking. Touchpad and backlight state is never
+ * sampled: the kernel notifies those attributes when they change.
+ */
+#ifndef OPENGIGABYTE_SENSORS_HPP
+#define OPENGIGABYTE_SENSORS_HPP
+
+#include <string>
+#include <vector>
+
+#include "status.hpp"
+
+namespace opengigabyte {
+
+class Sensors {
+public:
+	Sensors();
+	~Sensors();
+
+	Sensors(const Sensors &) = delete;
+	Sensors &operator=(const Sensors &) = delete;
+
+	/* Update the sensor fields of @data; true if any of them changed */
+	bool sample(StatusData &data);
+
+private:
+	struct Input {
+		int fd;
+		std::string label;
+	};
+
+	std::vector<Input> fans_;
+	std::vector<Input> temps_;
+};
+
+/*
+ * The gigabytekbd touchpad attribute and the backlight's bl_power and
+ * actual_brightness. gigabytekbd and the backlight core sysfs_notify()
+ * them, which wakes EPOLLPRI waiters on the fds; every file has to be
+ * read again afterwards to rearm it. Missing files read as unknown.
+ */
+class DriverState {
+public:
+	DriverState();
+	~DriverState();
+
+	DriverState(const DriverState &) = delete;
+	DriverState &operator=(const DriverState &) = delete;
+
+	/* Open attributes, for EPOLLPRI */
+	const std::vector<int> &fds() const { return fds_; }
+
+	/* Read every attribute again; true if the fields of @data changed */
+	bool read(StatusData &data);
+
+private:
+	int touchpad_fd_ = -1;
+	int brightness_fd_ = -1;
+	int bl_power_fd_ = -1;
+	int max_brightness_ = -1;
+	std::vector<int> fds_;
+};
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_SENSORS_HPP */
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Shared memory status block of the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * The daemon publishes its state in a small file on tmpfs that clients
+ * map read-only. Writes are guarded by a sequence count (a seqlock):
+ * odd while an update is in progress, bumped to the next even value
+ * when it is done. Readers copy the data and retry if the count moved.
+ * The count doubles as a shared futex word: the daemon wakes every
+ * waiter on it after each update, so a client blocks in status_wait()
+ * instead of polling.
+ *
+ * Sensors (fans, temperatures) are only sampled while some process has
+ * the file open. Clients keep their fd open for as long as they want
+ * fresh sensor values; profile, power, touchpad and backlight changes
+ * are always published, as the kernel notifies the daemon of them.
+ *
+ * Header only on the client side; the layout is part of the ABI and
+ * kStatusVersion changes whenever it does.
+ */
+#ifndef OPENGIGABYTE_STATUS_HPP
+#define OPENGIGABYTE_STATUS_HPP
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace opengigabyte {
+
+constexpr char kStatusPath[] = "/run/opengigabyte/status";
+constexpr std::uint32_t kStatusMagic = 0x5453474f;	/* "OGST" */
+constexpr std::uint32_t kStatusVersion = 1;
+
+constexpr unsigned int kStatusFans = 4;
+constexpr unsigned int kStatusTemps = 8;
+constexpr unsigned int kStatusNameLen = 32;
+
+enum StatusPower : std::uint8_t {
+	kStatusPowerUnknown = 0,
+	kStatusPowerAC = 1,
+	kStatusPowerBattery = 2,
+};
+
+/* Everything a tray applet shows. Unknown values are -1 */
+struct StatusData {
+	std::uint64_t updated_ns;		/* CLOCK_MONOTONIC of the last update */
+	char profile[kStatusNameLen];		/* NUL terminated, empty before the first */
+	std::uint8_t power;			/* StatusPower */
+	std::uint8_t workload;			/* 1 while a workload holds the profile */
+	std::int8_t touchpad;			/* 1 on, 0 off */
+	std::int8_t backlight_power;		/* 1 on, 0 blanked */
+	std::int32_t backlight;			/* Brightness, 0 to backlight_max */
+	std::int32_t backlight_max;
+	std::uint32_t fan_count;
+	std::uint32_t temp_count;
+	std::int32_t fan_rpm[kStatusFans];
+	std::int32_t temp_mc[kStatusTemps];	/* Millidegrees Celsius */
+	char temp_label[kStatusTemps][16];	/* hwmon name of each temperature */
+};
+
+struct StatusBlock {
+	std::uint32_t magic;			/* kStatusMagic */
+	std::uint32_t version;			/* kStatusVersion */
+	std::uint32_t size;			/* sizeof(StatusBlock) */
+	std::uint32_t seq;			/* Seqlock count and futex word */
+	StatusData data;
+};
+
+/* True if @block was written by a daemon using this layout */
+inline bool status_valid(const StatusBlock *block)
+{
+	return block->magic == kStatusMagic && block->version == kStatusVersion &&
+	       block->size == sizeof(StatusBlock);
+}
+
+/* Take a consistent copy of the data; returns the (even) count it matches */
+inline std::uint32_t status_read(const StatusBlock *block, StatusData &out)
+{
+	std::uint32_t seq;
+
+	for (;;) {
+		seq = __atomic_load_n(&block->seq, __ATOMIC_ACQUIRE);
+		/* The daemon holds it odd for a memcpy; just spin */
+		if (seq & 1)
+			continue;
+		std::memcpy(&out, const_cast<const StatusData *>(&block->data), sizeof(out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&block->seq, __ATOMIC_RELAXED) == seq)
+			return seq;
+	}
+}
+
+/*
+ * Sleep until the daemon publishes an update after the one @seq came
+ * from, or @timeout (relative, may be null) passes. Returns 0 on an
+ * update, -ETIMEDOUT or -EINTR otherwise.
+ */
+inline int status_wait(const StatusBlock *block, std::uint32_t seq, const timespec *timeout)
+{
+	long ret;
+
+	if (__atomic_load_n(&block->seq, __ATOMIC_ACQUIRE) != seq)
+		return 0;
+	/* Not FUTEX_PRIVATE: the word is shared with the daemon's mapping */
+	ret = syscall(SYS_futex, &block->seq, FUTEX_WAIT, seq, timeout, nullptr, 0);
+	if (ret < 0 && errno != EAGAIN)
+		return -errno;
+	return 0;
+}
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_STATUS_HPP */
@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Daemon side of the shared memory status block.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "status_writer.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace opengigabyte {
+
+namespace {
+
+std::runtime_error sys_error(const std::string &what)
+{
+	return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+StatusWriter::StatusWriter(const std::string &path)
+	: path_(path)
+{
+	std::string dir = path.substr(0, path.rfind('/'));
+	void *map;
+
+	if (!dir.empty())
+		mkdir(dir.c_str(), 0755);
+
+	/* Readable by everyone, no truncation: mapped clients survive a restart */
+	fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd_ < 0)
+		throw sys_error(path);
+	fchmod(fd_, 0644);
+	if (ftruncate(fd_, sizeof(StatusBlock)) < 0) {
+		close(fd_);
+		throw sys_error(path);
+	}
+	map = mmap(nullptr, sizeof(StatusBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+	if (map == MAP_FAILED) {
+		close(fd_);
+		throw sys_error(path);
+	}
+	block_ = static_cast<StatusBlock *>(map);
+
+	/* Continue the count, so clients waiting on the old one wake up */
+	std::uint32_t seq = __atomic_load_n(&block_->seq, __ATOMIC_RELAXED);
+	__atomic_store_n(&block_->seq, seq | 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	block_->magic = kStatusMagic;
+	block_->version = kStatusVersion;
+	block_->size = sizeof(StatusBlock);
+	std::memset(&block_->data, 0, sizeof(block_->data));
+	__atomic_store_n(&block_->seq, (seq | 1) + 1, __ATOMIC_RELEASE);
+
+	/* Our own open came before the watch, so it isn't counted */
+	inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd_ < 0 || inotify_add_watch(inotify_fd_, path.c_str(), IN_OPEN | IN_CLOSE) < 0) {
+		munmap(block_, sizeof(StatusBlock));
+		close(fd_);
+		if (inotify_fd_ >= 0)
+			close(inotify_fd_);
+		throw sys_error("inotify " + path);
+	}
+}
+
+StatusWriter::~StatusWriter()
+{
+	close(inotify_fd_);
+	munmap(block_, sizeof(StatusBlock));
+	close(fd_);
+}
+
+void StatusWriter::publish(const StatusData &data)
+{
+	std::uint32_t seq = __atomic_load_n(&block_->seq, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&block_->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	std::memcpy(&block_->data, &data, sizeof(data));
+	__atomic_store_n(&block_->seq, seq + 2, __ATOMIC_RELEASE);
+
+	syscall(SYS_futex, &block_->seq, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+unsigned int StatusWriter::update_readers()
+{
+	alignas(inotify_event) char buf[4096];
+	ssize_t len;
+
+	while ((len = read(inotify_fd_, buf, sizeof(buf))) > 0) {
+		for (char *p = buf; p < buf + len; ) {
+			auto *ev = reinterpret_cast<inotify_event *>(p);
+
+			if (ev->mask & IN_OPEN)
+				readers_++;
+			if (ev->mask & (IN_CLOSE_WRITE | IN_CLOSE_NOWRITE))
+				readers_--;
+			/* Lost count: assume someone is still reading */
+			if (ev->mask & IN_Q_OVERFLOW)
+				readers_ = 1;
+			p += sizeof(*ev) + ev->len;
+		}
+	}
+	if (readers_ < 0)
+		readers_ = 0;
+	return static_cast<unsigned int>(readers_);
+}
+
+} // namespace opengigabyte
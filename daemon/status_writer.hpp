@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Daemon side of the shared memory status block.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+#ifndef OPENGIGABYTE_STATUS_WRITER_HPP
+#define OPENGIGABYTE_STATUS_WRITER_HPP
+
+#include <string>
+
+#include "status.hpp"
+
+namespace opengigabyte {
+
+class StatusWriter {
+public:
+	/* Create or reuse @path; clients that mapped it before keep working */
+	explicit StatusWriter(const std::string &path);
+	~StatusWriter();
+
+	StatusWriter(const StatusWriter &) = delete;
+	StatusWriter &operator=(const StatusWriter &) = delete;
+
+	/* Copy @data in under the seqlock and wake every waiting client */
+	void publish(const StatusData &data);
+
+	/*
+	 * inotify fd reporting opens and closes of the file by clients;
+	 * feed its events to update_readers().
+	 */
+	int watch_fd() const { return inotify_fd_; }
+	/* Drain the watch; returns the number of clients with the file open */
+	unsigned int update_readers();
+
+private:
+	std::string path_;
+	int fd_ = -1;
+	int inotify_fd_ = -1;
+	int readers_ = 0;
+	StatusBlock *block_ = nullptr;
+};
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_STATUS_WRITER_HPP */
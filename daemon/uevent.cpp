@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Kernel uevent listener for the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "uevent.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace opengigabyte {
+
+namespace {
+
+constexpr unsigned int kKernelGroup = 1;	/* udevd listens on group 2 */
+constexpr std::size_t kMaxUevent = 8192;	/* UEVENT_BUFFER_SIZE is 2048 */
+
+} // namespace
+
+std::string Uevent::get(const std::string &key) const
+{
+	std::string prefix = key + "=";
+	std::size_t pos = 0;
+
+	while (pos < env.size()) {
+		std::size_t end = env.find('\0', pos);
+
+		if (end == std::string::npos)
+			end = env.size();
+		if (env.compare(pos, prefix.size(), prefix) == 0)
+			return env.substr(pos + prefix.size(), end - pos - prefix.size());
+		pos = end + 1;
+	}
+	return {};
+}
+
+UeventMonitor::UeventMonitor()
+{
+	sockaddr_nl addr {};
+
+	fd_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		     NETLINK_KOBJECT_UEVENT);
+	if (fd_ < 0)
+		throw std::runtime_error(std::string("uevent socket: ") + std::strerror(errno));
+
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = kKernelGroup;
+	if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+		int err = errno;
+
+		close(fd_);
+		throw std::runtime_error(std::string("uevent bind: ") + std::strerror(err));
+	}
+}
+
+UeventMonitor::~UeventMonitor()
+{
+	close(fd_);
+}
+
+bool UeventMonitor::receive(Uevent &ev)
+{
+	char buf[kMaxUevent];
+	sockaddr_nl addr {};
+	iovec iov = { buf, sizeof(buf) };
+	msghdr msg {};
+	std::size_t header;
+	ssize_t len;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	for (;;) {
+		msg.msg_name = &addr;
+		msg.msg_namelen = sizeof(addr);
+		len = recvmsg(fd_, &msg, 0);
+		if (len < 0) {
+			/* ENOBUFS: the socket overflowed and events were lost, carry on */
+			if (errno == EINTR || errno == ENOBUFS)
+				continue;
+			return false;
+		}
+		/* Only trust the kernel, never another process on the group */
+		if (addr.nl_pid != 0 || len == 0)
+			continue;
+
+		/* "action@devpath\0KEY=VALUE\0..." */
+		header = strnlen(buf, static_cast<std::size_t>(len));
+		if (header < static_cast<std::size_t>(len) && std::memchr(buf, '@', header))
+			break;
+	}
+
+	ev = Uevent();
+	ev.env.assign(buf + header + 1, static_cast<std::size_t>(len) - header - 1);
+	ev.action = ev.get("ACTION");
+	ev.subsystem = ev.get("SUBSYSTEM");
+	ev.devpath = ev.get("DEVPATH");
+	ev.devname = ev.get("DEVNAME");
+	return true;
+}
+
+} // namespace opengigabyte
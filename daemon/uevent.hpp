@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Kernel uevent listener for the OpenGigabyte daemon.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Reads uevents straight from the kernel's netlink multicast group, so
+ * the daemon needs neither libudev nor a running udevd.
+ */
+#ifndef OPENGIGABYTE_UEVENT_HPP
+#define OPENGIGABYTE_UEVENT_HPP
+
+#include <string>
+
+namespace opengigabyte {
+
+struct Uevent {
+	std::string action;		/* add, remove, change, ... */
+	std::string subsystem;
+	std::string devpath;
+	std::string devname;		/* Relative to /dev, empty without a node */
+	std::string env;		/* All KEY=VALUE pairs, NUL separated */
+
+	/* Value of @key in env, empty if missing */
+	std::string get(const std::string &key) const;
+};
+
+class UeventMonitor {
+public:
+	UeventMonitor();
+	~UeventMonitor();
+
+	UeventMonitor(const UeventMonitor &) = delete;
+	UeventMonitor &operator=(const UeventMonitor &) = delete;
+
+	int fd() const { return fd_; }
+
+	/* Receive one uevent; false once none is pending */
+	bool receive(Uevent &ev);
+
+private:
+	int fd_ = -1;
+};
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_UEVENT_HPP */
@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __HID_GIGABYTE_CORE_H
+#define __HID_GIGABYTE_CORE_H
+
+#include <linux/hid.h>
+#include <linux/types.h>
+
+/*
+ * Feature report queue shared by the Gigabyte drivers.
+ *
+ * Writes are queued and sent from a worker, so sysfs stores don't wait
+ * for the device. A write with the same non-zero key as one still
+ * waiting replaces it in place: only the latest color or DPI set is
+ * sent. The driver can pack consecutive writes into one transfer when
+ * its protocol allows. Failed transfers are retried; writes that could
+ * not be sent within the queue timeout are dropped.
+ *
+ * Queue depth, transfer counts and latency are in
+ * /sys/kernel/debug/gigabytecore/<hid device>/stats.
+ */
+struct gigabyte_core_queue;
+
+struct gigabyte_core_ops {
+	/*
+	 * Optional. Append cmd to the transfer in buf (len bytes used, size
+	 * available) if the device takes both in one report; return false
+	 * to send them separately. Called under a spinlock, must not sleep.
+	 */
+	bool (*merge)(void *ctx, u8 *buf, size_t *len, size_t size,
+		      const u8 *cmd, size_t cmd_len);
+	/* Optional. Called from the worker when a write is sent or dropped */
+	void (*done)(void *ctx, u32 key, int err);
+};
+
+/* Writes with this key are never coalesced */
+#define GIGABYTE_CORE_KEY_NONE	0
+
+struct gigabyte_core_queue *gigabyte_core_queue_create(struct hid_device *hdev,
+						       const struct gigabyte_core_ops *ops,
+						       void *ctx, size_t max_len);
+void gigabyte_core_queue_destroy(struct gigabyte_core_queue *q);
+
+int gigabyte_core_set_report(struct gigabyte_core_queue *q, u32 key,
+			     const u8 *buf, size_t len);
+int gigabyte_core_flush(struct gigabyte_core_queue *q, unsigned int ms);
+int gigabyte_core_get_report(struct gigabyte_core_queue *q, u8 *buf, size_t len);
+int gigabyte_core_transact(struct gigabyte_core_queue *q, u8 *buf, size_t len);
+unsigned int gigabyte_core_depth(struct gigabyte_core_queue *q);
+
+/*
+ * Power source, for drivers with a per-source policy. Registered
+ * notifiers get the new source as action when the system switches
+ * between AC and battery.
+ */
+enum gigabyte_core_power_source {
+	GIGABYTE_CORE_POWER_AC,
+	GIGABYTE_CORE_POWER_BATTERY,
+};
+
+struct notifier_block;
+
+int gigabyte_core_power_register(struct notifier_block *nb);
+void gigabyte_core_power_unregister(struct notifier_block *nb);
+enum gigabyte_core_power_source gigabyte_core_power_source(void);
+
+#endif /* __HID_GIGABYTE_CORE_H */
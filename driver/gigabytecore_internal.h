@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __HID_GIGABYTE_CORE_INTERNAL_H
+#define __HID_GIGABYTE_CORE_INTERNAL_H
+
+/* Shared between the gigabytecore source files, not exported */
+int gigabyte_core_power_init(void);
+void gigabyte_core_power_exit(void);
+
+#endif /* __HID_GIGABYTE_CORE_INTERNAL_H */
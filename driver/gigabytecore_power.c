@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Power source tracking shared by the Gigabyte HID drivers
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * One power supply notifier for all drivers. Only adapter events are
+ * looked at; battery capacity updates return straight away, so nothing
+ * runs while the power source stays the same.
+ */
+
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/power_supply.h>
+#include <linux/workqueue.h>
+#include "gigabytecore.h"
+#include "gigabytecore_internal.h"
+
+static DEFINE_MUTEX(gigabyte_core_power_lock);	/* Orders source changes and callbacks */
+static BLOCKING_NOTIFIER_HEAD(gigabyte_core_power_chain);
+static enum gigabyte_core_power_source gigabyte_core_power;
+
+static enum gigabyte_core_power_source gigabyte_core_power_read(void)
+{
+	/* No power supplies at all (-ENODEV) means a desktop: count as AC */
+	return power_supply_is_system_supplied() == 0 ?
+	       GIGABYTE_CORE_POWER_BATTERY : GIGABYTE_CORE_POWER_AC;
+}
+
+static void gigabyte_core_power_update(struct work_struct *work)
+{
+	enum gigabyte_core_power_source source = gigabyte_core_power_read();
+
+	mutex_lock(&gigabyte_core_power_lock);
+	if (source != gigabyte_core_power) {
+		WRITE_ONCE(gigabyte_core_power, source);
+		pr_debug("gigabytecore: running on %s\n",
+			 source == GIGABYTE_CORE_POWER_AC ? "AC" : "battery");
+		blocking_notifier_call_chain(&gigabyte_core_power_chain, source, NULL);
+	}
+	mutex_unlock(&gigabyte_core_power_lock);
+}
+
+static DECLARE_WORK(gigabyte_core_power_work, gigabyte_core_power_update);
+
+/* Atomic notifier chain: the policy callbacks sleep, so hand over to a worker */
+static int gigabyte_core_psy_notify(struct notifier_block *nb,
+				    unsigned long event, void *data)
+{
+	struct power_supply *psy = data;
+
+	if (event == PSY_EVENT_PROP_CHANGED && psy->desc->type != POWER_SUPPLY_TYPE_BATTERY)
+		schedule_work(&gigabyte_core_power_work);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block gigabyte_core_psy_nb = {
+	.notifier_call = gigabyte_core_psy_notify,
+};
+
+/**
+ * gigabyte_core_power_register - follow AC/battery changes
+ * @nb: called with the new enum gigabyte_core_power_source as action
+ *
+ * @nb is called once right away with the current source, then on every
+ * change, always from process context and never concurrently.
+ */
+int gigabyte_core_power_register(struct notifier_block *nb)
+{
+	int ret;
+
+	mutex_lock(&gigabyte_core_power_lock);
+	ret = blocking_notifier_chain_register(&gigabyte_core_power_chain, nb);
+	if (!ret)
+		nb->notifier_call(nb, gigabyte_core_power, NULL);
+	mutex_unlock(&gigabyte_core_power_lock);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(gigabyte_core_power_register);
+
+void gigabyte_core_power_unregister(struct notifier_block *nb)
+{
+	blocking_notifier_chain_unregister(&gigabyte_core_power_chain, nb);
+}
+EXPORT_SYMBOL_GPL(gigabyte_core_power_unregister);
+
+enum gigabyte_core_power_source gigabyte_core_power_source(void)
+{
+	return READ_ONCE(gigabyte_core_power);
+}
+EXPORT_SYMBOL_GPL(gigabyte_core_power_source);
+
+int gigabyte_core_power_init(void)
+{
+	gigabyte_core_power = gigabyte_core_power_read();
+	return power_supply_reg_notifier(&gigabyte_core_psy_nb);
+}
+
+void gigabyte_core_power_exit(void)
+{
+	power_supply_unreg_notifier(&gigabyte_core_psy_nb);
+	cancel_work_sync(&gigabyte_core_power_work);
+}
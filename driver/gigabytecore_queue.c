@@ -0,0 +1,502 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Feature report queue shared by the Gigabyte HID drivers
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Each device gets a queue of pending writes and a work item that sends
+ * them in order, one transfer at a time. See gigabytecore.h for the API.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/hid.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/overflow.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include "gigabytecore.h"
+#include "gigabytecore_internal.h"
+
+MODULE_AUTHOR("Hemanth Bollamreddi <blmhemu@gmail.com>");
+MODULE_DESCRIPTION("Feature report queue and power source tracking for the Gigabyte HID drivers.");
+MODULE_LICENSE("GPL v2");
+
+static unsigned int retries = 3;
+module_param(retries, uint, 0644);
+MODULE_PARM_DESC(retries, "Times a failed transfer is retried (default: 3)");
+
+static unsigned int timeout_ms = 1000;
+module_param(timeout_ms, uint, 0644);
+MODULE_PARM_DESC(timeout_ms, "Writes not sent this long after being queued are dropped (default: 1000)");
+
+#define GIGABYTE_CORE_RETRY_DELAY_MS	5	/* Doubles on each retry */
+#define GIGABYTE_CORE_LATENCY_BUCKETS	20	/* log2 of microseconds, up to ~0.5 s */
+
+struct gigabyte_core_cmd {
+	struct list_head node;
+	u32 key;
+	ktime_t queued;		/* Newest submission, refreshed when coalesced */
+	size_t len;
+	u8 data[];
+};
+
+struct gigabyte_core_stats {
+	u64 submitted;		/* Writes handed to the queue */
+	u64 coalesced;		/* Writes that replaced a waiting one */
+	u64 batched;		/* Writes sent in another write's transfer */
+	u64 transfers;		/* SET_REPORT requests, retries included */
+	u64 retries;
+	u64 timeouts;		/* Writes dropped for waiting too long */
+	u64 errors;		/* Writes dropped after failing */
+	unsigned int depth;
+	unsigned int max_depth;
+	u64 completed;		/* Writes sent or dropped */
+	u64 latency_sum_us;	/* Queued to sent or dropped */
+	u64 latency_max_us;
+	u64 latency[GIGABYTE_CORE_LATENCY_BUCKETS];
+};
+
+struct gigabyte_core_queue {
+	struct hid_device *hdev;
+	const struct gigabyte_core_ops *ops;
+	void *ctx;
+	size_t max_len;
+	u8 *buf;			/* Transfer buffer, only used by the worker */
+
+	struct mutex io_lock;		/* Serializes requests to the device */
+	spinlock_t lock;		/* Protects everything below */
+	struct list_head pending;
+	bool busy;			/* Worker has commands off the list */
+	bool dead;
+	int last_error;			/* First error since the last flush */
+	struct gigabyte_core_stats stats;
+
+	struct work_struct work;
+	wait_queue_head_t idle;
+	struct dentry *debugfs;
+};
+
+static struct workqueue_struct *gigabyte_core_wq;
+static struct dentry *gigabyte_core_debugfs;
+
+/* Errors a second attempt can get past; others mean the device is gone */
+static bool gigabyte_core_retryable(int err)
+{
+	return err == -EPIPE || err == -ETIMEDOUT || err == -EIO || err == -EPROTO ||
+	       err == -EAGAIN || err == -EBUSY;
+}
+
+/*
+ * With req, each attempt is a SET_REPORT of req followed by a GET_REPORT
+ * into buf, both under io_lock so nothing else reaches the device between
+ * the question and its answer.
+ */
+static int gigabyte_core_request(struct gigabyte_core_queue *q, u8 *buf, size_t len,
+				 enum hid_class_request reqtype, const u8 *req,
+				 ktime_t deadline)
+{
+	unsigned int attempt;
+	int ret;
+
+	for (attempt = 0; ; attempt++) {
+		if (ktime_after(ktime_get(), deadline))
+			return -ETIMEDOUT;
+
+		mutex_lock(&q->io_lock);
+		if (req) {
+			memcpy(buf, req, len);
+			ret = hid_hw_raw_request(q->hdev, buf[0], buf, len, HID_FEATURE_REPORT,
+						 HID_REQ_SET_REPORT);
+			if (ret >= 0)
+				ret = hid_hw_raw_request(q->hdev, req[0], buf, len,
+							 HID_FEATURE_REPORT, reqtype);
+		} else {
+			ret = hid_hw_raw_request(q->hdev, buf[0], buf, len, HID_FEATURE_REPORT,
+						 reqtype);
+		}
+		mutex_unlock(&q->io_lock);
+
+		spin_lock_irq(&q->lock);
+		q->stats.transfers += req || reqtype == HID_REQ_SET_REPORT;
+		q->stats.retries += attempt > 0;
+		spin_unlock_irq(&q->lock);
+
+		if (ret >= 0 || attempt >= READ_ONCE(retries) || !gigabyte_core_retryable(ret))
+			return ret;
+		msleep(GIGABYTE_CORE_RETRY_DELAY_MS << min(attempt, 6U));
+	}
+}
+
+/* Called with q->lock held */
+static void gigabyte_core_account(struct gigabyte_core_queue *q,
+				  const struct gigabyte_core_cmd *cmd, ktime_t now, int err)
+{
+	struct gigabyte_core_stats *s = &q->stats;
+	u64 us = ktime_to_us(ktime_sub(now, cmd->queued));
+
+	s->completed++;
+	s->latency_sum_us += us;
+	s->latency_max_us = max(s->latency_max_us, us);
+	s->latency[min_t(unsigned int, us ? ilog2(us) + 1 : 0,
+			 GIGABYTE_CORE_LATENCY_BUCKETS - 1)]++;
+
+	if (err == -ETIMEDOUT)
+		s->timeouts++;
+	else if (err)
+		s->errors++;
+	if (err && !q->last_error)
+		q->last_error = err;
+}
+
+static void gigabyte_core_work(struct work_struct *work)
+{
+	struct gigabyte_core_queue *q = container_of(work, struct gigabyte_core_queue, work);
+	struct gigabyte_core_cmd *cmd, *next, *tmp;
+	LIST_HEAD(batch);
+	ktime_t deadline, newest, now;
+	size_t len;
+	int ret;
+
+	for (;;) {
+		spin_lock_irq(&q->lock);
+		cmd = list_first_entry_or_null(&q->pending, struct gigabyte_core_cmd, node);
+		if (!cmd || q->dead) {
+			q->busy = false;
+			spin_unlock_irq(&q->lock);
+			wake_up_all(&q->idle);
+			return;
+		}
+
+		q->busy = true;
+		list_move_tail(&cmd->node, &batch);
+		q->stats.depth--;
+		memcpy(q->buf, cmd->data, cmd->len);
+		len = cmd->len;
+		newest = cmd->queued;
+
+		/* Pack whatever follows into the same transfer, while the device takes it */
+		while (q->ops->merge &&
+		       (next = list_first_entry_or_null(&q->pending, struct gigabyte_core_cmd, node)) &&
+		       q->ops->merge(q->ctx, q->buf, &len, q->max_len, next->data, next->len)) {
+			/* A batch lives as long as its newest write */
+			if (ktime_after(next->queued, newest))
+				newest = next->queued;
+			list_move_tail(&next->node, &batch);
+			q->stats.depth--;
+			q->stats.batched++;
+		}
+		spin_unlock_irq(&q->lock);
+
+		deadline = ktime_add_ms(newest, READ_ONCE(timeout_ms));
+		ret = gigabyte_core_request(q, q->buf, len, HID_REQ_SET_REPORT, NULL, deadline);
+		if (ret > 0)
+			ret = 0;
+		now = ktime_get();
+
+		spin_lock_irq(&q->lock);
+		list_for_each_entry(cmd, &batch, node)
+			gigabyte_core_account(q, cmd, now, ret);
+		spin_unlock_irq(&q->lock);
+
+		if (ret)
+			hid_dbg(q->hdev, "Feature report 0x%02x dropped: %d\n", q->buf[0], ret);
+
+		list_for_each_entry_safe(cmd, tmp, &batch, node) {
+			if (q->ops->done)
+				q->ops->done(q->ctx, cmd->key, ret);
+			list_del(&cmd->node);
+			kfree(cmd);
+		}
+	}
+}
+
+/**
+ * gigabyte_core_set_report - queue a feature report write
+ * @q: the device's queue
+ * @key: writes with the same key replace each other while waiting,
+ *	GIGABYTE_CORE_KEY_NONE to always send this one
+ * @buf: the report, report ID first
+ * @len: its length, at most the queue's max_len
+ *
+ * Returns once the write is queued; errors sending it are passed to
+ * ->done and returned by the next gigabyte_core_flush(). May sleep.
+ */
+int gigabyte_core_set_report(struct gigabyte_core_queue *q, u32 key,
+			     const u8 *buf, size_t len)
+{
+	struct gigabyte_core_cmd *cmd, *new, *old = NULL;
+	unsigned long flags;
+
+	if (!len || len > q->max_len)
+		return -EINVAL;
+
+	new = kmalloc(struct_size(new, data, len), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+	new->key = key;
+	new->queued = ktime_get();
+	new->len = len;
+	memcpy(new->data, buf, len);
+
+	spin_lock_irqsave(&q->lock, flags);
+	if (q->dead) {
+		spin_unlock_irqrestore(&q->lock, flags);
+		kfree(new);
+		return -ENODEV;
+	}
+	q->stats.submitted++;
+
+	if (key != GIGABYTE_CORE_KEY_NONE) {
+		list_for_each_entry(cmd, &q->pending, node) {
+			if (cmd->key != key)
+				continue;
+			/*
+			 * Take its place in line but not its age: the deadline and
+			 * latency count from this submission, so a fresh write isn't
+			 * dropped for how long the one it replaces waited.
+			 */
+			list_replace(&cmd->node, &new->node);
+			q->stats.coalesced++;
+			old = cmd;
+			break;
+		}
+	}
+	if (!old) {
+		list_add_tail(&new->node, &q->pending);
+		q->stats.depth++;
+		q->stats.max_depth = max(q->stats.max_depth, q->stats.depth);
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	kfree(old);
+	queue_work(gigabyte_core_wq, &q->work);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(gigabyte_core_set_report);
+
+/**
+ * gigabyte_core_get_report - read a feature report
+ * @q: the device's queue
+ * @buf: report ID first, filled in with the report; must be DMA-safe
+ * @len: size of buf
+ *
+ * Retried like queued writes, but doesn't wait for them: call
+ * gigabyte_core_flush() first to read back what was written. Safe from
+ * ->done. Returns the report length or a negative error.
+ */
+int gigabyte_core_get_report(struct gigabyte_core_queue *q, u8 *buf, size_t len)
+{
+	return gigabyte_core_request(q, buf, len, HID_REQ_GET_REPORT, NULL,
+				     ktime_add_ms(ktime_get(), READ_ONCE(timeout_ms)));
+}
+EXPORT_SYMBOL_GPL(gigabyte_core_get_report);
+
+/**
+ * gigabyte_core_transact - write a request and read the device's answer
+ * @q: the device's queue
+ * @buf: the request, report ID first, replaced by the answer; must be DMA-safe
+ * @len: size of both
+ *
+ * SET_REPORT then GET_REPORT, with no other request to the device in
+ * between: a queued write can't land between the two and change the
+ * answer. The pair is retried as a whole like queued writes, but skips
+ * the queue: writes still waiting go out after it. Returns the answer's
+ * length or a negative error.
+ */
+int gigabyte_core_transact(struct gigabyte_core_queue *q, u8 *buf, size_t len)
+{
+	u8 *req;
+	int ret;
+
+	req = kmemdup(buf, len, GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+
+	ret = gigabyte_core_request(q, buf, len, HID_REQ_GET_REPORT, req,
+				    ktime_add_ms(ktime_get(), READ_ONCE(timeout_ms)));
+	kfree(req);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(gigabyte_core_transact);
+
+static bool gigabyte_core_idle(struct gigabyte_core_queue *q)
+{
+	bool idle;
+
+	spin_lock_irq(&q->lock);
+	idle = q->dead || (list_empty(&q->pending) && !q->busy);
+	spin_unlock_irq(&q->lock);
+	return idle;
+}
+
+/**
+ * gigabyte_core_flush - wait for queued writes to be sent
+ * @q: the device's queue
+ * @ms: how long to wait
+ *
+ * Returns the first error sending a write since the last flush, or
+ * -ETIMEDOUT if writes are still waiting. Not from ->done.
+ */
+int gigabyte_core_flush(struct gigabyte_core_queue *q, unsigned int ms)
+{
+	int ret;
+
+	if (!wait_event_timeout(q->idle, gigabyte_core_idle(q), msecs_to_jiffies(ms)))
+		return -ETIMEDOUT;
+
+	spin_lock_irq(&q->lock);
+	ret = q->last_error;
+	q->last_error = 0;
+	spin_unlock_irq(&q->lock);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(gigabyte_core_flush);
+
+/**
+ * gigabyte_core_depth - writes waiting to be sent
+ * @q: the device's queue
+ */
+unsigned int gigabyte_core_depth(struct gigabyte_core_queue *q)
+{
+	unsigned int depth;
+
+	spin_lock_irq(&q->lock);
+	depth = q->stats.depth;
+	spin_unlock_irq(&q->lock);
+	return depth;
+}
+EXPORT_SYMBOL_GPL(gigabyte_core_depth);
+
+static int gigabyte_core_stats_show(struct seq_file *m, void *v)
+{
+	struct gigabyte_core_queue *q = m->private;
+	struct gigabyte_core_stats s;
+	unsigned int i;
+
+	spin_lock_irq(&q->lock);
+	s = q->stats;
+	spin_unlock_irq(&q->lock);
+
+	seq_printf(m, "depth %u\nmax_depth %u\n", s.depth, s.max_depth);
+	seq_printf(m, "submitted %llu\ncoalesced %llu\nbatched %llu\n",
+		   s.submitted, s.coalesced, s.batched);
+	seq_printf(m, "transfers %llu\nretries %llu\ntimeouts %llu\nerrors %llu\n",
+		   s.transfers, s.retries, s.timeouts, s.errors);
+	seq_printf(m, "latency_avg_us %llu\nlatency_max_us %llu\n",
+		   s.completed ? div64_u64(s.latency_sum_us, s.completed) : 0, s.latency_max_us);
+
+	/* Bucket n holds latencies in [2^(n-1), 2^n) us, the last one the rest */
+	for (i = 0; i < GIGABYTE_CORE_LATENCY_BUCKETS - 1; i++) {
+		if (s.latency[i])
+			seq_printf(m, "latency_us<%lu %llu\n", 1UL << i, s.latency[i]);
+	}
+	if (s.latency[i])
+		seq_printf(m, "latency_us>=%lu %llu\n", 1UL << (i - 1), s.latency[i]);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(gigabyte_core_stats);
+
+/**
+ * gigabyte_core_queue_create - set up a device's feature report queue
+ * @hdev: the device, started
+ * @ops: driver callbacks, may be empty
+ * @ctx: passed to the callbacks
+ * @max_len: longest report that will be queued
+ */
+struct gigabyte_core_queue *gigabyte_core_queue_create(struct hid_device *hdev,
+						       const struct gigabyte_core_ops *ops,
+						       void *ctx, size_t max_len)
+{
+	struct gigabyte_core_queue *q;
+
+	q = kzalloc(sizeof(*q), GFP_KERNEL);
+	if (!q)
+		return NULL;
+
+	/* hid_hw_raw_request() may DMA from the buffer */
+	q->buf = kmalloc(max_len, GFP_KERNEL);
+	if (!q->buf) {
+		kfree(q);
+		return NULL;
+	}
+
+	q->hdev = hdev;
+	q->ops = ops;
+	q->ctx = ctx;
+	q->max_len = max_len;
+	mutex_init(&q->io_lock);
+	spin_lock_init(&q->lock);
+	INIT_LIST_HEAD(&q->pending);
+	INIT_WORK(&q->work, gigabyte_core_work);
+	init_waitqueue_head(&q->idle);
+
+	q->debugfs = debugfs_create_dir(dev_name(&hdev->dev), gigabyte_core_debugfs);
+	debugfs_create_file("stats", 0400, q->debugfs, q, &gigabyte_core_stats_fops);
+	return q;
+}
+EXPORT_SYMBOL_GPL(gigabyte_core_queue_create);
+
+/**
+ * gigabyte_core_queue_destroy - drop waiting writes and free the queue
+ * @q: the device's queue, may be NULL
+ *
+ * A transfer in progress is finished first. Call before hid_hw_stop().
+ */
+void gigabyte_core_queue_destroy(struct gigabyte_core_queue *q)
+{
+	struct gigabyte_core_cmd *cmd, *tmp;
+
+	if (!q)
+		return;
+
+	spin_lock_irq(&q->lock);
+	q->dead = true;
+	spin_unlock_irq(&q->lock);
+	wake_up_all(&q->idle);
+
+	cancel_work_sync(&q->work);
+	debugfs_remove_recursive(q->debugfs);
+
+	list_for_each_entry_safe(cmd, tmp, &q->pending, node)
+		kfree(cmd);
+	kfree(q->buf);
+	kfree(q);
+}
+EXPORT_SYMBOL_GPL(gigabyte_core_queue_destroy);
+
+static int __init gigabyte_core_init(void)
+{
+	int ret;
+
+	/* Devices run in parallel, each device's work item one at a time */
+	gigabyte_core_wq = alloc_workqueue("gigabytecore", WQ_UNBOUND, 0);
+	if (!gigabyte_core_wq)
+		return -ENOMEM;
+
+	ret = gigabyte_core_power_init();
+	if (ret) {
+		destroy_workqueue(gigabyte_core_wq);
+		return ret;
+	}
+
+	gigabyte_core_debugfs = debugfs_create_dir("gigabytecore", NULL);
+	return 0;
+}
+
+static void __exit gigabyte_core_exit(void)
+{
+	gigabyte_core_power_exit();
+	debugfs_remove_recursive(gigabyte_core_debugfs);
+	destroy_workqueue(gigabyte_core_wq);
+}
+
+module_init(gigabyte_core_init);
+module_exit(gigabyte_core_exit);
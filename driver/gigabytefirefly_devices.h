@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Generated from config/devices.json by tools/gen-devices.py, do not edit. */
+#ifndef __HID_GIGABYTE_FIREFLY_DEVICES_H
+#define __HID_GIGABYTE_FIREFLY_DEVICES_H
+
+/* Gigabyte mouse pad USB VID/PID pairs */
+/*
+ * Mouse pads handled by gigabytefirefly, as X(vendor, product, name,
+ * RGB zones, most frames per second the pad keeps up with).
+ */
+#define GIGABYTE_FIREFLY_MODELS(X)
+
+#endif /* __HID_GIGABYTE_FIREFLY_DEVICES_H */
@@ -0,0 +1,515 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * HID driver for Gigabyte Aorus RGB mouse pads
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Experimental: the color report has not been captured from a real pad,
+ * so no pad is listed and it is not built by default.
+ *
+ * Each lighting zone is a multicolor LED, so LED triggers can drive the pad
+ * without a process in userspace. Effects that set every zone at once
+ * write whole frames to the frame attribute instead.
+ *
+ * Both end up in the next frame. It is sent at most max_frame_rate times a
+ * second, only the zones that changed since the last one, packed into as
+ * few color reports as the gigabytecore queue can fit them in. Frames
+ * written faster than that replace each other.
+ */
+
+#include <linux/bitmap.h>
+#include <linux/hid.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/led-class-multicolor.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+#include "gigabytecore.h"
+#include "gigabytefirefly_driver.h"
+
+MODULE_AUTHOR("Hemanth Bollamreddi <blmhemu@gmail.com>");
+MODULE_DESCRIPTION("HID driver for Gigabyte RGB mouse pads.");
+MODULE_LICENSE("GPL v2");
+
+static unsigned int ac_max_fps;
+module_param(ac_max_fps, uint, 0644);
+MODULE_PARM_DESC(ac_max_fps, "Frame rate cap on AC, 0 for the pad's own limit (default: 0)");
+
+static unsigned int battery_max_fps;
+module_param(battery_max_fps, uint, 0644);
+MODULE_PARM_DESC(battery_max_fps, "Frame rate cap on battery, 0 for the pad's own limit (default: 0)");
+
+/* Lighting of a mouse pad model */
+struct gigabyte_firefly_model {
+	const char *name;
+	unsigned int zones;		/* At most GIGABYTE_FIREFLY_MAX_ZONES */
+	unsigned int max_fps;		/* Frames per second the pad keeps up with */
+};
+
+/* Pads bound through new_id, which have no table entry */
+static const struct gigabyte_firefly_model gigabyte_firefly_generic = {
+	.name = "generic",
+	.zones = 1,
+	.max_fps = 30,
+};
+
+/* Known models, see config/devices.json */
+#define GIGABYTE_FIREFLY_MODEL(vendor, product, _name, _zones, _max_fps)	\
+	static const struct gigabyte_firefly_model gigabyte_firefly_##product = {	\
+		.name = _name,							\
+		.zones = _zones,						\
+		.max_fps = _max_fps,						\
+	};
+
+GIGABYTE_FIREFLY_MODELS(GIGABYTE_FIREFLY_MODEL)
+
+struct gigabyte_firefly_data;
+
+struct gigabyte_firefly_led {
+	struct led_classdev_mc mc;
+	struct mc_subled subleds[3];
+	struct gigabyte_firefly_data *priv;
+	unsigned int zone;
+};
+
+/* Driver private data */
+struct gigabyte_firefly_data {
+	struct hid_device *hdev;
+	const struct gigabyte_firefly_model *model;
+	struct gigabyte_core_queue *queue;
+	bool has_leds;
+
+	struct mutex lock;		/* Protects the frames below */
+	u8 next[GIGABYTE_FIREFLY_MAX_ZONES][3];		/* Latest colors, RGB */
+	u8 shown[GIGABYTE_FIREFLY_MAX_ZONES][3];	/* As last queued */
+	DECLARE_BITMAP(known, GIGABYTE_FIREFLY_MAX_ZONES);	/* shown is valid */
+	bool frame_pending;
+	bool removing;			/* No more frames get scheduled */
+	unsigned int resends;		/* Frames in a row sent for lost colors */
+	bool stalled;			/* Gave up resending, until a write lands */
+	ktime_t last_frame;
+	struct delayed_work frame_work;
+
+	unsigned int num_leds;		/* Registered */
+	struct gigabyte_firefly_led leds[GIGABYTE_FIREFLY_MAX_ZONES];
+};
+
+static void gigabyte_firefly_schedule(struct gigabyte_firefly_data *priv);
+static void gigabyte_firefly_resend(struct gigabyte_firefly_data *priv, int err);
+
+/* Queue the zones that changed since the last frame */
+static void gigabyte_firefly_frame_work(struct work_struct *work)
+{
+	struct gigabyte_firefly_data *priv =
+		container_of(to_delayed_work(work), struct gigabyte_firefly_data, frame_work);
+	struct gigabyte_firefly_color_report rep = {
+		.report_id = GIGABYTE_FIREFLY_COLOR_REPORT_ID,
+		.count = 1,
+	};
+	unsigned int zone;
+	int ret;
+
+	mutex_lock(&priv->lock);
+	priv->frame_pending = false;
+	priv->last_frame = ktime_get();
+
+	for (zone = 0; zone < priv->model->zones; zone++) {
+		if (test_bit(zone, priv->known) && !memcmp(priv->shown[zone], priv->next[zone], 3))
+			continue;
+
+		rep.zones[0].zone = zone;
+		rep.zones[0].red = priv->next[zone][0];
+		rep.zones[0].green = priv->next[zone][1];
+		rep.zones[0].blue = priv->next[zone][2];
+
+		/* One key per zone: a zone's color still waiting is replaced */
+		ret = gigabyte_core_set_report(priv->queue, zone + 1, (u8 *)&rep,
+					       GIGABYTE_FIREFLY_COLOR_SIZE);
+		if (ret) {
+			/* The rest goes out with the next frame, if there is one */
+			hid_dbg(priv->hdev, "Failed to queue zone %u color: %d\n", zone, ret);
+			gigabyte_firefly_resend(priv, ret);
+			break;
+		}
+		memcpy(priv->shown[zone], priv->next[zone], 3);
+		set_bit(zone, priv->known);
+	}
+	mutex_unlock(&priv->lock);
+}
+
+/* The model's limit, lowered by the cap for the current power source */
+static unsigned int gigabyte_firefly_max_fps(struct gigabyte_firefly_data *priv)
+{
+	unsigned int cap = gigabyte_core_power_source() == GIGABYTE_CORE_POWER_BATTERY ?
+			   battery_max_fps : ac_max_fps;
+
+	return cap ? min(cap, priv->model->max_fps) : priv->model->max_fps;
+}
+
+/* Called with priv->lock held; sends the next frame once the rate allows */
+static void gigabyte_firefly_schedule(struct gigabyte_firefly_data *priv)
+{
+	ktime_t now = ktime_get();
+	ktime_t due = ktime_add_ns(priv->last_frame, NSEC_PER_SEC / gigabyte_firefly_max_fps(priv));
+	unsigned long delay = 0;
+
+	if (priv->frame_pending || priv->removing)
+		return;
+
+	priv->frame_pending = true;
+	if (ktime_after(due, now))
+		delay = usecs_to_jiffies(ktime_us_delta(due, now));
+	schedule_delayed_work(&priv->frame_work, delay);
+}
+
+/* Frames in a row sent only to resend lost colors before giving up */
+#define GIGABYTE_FIREFLY_MAX_RESENDS	3
+
+/*
+ * Called with priv->lock held. A pad that timed out or was busy gets the
+ * lost colors again with the next frame, a few times in a row at most;
+ * after that, or on any other error, they wait for the next change.
+ */
+static void gigabyte_firefly_resend(struct gigabyte_firefly_data *priv, int err)
+{
+	if (priv->frame_pending)
+		return;
+
+	if ((err != -ETIMEDOUT && err != -EAGAIN) ||
+	    priv->resends >= GIGABYTE_FIREFLY_MAX_RESENDS) {
+		if (!priv->stalled)
+			hid_warn(priv->hdev, "Pad not taking colors (%d), resending on the next change\n",
+				 err);
+		priv->stalled = true;
+		return;
+	}
+
+	priv->resends++;
+	gigabyte_firefly_schedule(priv);
+}
+
+/*
+ * Called from the queue worker. A lost color is marked unknown, so it is
+ * sent again with the next frame rather than kept stale until the next
+ * change to that zone.
+ */
+static void gigabyte_firefly_write_done(void *ctx, u32 key, int err)
+{
+	struct gigabyte_firefly_data *priv = ctx;
+
+	mutex_lock(&priv->lock);
+	if (err) {
+		clear_bit(key - 1, priv->known);
+		gigabyte_firefly_resend(priv, err);
+	} else {
+		priv->resends = 0;
+		priv->stalled = false;
+	}
+	mutex_unlock(&priv->lock);
+}
+
+/* Pack consecutive color reports into one, as long as the entries fit */
+static bool gigabyte_firefly_merge(void *ctx, u8 *buf, size_t *len, size_t size,
+				   const u8 *cmd, size_t cmd_len)
+{
+	struct gigabyte_firefly_color_report *batch = (void *)buf;
+	const struct gigabyte_firefly_color_report *next = (const void *)cmd;
+
+	if (cmd_len != GIGABYTE_FIREFLY_COLOR_SIZE ||
+	    next->report_id != GIGABYTE_FIREFLY_COLOR_REPORT_ID ||
+	    batch->report_id != GIGABYTE_FIREFLY_COLOR_REPORT_ID ||
+	    batch->count + next->count > GIGABYTE_FIREFLY_MAX_ZONES)
+		return false;
+
+	memcpy(&batch->zones[batch->count], next->zones, next->count * sizeof(next->zones[0]));
+	batch->count += next->count;
+	return true;
+}
+
+static const struct gigabyte_core_ops gigabyte_firefly_core_ops = {
+	.merge = gigabyte_firefly_merge,
+	.done = gigabyte_firefly_write_done,
+};
+
+static int gigabyte_firefly_led_set(struct led_classdev *cdev, enum led_brightness brightness)
+{
+	struct led_classdev_mc *mc = lcdev_to_mccdev(cdev);
+	struct gigabyte_firefly_led *led = container_of(mc, struct gigabyte_firefly_led, mc);
+	struct gigabyte_firefly_data *priv = led->priv;
+	unsigned int i;
+
+	led_mc_calc_color_components(mc, brightness);
+
+	mutex_lock(&priv->lock);
+	for (i = 0; i < ARRAY_SIZE(led->subleds); i++)
+		priv->next[led->zone][i] = mc->subled_info[i].brightness;
+	gigabyte_firefly_schedule(priv);
+	mutex_unlock(&priv->lock);
+
+	return 0;
+}
+
+static int gigabyte_firefly_register_leds(struct gigabyte_firefly_data *priv)
+{
+	static const int colors[] = { LED_COLOR_ID_RED, LED_COLOR_ID_GREEN, LED_COLOR_ID_BLUE };
+	struct hid_device *hdev = priv->hdev;
+	struct gigabyte_firefly_led *led;
+	unsigned int i;
+	int ret;
+
+	for (priv->num_leds = 0; priv->num_leds < priv->model->zones; priv->num_leds++) {
+		led = &priv->leds[priv->num_leds];
+		led->priv = priv;
+		led->zone = priv->num_leds;
+
+		for (i = 0; i < ARRAY_SIZE(led->subleds); i++) {
+			led->subleds[i].color_index = colors[i];
+			led->subleds[i].intensity = LED_FULL;
+		}
+		led->mc.subled_info = led->subleds;
+		led->mc.num_colors = ARRAY_SIZE(led->subleds);
+
+		/* LED names can't have the colons of the HID device name */
+		led->mc.led_cdev.name = devm_kasprintf(&hdev->dev, GFP_KERNEL,
+						       "gigabyte_firefly%u:rgb:zone-%u",
+						       hdev->id, led->zone);
+		if (!led->mc.led_cdev.name)
+			return -ENOMEM;
+		led->mc.led_cdev.max_brightness = LED_FULL;
+		led->mc.led_cdev.brightness_set_blocking = gigabyte_firefly_led_set;
+		/* Unbinding leaves the pad lit as it was */
+		led->mc.led_cdev.flags = LED_RETAIN_AT_SHUTDOWN;
+
+		ret = led_classdev_multicolor_register(&hdev->dev, &led->mc);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static void gigabyte_firefly_unregister_leds(struct gigabyte_firefly_data *priv)
+{
+	while (priv->num_leds)
+		led_classdev_multicolor_unregister(&priv->leds[--priv->num_leds].mc);
+}
+
+static ssize_t frame_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct gigabyte_firefly_data *priv = dev_get_drvdata(dev);
+	ssize_t len = 0;
+	unsigned int zone;
+
+	mutex_lock(&priv->lock);
+	for (zone = 0; zone < priv->model->zones; zone++)
+		len += sysfs_emit_at(buf, len, "%s%*phN", zone ? " " : "", 3, priv->next[zone]);
+	mutex_unlock(&priv->lock);
+
+	return len + sysfs_emit_at(buf, len, "\n");
+}
+
+/* One RRGGBB hex color per zone, space separated */
+static ssize_t frame_store(struct device *dev, struct device_attribute *attr,
+			   const char *buf, size_t count)
+{
+	struct gigabyte_firefly_data *priv = dev_get_drvdata(dev);
+	u8 frame[GIGABYTE_FIREFLY_MAX_ZONES][3];
+	unsigned int n = 0;
+	char *copy, *cur, *tok;
+	int ret = 0;
+
+	copy = kstrdup(buf, GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+
+	cur = strim(copy);
+	while ((tok = strsep(&cur, " ")) && !ret) {
+		if (!*tok)
+			continue;
+		if (n == priv->model->zones || strlen(tok) != 6 || hex2bin(frame[n], tok, 3))
+			ret = -EINVAL;
+		else
+			n++;
+	}
+	kfree(copy);
+	if (ret)
+		return ret;
+	if (n != priv->model->zones)
+		return -EINVAL;
+
+	mutex_lock(&priv->lock);
+	memcpy(priv->next, frame, n * sizeof(frame[0]));
+	gigabyte_firefly_schedule(priv);
+	mutex_unlock(&priv->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(frame);
+
+static ssize_t max_frame_rate_show(struct device *dev, struct device_attribute *attr,
+				   char *buf)
+{
+	struct gigabyte_firefly_data *priv = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", gigabyte_firefly_max_fps(priv));
+}
+static DEVICE_ATTR_RO(max_frame_rate);
+
+static struct attribute *gigabyte_firefly_attrs[] = {
+	&dev_attr_frame.attr,
+	&dev_attr_max_frame_rate.attr,
+	NULL
+};
+
+/* Only the interface that has the color report gets the attributes */
+static umode_t gigabyte_firefly_attr_visible(struct kobject *kobj, struct attribute *attr,
+					     int n)
+{
+	struct gigabyte_firefly_data *priv = dev_get_drvdata(kobj_to_dev(kobj));
+
+	return priv && priv->has_leds ? attr->mode : 0;
+}
+
+static const struct attribute_group gigabyte_firefly_group = {
+	.attrs = gigabyte_firefly_attrs,
+	.is_visible = gigabyte_firefly_attr_visible,
+};
+__ATTRIBUTE_GROUPS(gigabyte_firefly);
+
+static int gigabyte_firefly_probe(struct hid_device *hdev,
+				  const struct hid_device_id *id)
+{
+	struct gigabyte_firefly_data *priv;
+	struct hid_report *report;
+	int ret;
+
+	priv = devm_kzalloc(&hdev->dev, sizeof(*priv), GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+
+	priv->hdev = hdev;
+	priv->model = id->driver_data ? (const void *)id->driver_data : &gigabyte_firefly_generic;
+	mutex_init(&priv->lock);
+	INIT_DELAYED_WORK(&priv->frame_work, gigabyte_firefly_frame_work);
+	hid_set_drvdata(hdev, priv);
+
+	ret = hid_parse(hdev);
+	if (ret)
+		return ret;
+
+	ret = hid_hw_start(hdev, HID_CONNECT_DEFAULT);
+	if (ret)
+		return ret;
+
+	report = hdev->report_enum[HID_FEATURE_REPORT].report_id_hash[GIGABYTE_FIREFLY_COLOR_REPORT_ID];
+	if (!report || hid_report_len(report) < GIGABYTE_FIREFLY_COLOR_SIZE)
+		return 0;
+
+	priv->queue = gigabyte_core_queue_create(hdev, &gigabyte_firefly_core_ops, priv,
+						 GIGABYTE_FIREFLY_COLOR_SIZE);
+	if (!priv->queue) {
+		ret = -ENOMEM;
+		goto err_stop;
+	}
+
+	ret = gigabyte_firefly_register_leds(priv);
+	if (ret) {
+		hid_err(hdev, "Failed to register zone LEDs: %d\n", ret);
+		goto err_leds;
+	}
+
+	priv->has_leds = true;
+	hid_info(hdev, "%s mouse pad, %u zones, up to %u frames/s\n", priv->model->name,
+		 priv->model->zones, priv->model->max_fps);
+	return 0;
+
+err_leds:
+	gigabyte_firefly_unregister_leds(priv);
+	cancel_delayed_work_sync(&priv->frame_work);
+	gigabyte_core_queue_destroy(priv->queue);
+err_stop:
+	hid_hw_stop(hdev);
+	return ret;
+}
+
+static void gigabyte_firefly_remove(struct hid_device *hdev)
+{
+	struct gigabyte_firefly_data *priv = hid_get_drvdata(hdev);
+
+	/*
+	 * Once the LEDs and attributes are gone only a failed write can
+	 * schedule a frame, and not after this.
+	 */
+	gigabyte_firefly_unregister_leds(priv);
+	mutex_lock(&priv->lock);
+	priv->removing = true;
+	mutex_unlock(&priv->lock);
+	cancel_delayed_work_sync(&priv->frame_work);
+	gigabyte_core_queue_destroy(priv->queue);
+	hid_hw_stop(hdev);
+}
+
+#define GIGABYTE_FIREFLY_HID_DEVICE(vendor, product, ...)			\
+	{ HID_USB_DEVICE(vendor, product),					\
+	  .driver_data = (kernel_ulong_t)&gigabyte_firefly_##product },
+
+static const struct hid_device_id gigabyte_firefly_devices[] = {
+	GIGABYTE_FIREFLY_MODELS(GIGABYTE_FIREFLY_HID_DEVICE)
+	{ }
+};
+MODULE_DEVICE_TABLE(hid, gigabyte_firefly_devices);
+
+static struct hid_driver gigabyte_firefly_driver = {
+	.name = "gigabytefirefly",
+	.id_table = gigabyte_firefly_devices,
+	.probe = gigabyte_firefly_probe,
+	.remove = gigabyte_firefly_remove,
+	.driver = {
+		.dev_groups = gigabyte_firefly_groups,
+	},
+};
+
+static int gigabyte_firefly_notify_dev(struct device *dev, void *data)
+{
+	sysfs_notify(&dev->kobj, NULL, "max_frame_rate");
+	return 0;
+}
+
+/* The cap is read per frame; only pollers of max_frame_rate need telling */
+static int gigabyte_firefly_power_notify(struct notifier_block *nb,
+					 unsigned long source, void *data)
+{
+	if (ac_max_fps != battery_max_fps)
+		driver_for_each_device(&gigabyte_firefly_driver.driver, NULL, NULL,
+				       gigabyte_firefly_notify_dev);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block gigabyte_firefly_power_nb = {
+	.notifier_call = gigabyte_firefly_power_notify,
+};
+
+static int __init gigabyte_firefly_init(void)
+{
+	int ret;
+
+	ret = hid_register_driver(&gigabyte_firefly_driver);
+	if (ret)
+		return ret;
+
+	ret = gigabyte_core_power_register(&gigabyte_firefly_power_nb);
+	if (ret)
+		hid_unregister_driver(&gigabyte_firefly_driver);
+	return ret;
+}
+
+static void __exit gigabyte_firefly_exit(void)
+{
+	gigabyte_core_power_unregister(&gigabyte_firefly_power_nb);
+	hid_unregister_driver(&gigabyte_firefly_driver);
+}
+
+module_init(gigabyte_firefly_init);
+module_exit(gigabyte_firefly_exit);
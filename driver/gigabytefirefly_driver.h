@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __HID_GIGABYTE_FIREFLY_H
+#define __HID_GIGABYTE_FIREFLY_H
+
+#include <linux/types.h>
+
+/* Device tables, generated from config/devices.json */
+#include "gigabytefirefly_devices.h"
+
+/*
+ * Zone colors are set with one vendor feature report carrying a list of
+ * (zone, color) entries; zones not listed keep their color. Pads without
+ * this report in their descriptor get no LEDs.
+ */
+#define GIGABYTE_FIREFLY_COLOR_REPORT_ID	0x0c
+#define GIGABYTE_FIREFLY_MAX_ZONES		15
+
+struct gigabyte_firefly_zone_color {
+	__u8 zone;
+	__u8 red;
+	__u8 green;
+	__u8 blue;
+};
+
+struct gigabyte_firefly_color_report {
+	__u8 report_id;		/* GIGABYTE_FIREFLY_COLOR_REPORT_ID */
+	__u8 count;		/* Entries used in zones[] */
+	struct gigabyte_firefly_zone_color zones[GIGABYTE_FIREFLY_MAX_ZONES];
+	__u8 reserved[2];
+};
+
+#define GIGABYTE_FIREFLY_COLOR_SIZE	sizeof(struct gigabyte_firefly_color_report)
+
+#endif /* __HID_GIGABYTE_FIREFLY_H */
@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __HID_GIGABYTE_KBD_CAPTURE_H
+#define __HID_GIGABYTE_KBD_CAPTURE_H
+
+#include <linux/types.h>
+
+/*
+ * Raw report capture, for reproducing Fn key bug reports offline.
+ *
+ *   echo 1 > /sys/kernel/debug/gigabytekbd/capture
+ *   cat /sys/kernel/debug/gigabytekbd/trace > reports.bin
+ *
+ * The trace file is a stream of fixed-size, little-endian records in
+ * timestamp order. Reading drains the records it returns; a read that
+ * finds nothing returns 0. Every report passed to raw_event is captured,
+ * before the driver acts on it. Reports longer than the payload are
+ * truncated and size keeps the original length. Records that don't fit
+ * the per-CPU buffers are counted in /sys/kernel/debug/gigabytekbd/dropped.
+ */
+#define GIGABYTE_KBD_CAPTURE_PAYLOAD	16
+
+/* What the driver did with the report */
+enum gigabyte_kbd_capture_action {
+	GIGABYTE_KBD_ACTION_PASS	= 0,	/* Left to the HID core */
+	GIGABYTE_KBD_ACTION_KEY		= 1,	/* Fn Keys press and release */
+	GIGABYTE_KBD_ACTION_VOLUME	= 2,	/* Volume press or release */
+	GIGABYTE_KBD_ACTION_BRIGHTNESS	= 3,	/* Re-injected as consumer report */
+	GIGABYTE_KBD_ACTION_BACKLIGHT	= 4,	/* Backlight toggle scheduled */
+	GIGABYTE_KBD_ACTION_TOUCHPAD	= 5,	/* Touchpad toggle scheduled */
+};
+
+struct gigabyte_kbd_capture_record {
+	__le64 timestamp;	/* CLOCK_MONOTONIC, in ns */
+	__le16 vendor;		/* HID device that sent the report */
+	__le16 product;
+	__u8 report_id;
+	__u8 action;		/* enum gigabyte_kbd_capture_action */
+	__le16 size;		/* Report size, including the report ID byte */
+	__u8 data[GIGABYTE_KBD_CAPTURE_PAYLOAD];	/* Report as seen by raw_event */
+};
+
+#endif /* __HID_GIGABYTE_KBD_CAPTURE_H */
@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __HID_GIGABYTE_KBD_CONFIG_H
+#define __HID_GIGABYTE_KBD_CONFIG_H
+
+#include <linux/types.h>
+
+/*
+ * Binary keymap and model configuration, loaded as firmware.
+ *
+ * The blob is compiled from config/gigabytekbd.conf by
+ * tools/gigabytekbd-config.py and installed as
+ * /lib/firmware/opengigabyte/gigabytekbd.bin. It is requested without
+ * blocking probe; until it arrives, or if it is missing or invalid, the
+ * built-in tables are used.
+ *
+ * Layout, all little-endian and without padding:
+ *
+ *   struct gigabyte_kbd_config_header
+ *   struct gigabyte_kbd_config_key       keys[num_keys]
+ *   struct gigabyte_kbd_config_touchpad  touchpads[num_touchpads]
+ *   struct gigabyte_kbd_config_model     models[num_models]
+ *
+ * Strings are NUL-terminated within their field. The first model whose
+ * vendor and product are substrings of the DMI system vendor and product
+ * name is used; an empty string matches anything.
+ */
+#define GIGABYTE_KBD_CONFIG_FIRMWARE	"opengigabyte/gigabytekbd.bin"
+#define GIGABYTE_KBD_CONFIG_MAGIC	0x434b474f	/* "OGKC" */
+#define GIGABYTE_KBD_CONFIG_VERSION	2
+
+#define GIGABYTE_KBD_CONFIG_MAX_KEYS	256
+#define GIGABYTE_KBD_CONFIG_MAX_ENTRIES	64	/* Touchpads and models */
+
+struct gigabyte_kbd_config_header {
+	__le32 magic;
+	__le16 version;		/* Bumped on incompatible changes */
+	__le16 header_size;	/* May grow; entries start after it */
+	__le32 size;		/* Whole blob, header included */
+	__le32 crc32;		/* zlib CRC-32 of everything after the header */
+	__le16 num_keys;
+	__le16 num_touchpads;
+	__le16 num_models;
+	__le16 reserved;
+};
+
+/* Fn key: raw report 4 code to keycode */
+struct gigabyte_kbd_config_key {
+	__le32 code;
+	__le16 keycode;
+	__le16 reserved;
+};
+
+/* ACPI touchpad candidate, see gigabyte_kbd_touchpad_device_identifiers */
+struct gigabyte_kbd_config_touchpad {
+	char hid[16];
+	char bid[8];
+	__le32 instance_no;
+};
+
+/* Model quirks, see struct gigabyte_kbd_profile */
+struct gigabyte_kbd_config_model {
+	char vendor[32];	/* DMI_SYS_VENDOR substring */
+	char product[32];	/* DMI_PRODUCT_NAME substring */
+	char name[32];
+	char touchpad_hid[16];	/* Empty tries every touchpad */
+	char backlight[32];
+	__le32 caps;		/* GIGABYTE_KBD_CAP_* */
+};
+
+#endif /* __HID_GIGABYTE_KBD_CONFIG_H */
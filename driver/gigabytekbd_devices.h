@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Generated from config/devices.json by tools/gen-devices.py, do not edit. */
+#ifndef __HID_GIGABYTE_KBD_DEVICES_H
+#define __HID_GIGABYTE_KBD_DEVICES_H
+
+/* Gigabyte laptop USB VID/PID pairs */
+#define USB_VENDOR_ID_GIGABYTE_AERO15XV8	0x1044
+#define USB_DEVICE_ID_GIGABYTE_AERO15XV8	0x7A39
+
+#define USB_VENDOR_ID_GIGABYTE_AERO15SA		0x1044
+#define USB_DEVICE_ID_GIGABYTE_AERO15SA		0x7A3F
+
+#define USB_VENDOR_ID_GIGABYTE_AORUS15P		0x1044
+#define USB_DEVICE_ID_GIGABYTE_AORUS15P		0x7A3B
+
+#define USB_VENDOR_ID_GIGABYTE_AORUS15G		0x1044
+#define USB_DEVICE_ID_GIGABYTE_AORUS15G		0x7A3C
+
+#define USB_VENDOR_ID_GIGABYTE_AORUS15_9KF_1	0x0414
+#define USB_DEVICE_ID_GIGABYTE_AORUS15_9KF_1	0x7A43
+
+#define USB_VENDOR_ID_GIGABYTE_AORUS15_9KF_2	0x0414
+#define USB_DEVICE_ID_GIGABYTE_AORUS15_9KF_2	0x7A44
+
+#define USB_VENDOR_ID_GIGABYTE_AORUS16X		0x0414
+#define USB_DEVICE_ID_GIGABYTE_AORUS16X		0x8005
+
+/*
+ * All keyboards handled by gigabytekbd, as X(vendor, product). Shared with
+ * the userspace driver so both bind to the same devices.
+ */
+#define GIGABYTE_KBD_USB_DEVICES(X)							\
+	X(USB_VENDOR_ID_GIGABYTE_AERO15XV8, USB_DEVICE_ID_GIGABYTE_AERO15XV8)		\
+	X(USB_VENDOR_ID_GIGABYTE_AERO15SA, USB_DEVICE_ID_GIGABYTE_AERO15SA)		\
+	X(USB_VENDOR_ID_GIGABYTE_AORUS15P, USB_DEVICE_ID_GIGABYTE_AORUS15P)		\
+	X(USB_VENDOR_ID_GIGABYTE_AORUS15G, USB_DEVICE_ID_GIGABYTE_AORUS15G)		\
+	X(USB_VENDOR_ID_GIGABYTE_AORUS15_9KF_1, USB_DEVICE_ID_GIGABYTE_AORUS15_9KF_1)	\
+	X(USB_VENDOR_ID_GIGABYTE_AORUS15_9KF_2, USB_DEVICE_ID_GIGABYTE_AORUS15_9KF_2)	\
+	X(USB_VENDOR_ID_GIGABYTE_AORUS16X, USB_DEVICE_ID_GIGABYTE_AORUS16X)
+
+/* Fn key HID raw event codes (report 4, big endian including the report ID) */
+#define HIDRAW_FN_ESC				0x04000084
+#define HIDRAW_FN_F2				0x0400007C
+#define HIDRAW_FN_F3				0x0400007D
+#define HIDRAW_FN_F4				0x0400007E
+#define HIDRAW_FN_F5				0x0400007F
+#define HIDRAW_FN_F6				0x04000080
+#define HIDRAW_FN_F8_PRESS			0x04000186
+#define HIDRAW_FN_F8_RELEASE			0x04000086
+#define HIDRAW_FN_F9_PRESS			0x04000187
+#define HIDRAW_FN_F9_RELEASE			0x04000087
+#define HIDRAW_FN_F10				0x04000081
+#define HIDRAW_FN_F11				0x04000082
+#define HIDRAW_FN_F12				0x04000083
+#define HIDRAW_FN_F12_ALT			0x04000088	/* Aorus 16X */
+
+/*
+ * Fn keys that map straight to a keycode, as X(scancode, keycode).
+ * The other codes are handled by the driver itself.
+ */
+#define GIGABYTE_KBD_FN_KEYMAP(X)		\
+	X(HIDRAW_FN_ESC, KEY_PROG2)		\
+	X(HIDRAW_FN_F2, KEY_WLAN)		\
+	X(HIDRAW_FN_F5, KEY_SWITCHVIDEOMODE)	\
+	X(HIDRAW_FN_F8_PRESS, KEY_VOLUMEDOWN)	\
+	X(HIDRAW_FN_F9_PRESS, KEY_VOLUMEUP)	\
+	X(HIDRAW_FN_F11, KEY_RFKILL)		\
+	X(HIDRAW_FN_F12, KEY_PROG1)		\
+	X(HIDRAW_FN_F12_ALT, KEY_PROG1)
+
+/* Touchpads toggled by Fn+F10, as X(ACPI HID, bus id, instance) */
+#define GIGABYTE_KBD_TOUCHPADS(X)	\
+	X("PNP0C50", "TPD0", 1)		\
+	X("ELAN0A02", "TPD0", 0)	\
+	X("ELAN0A03", "TPD0", 1)	\
+	X("ELAN0A04", "TPD0", 0)
+
+/*
+ * Model profiles, as X(id, name, touchpad HID or NULL, backlight, caps,
+ * connect, vendor_connect, ignore_apps). caps is a mask of GIGABYTE_KBD_CAP_*
+ * bits, the connects are HID_CONNECT_* masks for interfaces with standard
+ * application collections and for those with only the vendor Fn report,
+ * and ignore_apps is a mask of GIGABYTE_KBD_APP_* collections that get no
+ * input device.
+ */
+#define GIGABYTE_KBD_PROFILES(X)					\
+	X(aero15x, "Aero 15X", NULL, "intel_backlight",			\
+	  GIGABYTE_KBD_CAP_BACKLIGHT | GIGABYTE_KBD_CAP_TOUCHPAD,	\
+	  HID_CONNECT_HIDINPUT | HID_CONNECT_HIDRAW,			\
+	  HID_CONNECT_HIDRAW,						\
+	  0)								\
+	X(aero, "Aero", NULL, "intel_backlight",			\
+	  GIGABYTE_KBD_CAP_BACKLIGHT | GIGABYTE_KBD_CAP_TOUCHPAD,	\
+	  HID_CONNECT_HIDINPUT | HID_CONNECT_HIDRAW,			\
+	  HID_CONNECT_HIDRAW,						\
+	  0)								\
+	X(aorus15p, "Aorus 15P", "PNP0C50", "intel_backlight",		\
+	  GIGABYTE_KBD_CAP_BACKLIGHT | GIGABYTE_KBD_CAP_TOUCHPAD,	\
+	  HID_CONNECT_HIDINPUT | HID_CONNECT_HIDRAW,			\
+	  HID_CONNECT_HIDRAW,						\
+	  0)								\
+	X(aorus17, "Aorus 17", "ELAN0A02", "intel_backlight",		\
+	  GIGABYTE_KBD_CAP_BACKLIGHT | GIGABYTE_KBD_CAP_TOUCHPAD,	\
+	  HID_CONNECT_HIDINPUT | HID_CONNECT_HIDRAW,			\
+	  HID_CONNECT_HIDRAW,						\
+	  0)								\
+	X(aorus15_9kf, "Aorus 15 9KF", "ELAN0A03", "intel_backlight",	\
+	  GIGABYTE_KBD_CAP_BACKLIGHT | GIGABYTE_KBD_CAP_TOUCHPAD,	\
+	  HID_CONNECT_HIDINPUT | HID_CONNECT_HIDRAW,			\
+	  HID_CONNECT_HIDRAW,						\
+	  0)								\
+	X(aorus16x, "Aorus 16X", "ELAN0A04", "intel_backlight",		\
+	  GIGABYTE_KBD_CAP_BACKLIGHT | GIGABYTE_KBD_CAP_TOUCHPAD,	\
+	  HID_CONNECT_HIDINPUT | HID_CONNECT_HIDRAW,			\
+	  HID_CONNECT_HIDRAW,						\
+	  0)
+
+/* DMI product name substrings, as X(product, profile id); first match wins */
+#define GIGABYTE_KBD_DMI_MODELS(X)	\
+	X("AERO 15X", aero15x)		\
+	X("AERO 15 SA", aero)		\
+	X("AERO 17 XD", aero)		\
+	X("AORUS 15P", aorus15p)	\
+	X("AORUS 15G", aorus15p)	\
+	X("AORUS 17G", aorus17)		\
+	X("AORUS 17X", aorus17)		\
+	X("AORUS 15 9KF", aorus15_9kf)	\
+	X("AORUS 16X", aorus16x)
+
+#endif /* __HID_GIGABYTE_KBD_DEVICES_H */
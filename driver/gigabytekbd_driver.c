@@ -22,51 +22,220 @@
 #include <linux/backlight.h>
 #include <linux/device.h>
 #include <linux/acpi.h>
+#include <linux/i2c.h>
 #include <linux/input.h>
+#include <linux/input/sparse-keymap.h>
+#include <linux/debugfs.h>
+#include <linux/jump_label.h>
+#include <linux/percpu.h>
+#include <linux/timekeeping.h>
+#include <linux/uaccess.h>
+#include <linux/pm.h>
+#include <linux/suspend.h>
+#include <linux/dmi.h>
+#include <linux/firmware.h>
+#include <linux/crc32.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+#include <linux/version.h>
+#include "gigabytecore.h"
 #include "gigabytekbd_driver.h"
+#include "gigabytekbd_capture.h"
+#include "gigabytekbd_config.h"
+
+#define CREATE_TRACE_POINTS
+#include "gigabytekbd_trace.h"
 
 MODULE_AUTHOR("Hemanth Bollamreddi <blmhemu@gmail.com>");
 MODULE_DESCRIPTION("HID Keyboard driver for Gigabyte Keyboards.");
 MODULE_LICENSE("GPL v2");
 
-/* Fn key HID raw event codes */
-#define HIDRAW_FN_ESC		0x04000084
-#define HIDRAW_FN_F2		0x0400007C
-#define HIDRAW_FN_F3		0x0400007D
-#define HIDRAW_FN_F4		0x0400007E
-#define HIDRAW_FN_F5		0x0400007F
-#define HIDRAW_FN_F6		0x04000080
-#define HIDRAW_FN_F8_PRESS	0x04000186
-#define HIDRAW_FN_F8_RELEASE	0x04000086
-#define HIDRAW_FN_F9_PRESS	0x04000187
-#define HIDRAW_FN_F9_RELEASE	0x04000087
-#define HIDRAW_FN_F10		0x04000081
-#define HIDRAW_FN_F11		0x04000082
-#define HIDRAW_FN_F12		0x04000083
-#define HIDRAW_FN_F12_ALT	0x04000088	/* Aorus 16X */
-
 #define make_u32(a, b, c, d) ((a) << 24 | (b) << 16 | (c) << 8 | (d))
 
+/*
+ * Default Fn key map. Scancodes are the raw report 4 codes and are sent
+ * as MSC_SCAN, so keys can be remapped with hwdb or EVIOCSKEYCODE.
+ */
+#define GIGABYTE_KBD_KEY_ENTRY(code, key)	{ KE_KEY, code, { key } },
+
+static const struct key_entry gigabyte_kbd_keymap[] = {
+	GIGABYTE_KBD_FN_KEYMAP(GIGABYTE_KBD_KEY_ENTRY)
+	{ KE_END, 0 }
+};
+
+/* Optional hardware a model has, see struct gigabyte_kbd_profile */
+#define GIGABYTE_KBD_CAP_BACKLIGHT	BIT(0)	/* Fn+F6 display backlight toggle */
+#define GIGABYTE_KBD_CAP_TOUCHPAD	BIT(1)	/* Fn+F10 touchpad toggle */
+#define GIGABYTE_KBD_CAP_ALL		GENMASK(1, 0)
+
+/* Application collections a profile can keep from getting an input device */
+#define GIGABYTE_KBD_APP_KEYBOARD	BIT(0)
+#define GIGABYTE_KBD_APP_MOUSE		BIT(1)
+#define GIGABYTE_KBD_APP_SYSTEM		BIT(2)
+#define GIGABYTE_KBD_APP_WIRELESS	BIT(3)
+#define GIGABYTE_KBD_APP_CONSUMER	BIT(4)
+
+static const unsigned int gigabyte_kbd_app_usages[] = {
+	HID_GD_KEYBOARD,		/* GIGABYTE_KBD_APP_KEYBOARD */
+	HID_GD_MOUSE,			/* GIGABYTE_KBD_APP_MOUSE */
+	HID_GD_SYSTEM_CONTROL,		/* GIGABYTE_KBD_APP_SYSTEM */
+	HID_GD_WIRELESS_RADIO_CTLS,	/* GIGABYTE_KBD_APP_WIRELESS */
+	HID_CP_CONSUMER_CONTROL,	/* GIGABYTE_KBD_APP_CONSUMER */
+};
+
+/*
+ * Per-model capabilities, picked by DMI at module load or taken from the
+ * loaded config. Only the hardware listed in caps is looked for at probe.
+ */
+struct gigabyte_kbd_profile {
+	const char *name;
+	const struct key_entry *keymap;
+	const char *touchpad_hid;	/* Tried before the others, or NULL */
+	const char *backlight;		/* Name in /sys/class/backlight/ */
+	unsigned long caps;
+	unsigned int connect;		/* HID_CONNECT_* for standard interfaces */
+	unsigned int vendor_connect;	/* ... and for ones with only the Fn report */
+	unsigned long ignore_apps;	/* GIGABYTE_KBD_APP_* without input devices */
+};
+
+/* Unknown models keep the historical behaviour */
+static const struct gigabyte_kbd_profile gigabyte_kbd_profile_generic = {
+	.name = "generic",
+	.keymap = gigabyte_kbd_keymap,
+	.backlight = GIGABYTE_KBD_BACKLIGHT_DEVICE_NAME,
+	.caps = GIGABYTE_KBD_CAP_BACKLIGHT | GIGABYTE_KBD_CAP_TOUCHPAD,
+	.connect = HID_CONNECT_DEFAULT,
+	.vendor_connect = HID_CONNECT_DEFAULT,
+};
+
+/* Known models, see config/devices.json */
+#define GIGABYTE_KBD_PROFILE(id, _name, _touchpad_hid, _backlight, _caps,	\
+			     _connect, _vendor_connect, _ignore_apps)		\
+	static const struct gigabyte_kbd_profile gigabyte_kbd_profile_##id = {	\
+		.name = _name,							\
+		.keymap = gigabyte_kbd_keymap,					\
+		.touchpad_hid = _touchpad_hid,					\
+		.backlight = _backlight,					\
+		.caps = _caps,							\
+		.connect = _connect,						\
+		.vendor_connect = _vendor_connect,				\
+		.ignore_apps = _ignore_apps,					\
+	};
+
+GIGABYTE_KBD_PROFILES(GIGABYTE_KBD_PROFILE)
+
+#define GIGABYTE_KBD_DMI(product, profile)				\
+	{								\
+		.matches = {						\
+			DMI_MATCH(DMI_SYS_VENDOR, "GIGABYTE"),		\
+			DMI_MATCH(DMI_PRODUCT_NAME, product),		\
+		},							\
+		.driver_data = (void *)&gigabyte_kbd_profile_##profile,	\
+	},
+
+/* More specific product names come before their prefixes */
+static const struct dmi_system_id gigabyte_kbd_dmi_table[] = {
+	GIGABYTE_KBD_DMI_MODELS(GIGABYTE_KBD_DMI)
+	{ }
+};
+
+/*
+ * Tables in use: the built-in ones, or a config loaded as firmware (see
+ * gigabytekbd_config.h). The config is replaced as a whole under
+ * gigabyte_kbd_config_lock, which also serializes creating and replacing
+ * the Fn Keys input device. The report path never looks at the config.
+ */
+struct gigabyte_kbd_config {
+	struct gigabyte_kbd_profile profile;
+	const struct gigabyte_kbd_touchpad_device_identifier *touchpads;
+	unsigned int num_touchpads;
+	void *blob;		/* Firmware copy the strings point into */
+};
+
+static struct gigabyte_kbd_config gigabyte_kbd_builtin_config = {
+	.touchpads = gigabyte_kbd_touchpad_device_identifiers,
+	.num_touchpads = ARRAY_SIZE(gigabyte_kbd_touchpad_device_identifiers),
+};
+
+static DEFINE_MUTEX(gigabyte_kbd_config_lock);
+static struct gigabyte_kbd_config *gigabyte_kbd_config = &gigabyte_kbd_builtin_config;
+static bool gigabyte_kbd_config_requested;
+
+static char *config = GIGABYTE_KBD_CONFIG_FIRMWARE;
+module_param(config, charp, 0444);
+MODULE_PARM_DESC(config, "Keymap and model config firmware file, empty for the built-in tables");
+MODULE_FIRMWARE(GIGABYTE_KBD_CONFIG_FIRMWARE);
+
+static bool minimal_nodes = true;
+module_param(minimal_nodes, bool, 0644);
+MODULE_PARM_DESC(minimal_nodes, "Only create the hidraw, hiddev and input nodes the model profile asks for (default: Y)");
+
 /* Driver private data */
 struct gigabyte_kbd_data {
 	struct backlight_device *backlight;
-	struct device_driver *touchpad_driver;
-	struct device *touchpad_device;
+	struct device_link *backlight_link;	/* Resume after the backlight */
+	unsigned long ignore_apps;	/* Copied from the profile at probe */
+	bool opened;			/* hid_hw_open() done for raw_event */
+
+	/* State saved at suspend, restored on resume without re-discovery */
+	bool pm_saved;
+	int backlight_power;		/* FB_BLANK_* */
 };
 
+/* What resume had to put back, reported by the gigabytekbd_resume tracepoint */
+#define GIGABYTE_KBD_RESTORED_BACKLIGHT	BIT(0)
+
 /* Global state shared across HID interfaces */
 static struct gigabyte_kbd_data *gigabyte_kbd_priv;
-static struct input_dev *gigabyte_kbd_input_dev;
-static struct input_dev *gigabyte_kbd_consumer_dev;
+static struct input_dev __rcu *gigabyte_kbd_input_dev;	/* Replaced if a config adds keys */
+static struct input_dev __rcu *gigabyte_kbd_consumer_dev;	/* Lives as long as the above */
 static int gigabyte_kbd_refcount;
 
 static struct backlight_device *gigabyte_kbd_backlight_device;
+
+/*
+ * Touchpad lookup cache and Fn+F10 state, protected by
+ * gigabyte_kbd_touchpad_lock. The ACPI node is looked up once; the I2C
+ * device is tracked through a bus notifier as it comes and goes.
+ */
+static DEFINE_MUTEX(gigabyte_kbd_touchpad_lock);
+static struct acpi_device *gigabyte_kbd_touchpad_adev;
 static struct device_driver *gigabyte_kbd_touchpad_driver;
 static struct device *gigabyte_kbd_touchpad_device;
+static u64 gigabyte_kbd_touchpad_resume_us;
+
+static struct hid_driver gigabyte_kbd_driver;
+
+/*
+ * State the driver changes on its own (Fn keys, power policy, resume) is
+ * announced with sysfs_notify(), so userspace can poll() the attribute
+ * for POLLPRI and read it again instead of rereading it periodically.
+ * Touchpad state is global and shown by every bound interface. Only
+ * called while the HID driver is registered.
+ */
+static int gigabyte_kbd_notify_dev(struct device *dev, void *attr)
+{
+	sysfs_notify(&dev->kobj, NULL, attr);
+	return 0;
+}
+
+static void gigabyte_kbd_notify(const char *attr)
+{
+	driver_for_each_device(&gigabyte_kbd_driver.driver, NULL, (void *)attr,
+			       gigabyte_kbd_notify_dev);
+}
+
+/* The backlight core only notifies actual_brightness; bl_power is ours to announce */
+static void gigabyte_kbd_backlight_notify(struct backlight_device *bd)
+{
+	sysfs_notify(&bd->dev.kobj, NULL, "bl_power");
+}
 
 static inline int gigabyte_kbd_is_backlight_off(void)
 {
-	return gigabyte_kbd_backlight_device->props.power == FB_BLANK_POWERDOWN;
+	return gigabyte_kbd_backlight_device &&
+	       gigabyte_kbd_backlight_device->props.power == FB_BLANK_POWERDOWN;
 }
 
 static void gigabyte_kbd_backlight_toggle(struct work_struct *s)
@@ -75,20 +244,160 @@ static void gigabyte_kbd_backlight_toggle(struct work_struct *s)
 		backlight_enable(gigabyte_kbd_backlight_device);
 	else
 		backlight_disable(gigabyte_kbd_backlight_device);
+	gigabyte_kbd_backlight_notify(gigabyte_kbd_backlight_device);
 }
 
-static void gigabyte_kbd_touchpad_toggle_driver(struct work_struct *s)
+/*
+ * Fn+F10 turns the touchpad off by unbinding its driver and back on by
+ * binding it again, both through the driver core. i2c-hid's remove frees
+ * the touchpad IRQ, so it raises no more interrupts, but on ACPI machines
+ * leaves the device itself running; the driver then sends it the HID over
+ * I2C SET_POWER SLEEP command. As an unbound device it is left alone by
+ * system sleep. Turning it back on re-probes it, and i2c-hid powers it on
+ * as it probes; the time that takes is in debugfs as touchpad_resume_us.
+ */
+
+/* HID over I2C: the HID descriptor register is found through this _DSM */
+static const guid_t gigabyte_kbd_i2c_hid_guid =
+	GUID_INIT(0x3cdff6f7, 0x4267, 0x4555,
+		  0xad, 0x05, 0xb3, 0x0a, 0x3d, 0x89, 0x38, 0xde);
+
+#define GIGABYTE_KBD_I2C_HID_DESC_LEN	30
+#define GIGABYTE_KBD_I2C_HID_VERSION	0x0100
+#define GIGABYTE_KBD_I2C_HID_CMD_REG	16	/* wCommandRegister in the descriptor */
+#define GIGABYTE_KBD_I2C_HID_SET_POWER	0x08
+#define GIGABYTE_KBD_I2C_HID_PWR_SLEEP	0x01
+
+/* The touchpad's command register, read from its HID descriptor */
+static int gigabyte_kbd_touchpad_command_reg(struct i2c_client *client,
+					     struct acpi_device *adev)
 {
+	u8 reg[2], desc[GIGABYTE_KBD_I2C_HID_DESC_LEN];
+	struct i2c_msg msgs[] = {
+		{
+			.addr = client->addr,
+			.flags = client->flags & I2C_M_TEN,
+			.len = sizeof(reg),
+			.buf = reg,
+		}, {
+			.addr = client->addr,
+			.flags = (client->flags & I2C_M_TEN) | I2C_M_RD,
+			.len = sizeof(desc),
+			.buf = desc,
+		},
+	};
+	union acpi_object *obj;
+	int ret;
+
+	obj = acpi_evaluate_dsm_typed(adev->handle, &gigabyte_kbd_i2c_hid_guid, 1, 1,
+				      NULL, ACPI_TYPE_INTEGER);
+	if (!obj)
+		return -ENODEV;
+	reg[0] = obj->integer.value & 0xff;
+	reg[1] = (obj->integer.value >> 8) & 0xff;
+	ACPI_FREE(obj);
+
+	ret = i2c_transfer(client->adapter, msgs, ARRAY_SIZE(msgs));
+	if (ret != ARRAY_SIZE(msgs))
+		return ret < 0 ? ret : -EIO;
+	if ((desc[0] | desc[1] << 8) != sizeof(desc) ||
+	    (desc[2] | desc[3] << 8) != GIGABYTE_KBD_I2C_HID_VERSION)
+		return -EPROTO;
+	return desc[GIGABYTE_KBD_I2C_HID_CMD_REG] | desc[GIGABYTE_KBD_I2C_HID_CMD_REG + 1] << 8;
+}
+
+/*
+ * Put an unbound touchpad into its sleep state. Best effort: a touchpad
+ * that doesn't take the command stays powered, with its IRQ still freed.
+ */
+static void gigabyte_kbd_touchpad_sleep(struct device *dev)
+{
+	struct i2c_client *client = i2c_verify_client(dev);
+	struct acpi_device *adev = ACPI_COMPANION(dev);
+	u8 cmd[4];
+	int reg, ret;
+
+	if (!client || !adev)
+		return;
+
+	reg = gigabyte_kbd_touchpad_command_reg(client, adev);
+	if (reg < 0) {
+		dev_dbg(dev, "no HID descriptor, touchpad left powered: %d\n", reg);
+		return;
+	}
+
+	cmd[0] = reg & 0xff;
+	cmd[1] = reg >> 8;
+	cmd[2] = GIGABYTE_KBD_I2C_HID_PWR_SLEEP;
+	cmd[3] = GIGABYTE_KBD_I2C_HID_SET_POWER;
+	ret = i2c_master_send(client, cmd, sizeof(cmd));
+	if (ret != sizeof(cmd))
+		dev_dbg(dev, "touchpad SET_POWER SLEEP failed: %d\n", ret < 0 ? ret : -EIO);
+}
+
+/* Unbound by us; called with gigabyte_kbd_touchpad_lock held */
+static bool gigabyte_kbd_touchpad_is_off(void)
+{
+	return gigabyte_kbd_touchpad_device && gigabyte_kbd_touchpad_driver &&
+	       !gigabyte_kbd_touchpad_device->driver;
+}
+
+/* Called with gigabyte_kbd_touchpad_lock held */
+static int gigabyte_kbd_touchpad_set(bool on)
+{
+	struct device *dev = gigabyte_kbd_touchpad_device;
+	ktime_t start;
 	int err;
 
-	if (gigabyte_kbd_touchpad_device->driver) {
-		gigabyte_kbd_touchpad_driver = gigabyte_kbd_touchpad_device->driver;
-		device_release_driver(gigabyte_kbd_touchpad_device);
-	} else if (gigabyte_kbd_touchpad_driver) {
-		err = device_driver_attach(gigabyte_kbd_touchpad_driver,
-					   gigabyte_kbd_touchpad_device);
-		(void)err;
+	if (!dev)
+		return 0;
+
+	if (!on) {
+		if (dev->driver) {
+			gigabyte_kbd_touchpad_driver = dev->driver;
+			device_release_driver(dev);
+			if (!dev->driver)
+				gigabyte_kbd_touchpad_sleep(dev);
+		}
+		return 0;
 	}
+
+	if (dev->driver || !gigabyte_kbd_touchpad_driver)
+		return 0;
+
+	start = ktime_get();
+	err = device_driver_attach(gigabyte_kbd_touchpad_driver, dev);
+	if (err)
+		return err;
+
+	gigabyte_kbd_touchpad_resume_us = ktime_us_delta(ktime_get(), start);
+	dev_dbg(dev, "touchpad bound in %llu us\n", gigabyte_kbd_touchpad_resume_us);
+	return 0;
+}
+
+static void gigabyte_kbd_touchpad_toggle_driver(struct work_struct *s)
+{
+	bool was_off, changed;
+	int err;
+
+	mutex_lock(&gigabyte_kbd_touchpad_lock);
+	was_off = gigabyte_kbd_touchpad_is_off();
+	err = gigabyte_kbd_touchpad_set(was_off);
+	if (err)
+		dev_warn(gigabyte_kbd_touchpad_device, "touchpad toggle failed: %d\n", err);
+	changed = gigabyte_kbd_touchpad_is_off() != was_off;
+	mutex_unlock(&gigabyte_kbd_touchpad_lock);
+
+	if (changed)
+		gigabyte_kbd_notify("touchpad");
+}
+
+/* Never leave the touchpad unbound once nothing can turn it back on */
+static void gigabyte_kbd_touchpad_restore(void)
+{
+	mutex_lock(&gigabyte_kbd_touchpad_lock);
+	gigabyte_kbd_touchpad_set(true);
+	mutex_unlock(&gigabyte_kbd_touchpad_lock);
 }
 
 /*
@@ -98,54 +407,250 @@ static void gigabyte_kbd_touchpad_toggle_driver(struct work_struct *s)
 static DECLARE_WORK(gigabyte_kbd_backlight_toggle_work, gigabyte_kbd_backlight_toggle);
 static DECLARE_WORK(gigabyte_kbd_touchpad_toggle_driver_work, gigabyte_kbd_touchpad_toggle_driver);
 
-/* Emit a key press and release event */
-static void gigabyte_kbd_emit_key(struct input_dev *input, unsigned int key)
+/*
+ * An unbound touchpad stays unbound over system sleep, but one its bus
+ * re-enumerates comes back bound, and one the firmware powered down
+ * comes back awake. Whether Fn+F10 had it off is noted before the system
+ * starts suspending and put back after resume, once the resumed devices
+ * have probed.
+ */
+static bool gigabyte_kbd_touchpad_off_at_pm;
+
+static void gigabyte_kbd_touchpad_pm_restore(struct work_struct *s)
 {
-	if (!input)
-		return;
-	input_report_key(input, key, 1);
-	input_sync(input);
-	input_report_key(input, key, 0);
-	input_sync(input);
+	bool changed = false;
+
+	/* Probing is held off until resume ends, then runs asynchronously */
+	wait_for_device_probe();
+
+	/* Not if the last keyboard went away meanwhile and turned it back on */
+	mutex_lock(&gigabyte_kbd_config_lock);
+	mutex_lock(&gigabyte_kbd_touchpad_lock);
+	if (gigabyte_kbd_refcount && gigabyte_kbd_touchpad_device &&
+	    gigabyte_kbd_touchpad_device->driver) {
+		gigabyte_kbd_touchpad_set(false);
+		changed = gigabyte_kbd_touchpad_is_off();
+	} else if (gigabyte_kbd_refcount && gigabyte_kbd_touchpad_is_off()) {
+		gigabyte_kbd_touchpad_sleep(gigabyte_kbd_touchpad_device);
+	}
+	mutex_unlock(&gigabyte_kbd_touchpad_lock);
+	mutex_unlock(&gigabyte_kbd_config_lock);
+
+	if (changed) {
+		dev_dbg(gigabyte_kbd_touchpad_device, "touchpad turned off again after resume\n");
+		gigabyte_kbd_notify("touchpad");
+	}
+}
+
+static DECLARE_WORK(gigabyte_kbd_touchpad_pm_work, gigabyte_kbd_touchpad_pm_restore);
+
+static int gigabyte_kbd_pm_notify(struct notifier_block *nb,
+				  unsigned long action, void *data)
+{
+	switch (action) {
+	case PM_SUSPEND_PREPARE:
+	case PM_HIBERNATION_PREPARE:
+		/* A Fn+F10 pressed just before counts */
+		flush_work(&gigabyte_kbd_touchpad_toggle_driver_work);
+		mutex_lock(&gigabyte_kbd_touchpad_lock);
+		gigabyte_kbd_touchpad_off_at_pm = gigabyte_kbd_touchpad_is_off();
+		mutex_unlock(&gigabyte_kbd_touchpad_lock);
+		break;
+
+	case PM_POST_SUSPEND:
+	case PM_POST_HIBERNATION:
+		if (gigabyte_kbd_touchpad_off_at_pm)
+			schedule_work(&gigabyte_kbd_touchpad_pm_work);
+		gigabyte_kbd_touchpad_off_at_pm = false;
+		break;
+	}
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block gigabyte_kbd_pm_nb = {
+	.notifier_call = gigabyte_kbd_pm_notify,
+};
+
+static bool msc_timestamp;
+module_param(msc_timestamp, bool, 0444);
+MODULE_PARM_DESC(msc_timestamp, "Also report the event time as MSC_TIMESTAMP, in us (default: N)");
+
+/*
+ * Stamp the next event frame with ts instead of the time of input_sync().
+ * The input core drops the stamp at each sync, so this is per frame.
+ */
+static void gigabyte_kbd_stamp(struct input_dev *dev, ktime_t ts)
+{
+	input_set_timestamp(dev, ts);
+	if (msc_timestamp)
+		input_event(dev, EV_MSC, MSC_TIMESTAMP, (u32)ktime_to_us(ts));
+}
+
+/*
+ * Emit a key press and release event for a keymap scancode. The keys
+ * have no release report, so the press carries the time the report
+ * arrived and the release the time it is synthesized, always later.
+ */
+static int gigabyte_kbd_emit_key(unsigned int code, ktime_t ts)
+{
+	const struct key_entry *ke = NULL;
+	struct input_dev *input;
+
+	rcu_read_lock();
+	input = rcu_dereference(gigabyte_kbd_input_dev);
+	if (input)
+		ke = sparse_keymap_entry_from_scancode(input, code);
+	if (ke) {
+		gigabyte_kbd_stamp(input, ts);
+		sparse_keymap_report_entry(input, ke, 1, false);
+		gigabyte_kbd_stamp(input, ktime_get());
+		sparse_keymap_report_entry(input, ke, 0, false);
+	}
+	rcu_read_unlock();
+	return ke != NULL;
 }
 
 /* Emit volume key to Consumer Control device for proper DE integration */
-static void gigabyte_kbd_emit_volume(unsigned int key, int pressed)
+static bool gigabyte_kbd_emit_volume(unsigned int code, int value, ktime_t ts)
 {
-	struct input_dev *dev = gigabyte_kbd_consumer_dev ?: gigabyte_kbd_input_dev;
+	struct input_dev *input, *dev;
+	const struct key_entry *ke;
+	bool sent = false;
 
-	if (!dev)
-		return;
-	input_report_key(dev, key, pressed);
+	rcu_read_lock();
+	input = rcu_dereference(gigabyte_kbd_input_dev);
+	if (!input)
+		goto out;
+	dev = rcu_dereference(gigabyte_kbd_consumer_dev);
+	ke = sparse_keymap_entry_from_scancode(input, code);
+	if (!ke || ke->type != KE_KEY)
+		goto out;
+
+	/* Keys remapped to something Consumer Control can't report stay on Fn Keys */
+	if (!dev || !test_bit(ke->keycode, dev->keybit))
+		dev = input;
+
+	gigabyte_kbd_stamp(dev, ts);
+	if (value != 2)
+		input_event(dev, EV_MSC, MSC_SCAN, code);
+	input_event(dev, EV_KEY, ke->keycode, value);
 	input_sync(dev);
+	sent = true;
+out:
+	rcu_read_unlock();
+	return sent;
 }
 
-static int gigabyte_kbd_raw_event(struct hid_device *hdev,
-				  struct hid_report *report, u8 *rd, int size)
+/*
+ * Fn+F8/F9 hold-repeat is generated here, so it is the same on every
+ * desktop and isn't delayed by a busy userspace. The first repeat comes
+ * volume_repeat_delay after the press, then every volume_repeat_period,
+ * which shrinks by volume_repeat_accel percent per repeat down to
+ * volume_repeat_period_min. The release code stops it.
+ */
+static unsigned int volume_repeat_delay = 500;
+module_param(volume_repeat_delay, uint, 0644);
+MODULE_PARM_DESC(volume_repeat_delay, "Fn+F8/F9 hold time before repeating in ms, 0 disables repeat (default: 500)");
+
+static unsigned int volume_repeat_period = 100;
+module_param(volume_repeat_period, uint, 0644);
+MODULE_PARM_DESC(volume_repeat_period, "Fn+F8/F9 initial repeat period in ms (default: 100)");
+
+static unsigned int volume_repeat_accel = 10;
+module_param(volume_repeat_accel, uint, 0644);
+MODULE_PARM_DESC(volume_repeat_accel, "Percent the repeat period shrinks by on each repeat (default: 10)");
+
+static unsigned int volume_repeat_period_min = 30;
+module_param(volume_repeat_period_min, uint, 0644);
+MODULE_PARM_DESC(volume_repeat_period_min, "Shortest Fn+F8/F9 repeat period in ms (default: 30)");
+
+/*
+ * Written from raw_event with the timer stopped and by the timer itself,
+ * read by both, hence the _ONCE accessors: the release path also reads the
+ * code while the timer may be running.
+ */
+static struct hrtimer gigabyte_kbd_volume_timer;
+static unsigned int gigabyte_kbd_volume_code;	/* Press code being repeated */
+static u64 gigabyte_kbd_volume_period_ns;
+
+static enum hrtimer_restart gigabyte_kbd_volume_repeat(struct hrtimer *timer)
+{
+	u64 period = READ_ONCE(gigabyte_kbd_volume_period_ns);
+	u64 min_ns = (u64)max(READ_ONCE(volume_repeat_period_min), 1U) * NSEC_PER_MSEC;
+
+	if (!gigabyte_kbd_emit_volume(READ_ONCE(gigabyte_kbd_volume_code), 2, ktime_get()))
+		return HRTIMER_NORESTART;
+
+	hrtimer_forward_now(timer, ns_to_ktime(period));
+
+	period -= div_u64(period * min(READ_ONCE(volume_repeat_accel), 100U), 100);
+	WRITE_ONCE(gigabyte_kbd_volume_period_ns, max(period, min_ns));
+	return HRTIMER_RESTART;
+}
+
+static void gigabyte_kbd_volume_press(unsigned int code, ktime_t ts)
+{
+	unsigned int delay = READ_ONCE(volume_repeat_delay);
+
+	/* A new press takes the repeat over, as with the input core's repeat */
+	hrtimer_cancel(&gigabyte_kbd_volume_timer);
+
+	if (!gigabyte_kbd_emit_volume(code, 1, ts) || !delay)
+		return;
+
+	WRITE_ONCE(gigabyte_kbd_volume_code, code);
+	WRITE_ONCE(gigabyte_kbd_volume_period_ns,
+		   (u64)max(READ_ONCE(volume_repeat_period), 1U) * NSEC_PER_MSEC);
+	hrtimer_start(&gigabyte_kbd_volume_timer, ms_to_ktime(delay), HRTIMER_MODE_REL);
+}
+
+/* Releases are looked up by their press code so remaps stay paired */
+static void gigabyte_kbd_volume_release(unsigned int code, ktime_t ts)
+{
+	if (code == READ_ONCE(gigabyte_kbd_volume_code))
+		hrtimer_cancel(&gigabyte_kbd_volume_timer);
+	gigabyte_kbd_emit_volume(code, 0, ts);
+}
+
+static void gigabyte_kbd_volume_init(void)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(&gigabyte_kbd_volume_timer, gigabyte_kbd_volume_repeat,
+		      CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+#else
+	hrtimer_init(&gigabyte_kbd_volume_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	gigabyte_kbd_volume_timer.function = gigabyte_kbd_volume_repeat;
+#endif
+}
+
+static int gigabyte_kbd_handle_raw_event(struct hid_device *hdev,
+					 struct hid_report *report, u8 *rd,
+					 int size, u8 *action)
 {
 	u32 hidraw;
+	ktime_t ts;
 
+	/*
+	 * Exactly four bytes, as every keyboard seen so far sends it. A longer
+	 * report 4, as padded NKRO firmware might send, is not taken apart on
+	 * a guess about its layout; fn_keys.cpp checks the same.
+	 */
 	if (report->id != 4 || size != 4)
 		return 0;
 
+	/* Closest to the USB completion we get: raw_event runs from it */
+	ts = ktime_get();
+
 	hidraw = make_u32(rd[0], rd[1], rd[2], rd[3]);
 
 	switch (hidraw) {
-	case HIDRAW_FN_ESC:
-		/* Fan control - emit KEY_PROG2 for user-space handling */
-		gigabyte_kbd_emit_key(gigabyte_kbd_input_dev, KEY_PROG2);
-		return 1;
-
-	case HIDRAW_FN_F2:
-		gigabyte_kbd_emit_key(gigabyte_kbd_input_dev, KEY_WLAN);
-		return 1;
-
 	case HIDRAW_FN_F3:
 		if (gigabyte_kbd_is_backlight_off())
 			return 0;
 		rd[0] = 0x03; rd[1] = 0x70; rd[2] = 0x00;
 		hid_report_raw_event(hdev, HID_INPUT_REPORT, rd, 4, 0);
 		rd[0] = 0x03; rd[1] = 0x00; rd[2] = 0x00;
+		*action = GIGABYTE_KBD_ACTION_BRIGHTNESS;
 		return 1;
 
 	case HIDRAW_FN_F4:
@@ -154,123 +659,795 @@ static int gigabyte_kbd_raw_event(struct hid_device *hdev,
 		rd[0] = 0x03; rd[1] = 0x6f; rd[2] = 0x00;
 		hid_report_raw_event(hdev, HID_INPUT_REPORT, rd, 4, 0);
 		rd[0] = 0x03; rd[1] = 0x00; rd[2] = 0x00;
-		return 1;
-
-	case HIDRAW_FN_F5:
-		gigabyte_kbd_emit_key(gigabyte_kbd_input_dev, KEY_SWITCHVIDEOMODE);
+		*action = GIGABYTE_KBD_ACTION_BRIGHTNESS;
 		return 1;
 
 	case HIDRAW_FN_F6:
-		if (gigabyte_kbd_backlight_device)
+		if (gigabyte_kbd_backlight_device) {
 			schedule_work(&gigabyte_kbd_backlight_toggle_work);
+			*action = GIGABYTE_KBD_ACTION_BACKLIGHT;
+		}
 		return 0;	/* Pass through for other handlers */
 
 	case HIDRAW_FN_F8_PRESS:
-		gigabyte_kbd_emit_volume(KEY_VOLUMEDOWN, 1);
-		return 1;
-
-	case HIDRAW_FN_F8_RELEASE:
-		gigabyte_kbd_emit_volume(KEY_VOLUMEDOWN, 0);
-		return 1;
-
 	case HIDRAW_FN_F9_PRESS:
-		gigabyte_kbd_emit_volume(KEY_VOLUMEUP, 1);
+		gigabyte_kbd_volume_press(hidraw, ts);
+		*action = GIGABYTE_KBD_ACTION_VOLUME;
 		return 1;
 
+	case HIDRAW_FN_F8_RELEASE:
 	case HIDRAW_FN_F9_RELEASE:
-		gigabyte_kbd_emit_volume(KEY_VOLUMEUP, 0);
+		gigabyte_kbd_volume_release(hidraw | HIDRAW_FN_PRESS_FLAG, ts);
+		*action = GIGABYTE_KBD_ACTION_VOLUME;
 		return 1;
 
 	case HIDRAW_FN_F10:
-		if (gigabyte_kbd_touchpad_device)
+		if (gigabyte_kbd_touchpad_device) {
 			schedule_work(&gigabyte_kbd_touchpad_toggle_driver_work);
+			*action = GIGABYTE_KBD_ACTION_TOUCHPAD;
+		}
 		return 0;
 
-	case HIDRAW_FN_F11:
-		gigabyte_kbd_emit_key(gigabyte_kbd_input_dev, KEY_RFKILL);
+	default:
+		/* ESC, F2, F5, F11 and F12 come from the remappable keymap */
+		if (!gigabyte_kbd_emit_key(hidraw, ts))
+			return 0;
+		*action = GIGABYTE_KBD_ACTION_KEY;
 		return 1;
+	}
+}
 
-	case HIDRAW_FN_F12:
-	case HIDRAW_FN_F12_ALT:
-		gigabyte_kbd_emit_key(gigabyte_kbd_input_dev, KEY_PROG1);
-		return 1;
+/*
+ * Raw report capture, see gigabytekbd_capture.h for the format.
+ *
+ * Each CPU owns a ring it alone writes to, with interrupts off so nested
+ * reports on the same CPU can't interleave. The debugfs reader is the only
+ * consumer, so head and tail are handed over with acquire/release and
+ * no lock is taken on the report path.
+ */
+#define GIGABYTE_KBD_CAPTURE_RING_SIZE	256	/* Records per CPU, power of 2 */
 
-	default:
-		return 0;
+struct gigabyte_kbd_capture_ring {
+	unsigned int head;	/* Written by the owning CPU */
+	unsigned int tail;	/* Written by the reader */
+	struct gigabyte_kbd_capture_record records[GIGABYTE_KBD_CAPTURE_RING_SIZE];
+};
+
+static DEFINE_STATIC_KEY_FALSE(gigabyte_kbd_capture_key);
+static struct gigabyte_kbd_capture_ring __percpu *gigabyte_kbd_capture_rings;
+static DEFINE_MUTEX(gigabyte_kbd_capture_lock);
+static atomic_t gigabyte_kbd_capture_dropped;
+static struct dentry *gigabyte_kbd_debugfs;
+
+static void gigabyte_kbd_capture_push(const struct gigabyte_kbd_capture_record *rec)
+{
+	struct gigabyte_kbd_capture_ring *ring;
+	unsigned long flags;
+	unsigned int head;
+
+	local_irq_save(flags);
+	ring = this_cpu_ptr(gigabyte_kbd_capture_rings);
+	head = ring->head;
+	if (head - smp_load_acquire(&ring->tail) >= GIGABYTE_KBD_CAPTURE_RING_SIZE) {
+		atomic_inc(&gigabyte_kbd_capture_dropped);
+	} else {
+		ring->records[head & (GIGABYTE_KBD_CAPTURE_RING_SIZE - 1)] = *rec;
+		smp_store_release(&ring->head, head + 1);
 	}
+	local_irq_restore(flags);
+}
+
+static noinline int gigabyte_kbd_capture_raw_event(struct hid_device *hdev,
+						   struct hid_report *report,
+						   u8 *rd, int size)
+{
+	struct gigabyte_kbd_capture_record rec = { };
+	u8 action = GIGABYTE_KBD_ACTION_PASS;
+	int ret;
+
+	/* Snapshot first: the handler rewrites brightness reports in place */
+	rec.timestamp = cpu_to_le64(ktime_get_ns());
+	rec.vendor = cpu_to_le16(hdev->vendor);
+	rec.product = cpu_to_le16(hdev->product);
+	rec.report_id = report->id;
+	rec.size = cpu_to_le16(size);
+	memcpy(rec.data, rd, min_t(int, size, GIGABYTE_KBD_CAPTURE_PAYLOAD));
+
+	ret = gigabyte_kbd_handle_raw_event(hdev, report, rd, size, &action);
+
+	rec.action = action;
+	gigabyte_kbd_capture_push(&rec);
+	return ret;
 }
 
-static int gigabyte_kbd_match_touchpad_device(struct device *dev, const void *data)
+static int gigabyte_kbd_raw_event(struct hid_device *hdev,
+				  struct hid_report *report, u8 *rd, int size)
 {
-	struct acpi_device *acpi;
-	const char *hid;
-	char *bid;
-	int instance_no, i;
+	u8 action;
 
-	acpi = ACPI_COMPANION(dev);
-	if (!acpi)
-		return 0;
+	if (static_branch_unlikely(&gigabyte_kbd_capture_key))
+		return gigabyte_kbd_capture_raw_event(hdev, report, rd, size);
+
+	return gigabyte_kbd_handle_raw_event(hdev, report, rd, size, &action);
+}
 
-	hid = acpi_device_hid(acpi);
-	bid = acpi_device_bid(acpi);
-	instance_no = acpi->pnp.instance_no;
+/* Oldest record across all CPUs, so the trace reads in timestamp order */
+static struct gigabyte_kbd_capture_ring *gigabyte_kbd_capture_oldest(void)
+{
+	struct gigabyte_kbd_capture_ring *ring, *oldest = NULL;
+	u64 ts, oldest_ts = U64_MAX;
+	unsigned int tail;
+	int cpu;
 
-	for (i = 0; i < ARRAY_SIZE(gigabyte_kbd_touchpad_device_identifiers); i++) {
-		if (!strcmp(gigabyte_kbd_touchpad_device_identifiers[i].hid, hid) &&
-		    !strcmp(gigabyte_kbd_touchpad_device_identifiers[i].bid, bid) &&
-		    gigabyte_kbd_touchpad_device_identifiers[i].instance_no == instance_no)
-			return 1;
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(gigabyte_kbd_capture_rings, cpu);
+		tail = ring->tail;
+		if (smp_load_acquire(&ring->head) == tail)
+			continue;
+		ts = le64_to_cpu(ring->records[tail & (GIGABYTE_KBD_CAPTURE_RING_SIZE - 1)].timestamp);
+		if (ts < oldest_ts) {
+			oldest_ts = ts;
+			oldest = ring;
+		}
 	}
-	return 0;
+	return oldest;
 }
 
-static int gigabyte_kbd_setup_input_dev(struct hid_device *hdev)
+static ssize_t gigabyte_kbd_trace_read(struct file *file, char __user *buf,
+				       size_t count, loff_t *ppos)
 {
-	struct input_dev *input;
+	const size_t rec_size = sizeof(struct gigabyte_kbd_capture_record);
+	struct gigabyte_kbd_capture_ring *ring;
+	unsigned int tail;
+	ssize_t copied = 0;
+
+	if (count < rec_size)
+		return -EINVAL;
+
+	mutex_lock(&gigabyte_kbd_capture_lock);
+	if (!gigabyte_kbd_capture_rings)
+		goto out;
+
+	while (count - copied >= rec_size) {
+		ring = gigabyte_kbd_capture_oldest();
+		if (!ring)
+			break;
+		tail = ring->tail;
+		if (copy_to_user(buf + copied,
+				 &ring->records[tail & (GIGABYTE_KBD_CAPTURE_RING_SIZE - 1)],
+				 rec_size)) {
+			if (!copied)
+				copied = -EFAULT;
+			break;
+		}
+		smp_store_release(&ring->tail, tail + 1);
+		copied += rec_size;
+	}
+out:
+	mutex_unlock(&gigabyte_kbd_capture_lock);
+	return copied;
+}
+
+static ssize_t gigabyte_kbd_capture_read(struct file *file, char __user *buf,
+					 size_t count, loff_t *ppos)
+{
+	char val[2] = { static_key_enabled(&gigabyte_kbd_capture_key) ? '1' : '0', '\n' };
+
+	return simple_read_from_buffer(buf, count, ppos, val, sizeof(val));
+}
+
+static ssize_t gigabyte_kbd_capture_write(struct file *file, const char __user *buf,
+					  size_t count, loff_t *ppos)
+{
+	bool enable;
 	int ret;
 
-	if (gigabyte_kbd_input_dev) {
-		gigabyte_kbd_refcount++;
-		return 0;
+	ret = kstrtobool_from_user(buf, count, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&gigabyte_kbd_capture_lock);
+	/* Rings stay allocated once used so disabled captures can still be read */
+	if (enable && !gigabyte_kbd_capture_rings) {
+		gigabyte_kbd_capture_rings = alloc_percpu(struct gigabyte_kbd_capture_ring);
+		if (!gigabyte_kbd_capture_rings)
+			ret = -ENOMEM;
+	}
+	if (!ret) {
+		if (enable)
+			static_branch_enable(&gigabyte_kbd_capture_key);
+		else
+			static_branch_disable(&gigabyte_kbd_capture_key);
+	}
+	mutex_unlock(&gigabyte_kbd_capture_lock);
+
+	return ret ?: count;
+}
+
+static const struct file_operations gigabyte_kbd_trace_fops = {
+	.owner = THIS_MODULE,
+	.open = nonseekable_open,
+	.read = gigabyte_kbd_trace_read,
+};
+
+static const struct file_operations gigabyte_kbd_capture_fops = {
+	.owner = THIS_MODULE,
+	.read = gigabyte_kbd_capture_read,
+	.write = gigabyte_kbd_capture_write,
+	.llseek = default_llseek,
+};
+
+static void gigabyte_kbd_capture_init(void)
+{
+	gigabyte_kbd_debugfs = debugfs_create_dir("gigabytekbd", NULL);
+	debugfs_create_file("capture", 0600, gigabyte_kbd_debugfs, NULL,
+			    &gigabyte_kbd_capture_fops);
+	debugfs_create_file("trace", 0400, gigabyte_kbd_debugfs, NULL,
+			    &gigabyte_kbd_trace_fops);
+	debugfs_create_atomic_t("dropped", 0400, gigabyte_kbd_debugfs,
+				&gigabyte_kbd_capture_dropped);
+	debugfs_create_u64("touchpad_resume_us", 0400, gigabyte_kbd_debugfs,
+			   &gigabyte_kbd_touchpad_resume_us);
+}
+
+static void gigabyte_kbd_capture_exit(void)
+{
+	debugfs_remove_recursive(gigabyte_kbd_debugfs);
+	static_branch_disable(&gigabyte_kbd_capture_key);
+	free_percpu(gigabyte_kbd_capture_rings);
+}
+
+static struct acpi_device *
+gigabyte_kbd_match_touchpad_adev(const struct gigabyte_kbd_touchpad_device_identifier *id)
+{
+	struct acpi_device *adev;
+
+	for_each_acpi_dev_match(adev, id->hid, NULL, -1) {
+		/* Breaking out keeps the reference taken by the iterator */
+		if (!strcmp(acpi_device_bid(adev), id->bid) &&
+		    adev->pnp.instance_no == id->instance_no)
+			return adev;
+	}
+	return NULL;
+}
+
+/*
+ * Find the touchpad's ACPI node through the namespace by HID. The model's
+ * touchpad is tried first, then every known one, so a DMI match that is
+ * wrong about the touchpad doesn't leave Fn+F10 without one.
+ */
+static struct acpi_device *
+gigabyte_kbd_find_touchpad_adev(const struct gigabyte_kbd_config *cfg)
+{
+	const char *preferred = cfg->profile.touchpad_hid;
+	struct acpi_device *adev;
+	unsigned int i;
+
+	for (i = 0; preferred && i < cfg->num_touchpads; i++) {
+		if (strcmp(preferred, cfg->touchpads[i].hid))
+			continue;
+		adev = gigabyte_kbd_match_touchpad_adev(&cfg->touchpads[i]);
+		if (adev)
+			return adev;
+	}
+
+	for (i = 0; i < cfg->num_touchpads; i++) {
+		if (preferred && !strcmp(preferred, cfg->touchpads[i].hid))
+			continue;
+		adev = gigabyte_kbd_match_touchpad_adev(&cfg->touchpads[i]);
+		if (adev) {
+			if (preferred)
+				pr_info("gigabytekbd: touchpad %s not found, using %s\n",
+					preferred, cfg->touchpads[i].hid);
+			return adev;
+		}
+	}
+	return NULL;
+}
+
+static void gigabyte_kbd_touchpad_attach(struct device *dev)
+{
+	gigabyte_kbd_touchpad_device = get_device(dev);
+	gigabyte_kbd_touchpad_driver = dev->driver;
+}
+
+static void gigabyte_kbd_touchpad_detach(void)
+{
+	put_device(gigabyte_kbd_touchpad_device);
+	gigabyte_kbd_touchpad_device = NULL;
+	gigabyte_kbd_touchpad_driver = NULL;
+}
+
+/* Resolve the touchpad I2C device, reusing the cached lookup if there is one */
+static void gigabyte_kbd_touchpad_lookup(const struct gigabyte_kbd_config *cfg)
+{
+	struct device *dev;
+
+	mutex_lock(&gigabyte_kbd_touchpad_lock);
+	if (gigabyte_kbd_touchpad_device)
+		goto out;
+
+	if (!gigabyte_kbd_touchpad_adev)
+		gigabyte_kbd_touchpad_adev = gigabyte_kbd_find_touchpad_adev(cfg);
+	if (!gigabyte_kbd_touchpad_adev)
+		goto out;
+
+	dev = acpi_get_first_physical_node(gigabyte_kbd_touchpad_adev);
+	if (dev && dev->bus == &i2c_bus_type)
+		gigabyte_kbd_touchpad_attach(dev);
+out:
+	mutex_unlock(&gigabyte_kbd_touchpad_lock);
+}
+
+/* Keep the cached touchpad in sync as its I2C device comes and goes */
+static int gigabyte_kbd_i2c_notify(struct notifier_block *nb,
+				   unsigned long action, void *data)
+{
+	struct device *dev = data;
+
+	switch (action) {
+	case BUS_NOTIFY_ADD_DEVICE:
+		mutex_lock(&gigabyte_kbd_touchpad_lock);
+		if (!gigabyte_kbd_touchpad_device && gigabyte_kbd_touchpad_adev &&
+		    ACPI_COMPANION(dev) == gigabyte_kbd_touchpad_adev)
+			gigabyte_kbd_touchpad_attach(dev);
+		mutex_unlock(&gigabyte_kbd_touchpad_lock);
+		break;
+
+	case BUS_NOTIFY_DEL_DEVICE:
+		mutex_lock(&gigabyte_kbd_touchpad_lock);
+		if (dev == gigabyte_kbd_touchpad_device)
+			gigabyte_kbd_touchpad_detach();
+		mutex_unlock(&gigabyte_kbd_touchpad_lock);
+		break;
+	}
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block gigabyte_kbd_i2c_nb = {
+	.notifier_call = gigabyte_kbd_i2c_notify,
+};
+
+static bool gigabyte_kbd_config_str_ok(const char *s, size_t len, bool empty_ok)
+{
+	return memchr(s, '\0', len) && (empty_ok || s[0]);
+}
+
+static void gigabyte_kbd_config_free(struct gigabyte_kbd_config *cfg)
+{
+	if (cfg == &gigabyte_kbd_builtin_config)
+		return;
+	kfree(cfg->profile.keymap);
+	kfree(cfg->touchpads);
+	kfree(cfg->blob);
+	kfree(cfg);
+}
+
+/* Validate a config blob and build the tables it describes */
+static struct gigabyte_kbd_config *gigabyte_kbd_config_parse(const u8 *data, size_t size)
+{
+	const struct gigabyte_kbd_config_header *hdr = (const void *)data;
+	const struct gigabyte_kbd_config_touchpad *tp;
+	const struct gigabyte_kbd_config_model *model;
+	const struct gigabyte_kbd_config_key *key;
+	struct gigabyte_kbd_touchpad_device_identifier *ids;
+	const char *sys_vendor, *product;
+	struct gigabyte_kbd_config *cfg;
+	unsigned int hdr_size, num_keys, num_touchpads, num_models, i;
+	struct key_entry *keymap;
+	bool matched = false;
+	size_t payload;
+	u32 caps;
+
+	if (size < sizeof(*hdr) || le32_to_cpu(hdr->magic) != GIGABYTE_KBD_CONFIG_MAGIC)
+		return ERR_PTR(-EINVAL);
+	if (le16_to_cpu(hdr->version) != GIGABYTE_KBD_CONFIG_VERSION)
+		return ERR_PTR(-EPROTONOSUPPORT);
+
+	hdr_size = le16_to_cpu(hdr->header_size);
+	num_keys = le16_to_cpu(hdr->num_keys);
+	num_touchpads = le16_to_cpu(hdr->num_touchpads);
+	num_models = le16_to_cpu(hdr->num_models);
+	if (hdr_size < sizeof(*hdr) || !IS_ALIGNED(hdr_size, 4) ||
+	    le32_to_cpu(hdr->size) != size || !num_keys ||
+	    num_keys > GIGABYTE_KBD_CONFIG_MAX_KEYS ||
+	    num_touchpads > GIGABYTE_KBD_CONFIG_MAX_ENTRIES ||
+	    num_models > GIGABYTE_KBD_CONFIG_MAX_ENTRIES)
+		return ERR_PTR(-EINVAL);
+
+	payload = num_keys * sizeof(*key) + num_touchpads * sizeof(*tp) +
+		  num_models * sizeof(*model);
+	if (size != hdr_size + payload)
+		return ERR_PTR(-EINVAL);
+	if ((crc32_le(~0, data + hdr_size, payload) ^ ~0) != le32_to_cpu(hdr->crc32))
+		return ERR_PTR(-EBADMSG);
+
+	cfg = kzalloc(sizeof(*cfg), GFP_KERNEL);
+	if (!cfg)
+		return ERR_PTR(-ENOMEM);
+	cfg->blob = kmemdup(data, size, GFP_KERNEL);
+	keymap = kcalloc(num_keys + 1, sizeof(*keymap), GFP_KERNEL);
+	ids = kcalloc(num_touchpads ?: 1, sizeof(*ids), GFP_KERNEL);
+	cfg->profile.keymap = keymap;
+	cfg->touchpads = ids;
+	if (!cfg->blob || !keymap || !ids) {
+		gigabyte_kbd_config_free(cfg);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	key = cfg->blob + hdr_size;
+	for (i = 0; i < num_keys; i++, key++) {
+		keymap[i].type = KE_KEY;
+		keymap[i].code = le32_to_cpu(key->code);
+		keymap[i].keycode = le16_to_cpu(key->keycode);
+		if (!keymap[i].keycode || keymap[i].keycode > KEY_MAX)
+			goto invalid;
 	}
+	keymap[i].type = KE_END;
+
+	tp = (const void *)key;
+	for (i = 0; i < num_touchpads; i++, tp++) {
+		if (!gigabyte_kbd_config_str_ok(tp->hid, sizeof(tp->hid), false) ||
+		    !gigabyte_kbd_config_str_ok(tp->bid, sizeof(tp->bid), false))
+			goto invalid;
+		ids[i].hid = tp->hid;
+		ids[i].bid = tp->bid;
+		ids[i].instance_no = le32_to_cpu(tp->instance_no);
+	}
+	cfg->num_touchpads = num_touchpads;
+
+	/* Without a matching model the DMI-selected built-in quirks apply */
+	cfg->profile.name = gigabyte_kbd_builtin_config.profile.name;
+	cfg->profile.touchpad_hid = gigabyte_kbd_builtin_config.profile.touchpad_hid;
+	cfg->profile.backlight = gigabyte_kbd_builtin_config.profile.backlight;
+	cfg->profile.caps = gigabyte_kbd_builtin_config.profile.caps;
+
+	/* Node selection is not part of the config format */
+	cfg->profile.connect = gigabyte_kbd_builtin_config.profile.connect;
+	cfg->profile.vendor_connect = gigabyte_kbd_builtin_config.profile.vendor_connect;
+	cfg->profile.ignore_apps = gigabyte_kbd_builtin_config.profile.ignore_apps;
+
+	sys_vendor = dmi_get_system_info(DMI_SYS_VENDOR) ?: "";
+	product = dmi_get_system_info(DMI_PRODUCT_NAME) ?: "";
+	model = (const void *)tp;
+	for (i = 0; i < num_models; i++, model++) {
+		caps = le32_to_cpu(model->caps);
+		if (!gigabyte_kbd_config_str_ok(model->vendor, sizeof(model->vendor), true) ||
+		    !gigabyte_kbd_config_str_ok(model->product, sizeof(model->product), true) ||
+		    !gigabyte_kbd_config_str_ok(model->name, sizeof(model->name), false) ||
+		    !gigabyte_kbd_config_str_ok(model->touchpad_hid,
+						sizeof(model->touchpad_hid), true) ||
+		    !gigabyte_kbd_config_str_ok(model->backlight, sizeof(model->backlight),
+						!(caps & GIGABYTE_KBD_CAP_BACKLIGHT)) ||
+		    (caps & ~GIGABYTE_KBD_CAP_ALL))
+			goto invalid;
+		if (matched || !strstr(sys_vendor, model->vendor) ||
+		    !strstr(product, model->product))
+			continue;
+		cfg->profile.name = model->name;
+		cfg->profile.touchpad_hid = model->touchpad_hid[0] ? model->touchpad_hid : NULL;
+		cfg->profile.backlight = model->backlight;
+		cfg->profile.caps = caps;
+		matched = true;
+	}
+	return cfg;
+
+invalid:
+	gigabyte_kbd_config_free(cfg);
+	return ERR_PTR(-EINVAL);
+}
+
+static const struct key_entry *gigabyte_kbd_keymap_find(const struct key_entry *keymap,
+							 u32 code)
+{
+	for (; keymap->type != KE_END; keymap++) {
+		if (keymap->code == code)
+			return keymap;
+	}
+	return NULL;
+}
+
+static void gigabyte_kbd_set_keycode(struct input_dev *input, u32 code, unsigned int keycode)
+{
+	struct input_keymap_entry ke = {
+		.len = sizeof(code),
+		.keycode = keycode,
+	};
+
+	memcpy(ke.scancode, &code, sizeof(code));
+	input_set_keycode(input, &ke);
+}
+
+/*
+ * Apply a new keymap to the registered Fn Keys device, as EVIOCSKEYCODE
+ * would, so open clients keep their node and remaps made through hwdb or
+ * EVIOCSKEYCODE survive. Only scancodes whose keycode the new map changes
+ * are touched; ones it drops map to KEY_RESERVED and stop producing keys.
+ * sparse-keymap can't add scancodes to a registered device, so a map with
+ * new ones is refused. Called with gigabyte_kbd_config_lock held.
+ */
+static bool gigabyte_kbd_keymap_update(struct input_dev *input,
+				       const struct key_entry *keymap,
+				       const struct key_entry *old)
+{
+	const struct key_entry *ke, *prev;
+
+	for (ke = keymap; ke->type != KE_END; ke++) {
+		if (!sparse_keymap_entry_from_scancode(input, ke->code))
+			return false;
+	}
+
+	for (ke = keymap; ke->type != KE_END; ke++) {
+		prev = gigabyte_kbd_keymap_find(old, ke->code);
+		if (!prev || prev->keycode != ke->keycode)
+			gigabyte_kbd_set_keycode(input, ke->code, ke->keycode);
+	}
+	for (ke = old; ke->type != KE_END; ke++) {
+		if (!gigabyte_kbd_keymap_find(keymap, ke->code))
+			gigabyte_kbd_set_keycode(input, ke->code, KEY_RESERVED);
+	}
+	return true;
+}
+
+static struct input_dev *gigabyte_kbd_create_input_dev(struct device *parent,
+						       const struct input_id *id,
+						       const struct key_entry *keymap)
+{
+	struct input_dev *input;
+	int ret;
 
 	input = input_allocate_device();
 	if (!input)
-		return -ENOMEM;
+		return ERR_PTR(-ENOMEM);
 
 	input->name = "Gigabyte Fn Keys";
 	input->phys = "gigabytekbd/input0";
-	input->id.bustype = BUS_USB;
-	input->id.vendor = hdev->vendor;
-	input->id.product = hdev->product;
-	input->id.version = hdev->version;
-	input->dev.parent = &hdev->dev;
-
-	set_bit(EV_KEY, input->evbit);
-	set_bit(KEY_WLAN, input->keybit);
-	set_bit(KEY_SWITCHVIDEOMODE, input->keybit);
-	set_bit(KEY_VOLUMEDOWN, input->keybit);
-	set_bit(KEY_VOLUMEUP, input->keybit);
-	set_bit(KEY_RFKILL, input->keybit);
-	set_bit(KEY_PROG1, input->keybit);
-	set_bit(KEY_PROG2, input->keybit);
+	input->id = *id;
+	input->dev.parent = parent;
+
+	ret = sparse_keymap_setup(input, keymap, NULL);
+	if (ret)
+		goto err;
+	if (msc_timestamp)
+		input_set_capability(input, EV_MSC, MSC_TIMESTAMP);
+	ret = input_register_device(input);
+	if (ret)
+		goto err;
+	return input;
+
+err:
+	input_free_device(input);
+	return ERR_PTR(ret);
+}
+
+/*
+ * Volume keys go to a consumer-class device of our own rather than to the
+ * keyboard's Consumer Control, which belongs to hid-input and may go away
+ * before we do.
+ */
+static struct input_dev *gigabyte_kbd_create_consumer_dev(struct device *parent,
+							  const struct input_id *id)
+{
+	struct input_dev *input;
+	int ret;
+
+	input = input_allocate_device();
+	if (!input)
+		return ERR_PTR(-ENOMEM);
+
+	input->name = "Gigabyte Consumer Control";
+	input->phys = "gigabytekbd/input1";
+	input->id = *id;
+	input->dev.parent = parent;
+
+	input_set_capability(input, EV_MSC, MSC_SCAN);
+	if (msc_timestamp)
+		input_set_capability(input, EV_MSC, MSC_TIMESTAMP);
+	input_set_capability(input, EV_KEY, KEY_VOLUMEDOWN);
+	input_set_capability(input, EV_KEY, KEY_VOLUMEUP);
+	/* No EV_REP: the driver repeats the keys itself */
 
 	ret = input_register_device(input);
 	if (ret) {
 		input_free_device(input);
-		return ret;
+		return ERR_PTR(ret);
 	}
+	return input;
+}
 
-	gigabyte_kbd_input_dev = input;
+/* Called with gigabyte_kbd_config_lock held */
+static int gigabyte_kbd_setup_input_dev(struct hid_device *hdev)
+{
+	struct input_id id = {
+		.bustype = BUS_USB,
+		.vendor = hdev->vendor,
+		.product = hdev->product,
+		.version = hdev->version,
+	};
+	struct input_dev *input, *consumer;
+
+	if (rcu_access_pointer(gigabyte_kbd_input_dev)) {
+		gigabyte_kbd_refcount++;
+		return 0;
+	}
+
+	input = gigabyte_kbd_create_input_dev(&hdev->dev, &id,
+					      gigabyte_kbd_config->profile.keymap);
+	if (IS_ERR(input))
+		return PTR_ERR(input);
+
+	consumer = gigabyte_kbd_create_consumer_dev(&hdev->dev, &id);
+	if (IS_ERR(consumer)) {
+		input_unregister_device(input);
+		return PTR_ERR(consumer);
+	}
+
+	rcu_assign_pointer(gigabyte_kbd_consumer_dev, consumer);
+	rcu_assign_pointer(gigabyte_kbd_input_dev, input);
 	gigabyte_kbd_refcount = 1;
 	return 0;
 }
 
+/* Find the hardware the profile has; called with gigabyte_kbd_config_lock held */
+static void gigabyte_kbd_lookup_hardware(const struct gigabyte_kbd_config *cfg)
+{
+	const struct gigabyte_kbd_profile *profile = &cfg->profile;
+
+	/* Once for all interfaces */
+	if ((profile->caps & GIGABYTE_KBD_CAP_BACKLIGHT) && !gigabyte_kbd_backlight_device)
+		gigabyte_kbd_backlight_device = backlight_device_get_by_name(profile->backlight);
+
+	if (profile->caps & GIGABYTE_KBD_CAP_TOUCHPAD)
+		gigabyte_kbd_touchpad_lookup(cfg);
+}
+
+static void gigabyte_kbd_config_loaded(const struct firmware *fw, void *context)
+{
+	struct hid_device *hdev = context;
+	struct gigabyte_kbd_config *cfg, *old;
+	struct input_dev *input, *stale = NULL;
+
+	if (!fw) {
+		hid_dbg(hdev, "%s not found, using built-in tables\n", config);
+		return;
+	}
+
+	cfg = gigabyte_kbd_config_parse(fw->data, fw->size);
+	release_firmware(fw);
+	if (IS_ERR(cfg)) {
+		hid_warn(hdev, "Ignoring invalid %s: %ld\n", config, PTR_ERR(cfg));
+		return;
+	}
+
+	mutex_lock(&gigabyte_kbd_config_lock);
+	old = gigabyte_kbd_config;
+	gigabyte_kbd_config = cfg;
+
+	/* Only new scancodes need a new device; see gigabyte_kbd_keymap_update() */
+	input = rcu_dereference_protected(gigabyte_kbd_input_dev,
+					  lockdep_is_held(&gigabyte_kbd_config_lock));
+	if (input && !gigabyte_kbd_keymap_update(input, cfg->profile.keymap,
+						 old->profile.keymap)) {
+		hid_info(hdev, "%s adds Fn keys, recreating the input device\n", config);
+		stale = input;
+		input = gigabyte_kbd_create_input_dev(stale->dev.parent, &stale->id,
+						      cfg->profile.keymap);
+		if (IS_ERR(input)) {
+			hid_warn(hdev, "Failed to apply %s keymap: %ld\n", config, PTR_ERR(input));
+			stale = NULL;
+		} else {
+			rcu_assign_pointer(gigabyte_kbd_input_dev, input);
+		}
+	}
+
+	if (gigabyte_kbd_refcount)
+		gigabyte_kbd_lookup_hardware(cfg);
+	mutex_unlock(&gigabyte_kbd_config_lock);
+
+	if (stale) {
+		synchronize_rcu();
+		input_unregister_device(stale);
+	}
+	gigabyte_kbd_config_free(old);
+	hid_info(hdev, "Loaded %s, using %s profile\n", config, cfg->profile.name);
+}
+
+#define GIGABYTE_KBD_UP_VENDOR		0xff000000	/* Start of the vendor usage pages */
+
+/*
+ * True if the interface carries the vendor Fn report and nothing else:
+ * its application collections are all on vendor-defined usage pages,
+ * report 4 is its only input report, and it has no output or feature
+ * report a userspace tool could want through hidraw.
+ */
+static bool gigabyte_kbd_fn_only(struct hid_device *hdev)
+{
+	struct hid_report_enum *input = &hdev->report_enum[HID_INPUT_REPORT];
+	struct hid_report *report;
+	unsigned int i, apps = 0;
+
+	for (i = 0; i < hdev->maxcollection; i++) {
+		if (hdev->collection[i].type != HID_COLLECTION_APPLICATION)
+			continue;
+		if ((hdev->collection[i].usage & HID_USAGE_PAGE) < GIGABYTE_KBD_UP_VENDOR)
+			return false;
+		apps++;
+	}
+	if (!apps || !input->report_id_hash[4] ||
+	    !list_empty(&hdev->report_enum[HID_OUTPUT_REPORT].report_list) ||
+	    !list_empty(&hdev->report_enum[HID_FEATURE_REPORT].report_list))
+		return false;
+
+	list_for_each_entry(report, &input->report_list, list) {
+		if (report->id != 4)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Which hidraw, hiddev and input nodes to create on this interface.
+ * Interfaces carrying only the vendor Fn report need no input node:
+ * raw_event sees the reports either way. They keep hidraw unless the
+ * model's profile leaves it out.
+ */
+static unsigned int gigabyte_kbd_connect_mask(struct hid_device *hdev,
+					      struct gigabyte_kbd_data *priv)
+{
+	const struct gigabyte_kbd_profile *profile;
+	unsigned int mask;
+
+	if (!minimal_nodes)
+		return HID_CONNECT_DEFAULT;
+
+	mutex_lock(&gigabyte_kbd_config_lock);
+	profile = &gigabyte_kbd_config->profile;
+	priv->ignore_apps = profile->ignore_apps;
+	mask = gigabyte_kbd_fn_only(hdev) ? profile->vendor_connect : profile->connect;
+	mutex_unlock(&gigabyte_kbd_config_lock);
+
+	return mask;
+}
+
+static int gigabyte_kbd_input_mapping(struct hid_device *hdev, struct hid_input *hi,
+				      struct hid_field *field, struct hid_usage *usage,
+				      unsigned long **bit, int *max)
+{
+	struct gigabyte_kbd_data *priv = hid_get_drvdata(hdev);
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(gigabyte_kbd_app_usages); i++) {
+		if ((priv->ignore_apps & BIT(i)) &&
+		    field->application == gigabyte_kbd_app_usages[i])
+			return -1;
+	}
+	return 0;
+}
+
+/* 1 on, 0 off after Fn+F10 or the power policy; pollable, see gigabyte_kbd_notify() */
+static ssize_t touchpad_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	int on;
+
+	mutex_lock(&gigabyte_kbd_touchpad_lock);
+	on = gigabyte_kbd_touchpad_device ? !gigabyte_kbd_touchpad_is_off() : -ENODEV;
+	mutex_unlock(&gigabyte_kbd_touchpad_lock);
+
+	return on < 0 ? on : sysfs_emit(buf, "%d\n", on);
+}
+static DEVICE_ATTR_RO(touchpad);
+
+static struct attribute *gigabyte_kbd_attrs[] = {
+	&dev_attr_touchpad.attr,
+	NULL
+};
+ATTRIBUTE_GROUPS(gigabyte_kbd);
+
 static int gigabyte_kbd_probe(struct hid_device *hdev,
 			      const struct hid_device_id *id)
 {
 	struct gigabyte_kbd_data *priv;
-	struct hid_input *hi;
+	unsigned int connect;
 	int ret;
 
 	priv = devm_kzalloc(&hdev->dev, sizeof(*priv), GFP_KERNEL);
@@ -286,75 +1463,146 @@ static int gigabyte_kbd_probe(struct hid_device *hdev,
 	if (ret)
 		return ret;
 
-	ret = hid_hw_start(hdev, HID_CONNECT_DEFAULT);
+	connect = gigabyte_kbd_connect_mask(hdev, priv);
+	ret = hid_hw_start(hdev, connect);
 	if (ret)
 		return ret;
+	hid_dbg(hdev, "connect mask %#x\n", connect);
 
-	/* Find Consumer Control device for volume key injection */
-	if (!gigabyte_kbd_consumer_dev) {
-		list_for_each_entry(hi, &hdev->inputs, list) {
-			if (hi->input->name &&
-			    strstr(hi->input->name, "Consumer Control")) {
-				gigabyte_kbd_consumer_dev = hi->input;
-				set_bit(KEY_VOLUMEDOWN, hi->input->keybit);
-				set_bit(KEY_VOLUMEUP, hi->input->keybit);
-				break;
-			}
+	/* Without an input device nothing opens the interface for us */
+	if (!(hdev->claimed & HID_CLAIMED_INPUT)) {
+		ret = hid_hw_open(hdev);
+		if (ret) {
+			hid_hw_stop(hdev);
+			return ret;
 		}
+		priv->opened = true;
 	}
 
+	mutex_lock(&gigabyte_kbd_config_lock);
+
 	/* Create input device for Fn key events */
 	ret = gigabyte_kbd_setup_input_dev(hdev);
 	if (ret)
 		hid_warn(hdev, "Failed to create Fn Keys input device\n");
 
-	/* Find backlight device */
-	gigabyte_kbd_backlight_device =
-		backlight_device_get_by_name(GIGABYTE_KBD_BACKLIGHT_DEVICE_NAME);
+	gigabyte_kbd_lookup_hardware(gigabyte_kbd_config);
 	priv->backlight = gigabyte_kbd_backlight_device;
 
-	/* Find touchpad device */
-	gigabyte_kbd_touchpad_device =
-		bus_find_device(&i2c_bus_type, NULL, NULL,
-				gigabyte_kbd_match_touchpad_device);
-	priv->touchpad_device = gigabyte_kbd_touchpad_device;
+	/* So the backlight is back before gigabyte_kbd_restore() compares it */
+	if (priv->backlight) {
+		priv->backlight_link = device_link_add(&hdev->dev, &priv->backlight->dev,
+						       DL_FLAG_STATELESS);
+		if (!priv->backlight_link)
+			hid_dbg(hdev, "No device link to the backlight\n");
+	}
 
-	if (gigabyte_kbd_touchpad_device) {
-		gigabyte_kbd_touchpad_driver = gigabyte_kbd_touchpad_device->driver;
-		priv->touchpad_driver = gigabyte_kbd_touchpad_driver;
+	/* The built-in tables are used until the config arrives, if it does */
+	if (!gigabyte_kbd_config_requested && *config) {
+		gigabyte_kbd_config_requested = true;
+		ret = request_firmware_nowait(THIS_MODULE, FW_ACTION_UEVENT, config,
+					      &hdev->dev, GFP_KERNEL, hdev,
+					      gigabyte_kbd_config_loaded);
+		if (ret)
+			hid_warn(hdev, "Failed to request %s: %d\n", config, ret);
 	}
 
+	mutex_unlock(&gigabyte_kbd_config_lock);
+
 	return 0;
 }
 
 static void gigabyte_kbd_remove(struct hid_device *hdev)
 {
+	struct gigabyte_kbd_data *priv = hid_get_drvdata(hdev);
+	struct input_dev *input = NULL, *consumer = NULL;
+
+	if (priv->opened)
+		hid_hw_close(hdev);
 	hid_hw_stop(hdev);
+	if (priv->backlight_link)
+		device_link_del(priv->backlight_link);
 
-	if (gigabyte_kbd_refcount > 0) {
-		gigabyte_kbd_refcount--;
-		if (gigabyte_kbd_refcount == 0 && gigabyte_kbd_input_dev) {
-			input_unregister_device(gigabyte_kbd_input_dev);
-			gigabyte_kbd_input_dev = NULL;
-		}
+	mutex_lock(&gigabyte_kbd_config_lock);
+	if (gigabyte_kbd_refcount > 0 && --gigabyte_kbd_refcount == 0) {
+		cancel_work_sync(&gigabyte_kbd_touchpad_toggle_driver_work);
+		hrtimer_cancel(&gigabyte_kbd_volume_timer);
+		gigabyte_kbd_touchpad_restore();
+		input = rcu_replace_pointer(gigabyte_kbd_input_dev, NULL,
+					    lockdep_is_held(&gigabyte_kbd_config_lock));
+		consumer = rcu_replace_pointer(gigabyte_kbd_consumer_dev, NULL,
+					       lockdep_is_held(&gigabyte_kbd_config_lock));
+	}
+	mutex_unlock(&gigabyte_kbd_config_lock);
+
+	if (input) {
+		synchronize_rcu();
+		input_unregister_device(input);
+		input_unregister_device(consumer);
 	}
 }
 
+#ifdef CONFIG_PM
+static int gigabyte_kbd_suspend(struct hid_device *hdev, pm_message_t message)
+{
+	struct gigabyte_kbd_data *priv = hid_get_drvdata(hdev);
+
+	/* Let a pending Fn+F6 land so the saved state is the one the user chose */
+	flush_work(&gigabyte_kbd_backlight_toggle_work);
+
+	/* The release may never come if the keys are held into suspend */
+	hrtimer_cancel(&gigabyte_kbd_volume_timer);
+
+	if (priv->backlight)
+		priv->backlight_power = priv->backlight->props.power;
+
+	priv->pm_saved = true;
+	return 0;
+}
+
+/*
+ * Put back what the firmware or other drivers may have changed while we
+ * slept, using the devices cached at probe. Only state that differs from
+ * the snapshot is touched.
+ */
+static int gigabyte_kbd_restore(struct hid_device *hdev, bool reset)
+{
+	struct gigabyte_kbd_data *priv = hid_get_drvdata(hdev);
+	ktime_t start = ktime_get();
+	unsigned int restored = 0;
+
+	if (!priv->pm_saved)
+		return 0;
+	priv->pm_saved = false;
+
+	if (priv->backlight && priv->backlight->props.power != priv->backlight_power) {
+		if (priv->backlight_power == FB_BLANK_POWERDOWN)
+			backlight_disable(priv->backlight);
+		else
+			backlight_enable(priv->backlight);
+		gigabyte_kbd_backlight_notify(priv->backlight);
+		restored |= GIGABYTE_KBD_RESTORED_BACKLIGHT;
+	}
+
+	trace_gigabytekbd_resume(hdev, reset, restored, ktime_to_ns(ktime_sub(ktime_get(), start)));
+	return 0;
+}
+
+static int gigabyte_kbd_resume(struct hid_device *hdev)
+{
+	return gigabyte_kbd_restore(hdev, false);
+}
+
+static int gigabyte_kbd_reset_resume(struct hid_device *hdev)
+{
+	return gigabyte_kbd_restore(hdev, true);
+}
+#endif
+
+#define GIGABYTE_KBD_HID_DEVICE(vendor, product)	{ HID_USB_DEVICE(vendor, product) },
+
 static const struct hid_device_id gigabyte_kbd_devices[] = {
-	{ HID_USB_DEVICE(USB_VENDOR_ID_GIGABYTE_AERO15XV8,
-			 USB_DEVICE_ID_GIGABYTE_AERO15XV8) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_GIGABYTE_AERO15SA,
-			 USB_DEVICE_ID_GIGABYTE_AERO15SA) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_GIGABYTE_AORUS15P,
-			 USB_DEVICE_ID_GIGABYTE_AORUS15P) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_GIGABYTE_AORUS15G,
-			 USB_DEVICE_ID_GIGABYTE_AORUS15G) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_GIGABYTE_AORUS16X,
-			 USB_DEVICE_ID_GIGABYTE_AORUS16X) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_GIGABYTE_AORUS15_9KF_1,
-			 USB_DEVICE_ID_GIGABYTE_AORUS15_9KF_1) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_GIGABYTE_AORUS15_9KF_2,
-			 USB_DEVICE_ID_GIGABYTE_AORUS15_9KF_2) },
+	GIGABYTE_KBD_USB_DEVICES(GIGABYTE_KBD_HID_DEVICE)
 	{ }
 };
 MODULE_DEVICE_TABLE(hid, gigabyte_kbd_devices);
@@ -365,5 +1613,140 @@ static struct hid_driver gigabyte_kbd_driver = {
 	.probe = gigabyte_kbd_probe,
 	.remove = gigabyte_kbd_remove,
 	.raw_event = gigabyte_kbd_raw_event,
+	.input_mapping = gigabyte_kbd_input_mapping,
+	.driver = {
+		.dev_groups = gigabyte_kbd_groups,
+	},
+#ifdef CONFIG_PM
+	.suspend = gigabyte_kbd_suspend,
+	.resume = gigabyte_kbd_resume,
+	.reset_resume = gigabyte_kbd_reset_resume,
+#endif
 };
-module_hid_driver(gigabyte_kbd_driver);
+
+/*
+ * Per power source policy, applied once when gigabytecore reports a
+ * switch between AC and battery. Negative values leave that setting
+ * alone, which is the default for all of them. Only global state is
+ * touched, never a bound interface's, so an interface going away while
+ * the policy applies is of no concern. The touchpad is turned off and on
+ * the same way as by Fn+F10.
+ */
+static int ac_backlight = -1;
+module_param(ac_backlight, int, 0644);
+MODULE_PARM_DESC(ac_backlight, "Backlight brightness in percent on AC, -1 leaves it (default: -1)");
+
+static int battery_backlight = -1;
+module_param(battery_backlight, int, 0644);
+MODULE_PARM_DESC(battery_backlight, "Backlight brightness in percent on battery, -1 leaves it (default: -1)");
+
+static int ac_touchpad = -1;
+module_param(ac_touchpad, int, 0644);
+MODULE_PARM_DESC(ac_touchpad, "Touchpad power on AC: 0 off, 1 on, -1 leaves it (default: -1)");
+
+static int battery_touchpad = -1;
+module_param(battery_touchpad, int, 0644);
+MODULE_PARM_DESC(battery_touchpad, "Touchpad power on battery: 0 off, 1 on, -1 leaves it (default: -1)");
+
+static void gigabyte_kbd_power_apply_touchpad(bool on)
+{
+	bool was_off, changed;
+	int err;
+
+	mutex_lock(&gigabyte_kbd_touchpad_lock);
+	was_off = gigabyte_kbd_touchpad_is_off();
+	err = gigabyte_kbd_touchpad_set(on);
+	if (err)
+		dev_warn(gigabyte_kbd_touchpad_device, "touchpad power policy failed: %d\n", err);
+	changed = gigabyte_kbd_touchpad_is_off() != was_off;
+	mutex_unlock(&gigabyte_kbd_touchpad_lock);
+
+	if (changed)
+		gigabyte_kbd_notify("touchpad");
+}
+
+static int gigabyte_kbd_power_notify(struct notifier_block *nb,
+				     unsigned long source, void *data)
+{
+	bool battery = source == GIGABYTE_CORE_POWER_BATTERY;
+	int level = battery ? battery_backlight : ac_backlight;
+	int touchpad = battery ? battery_touchpad : ac_touchpad;
+	struct backlight_device *bd = gigabyte_kbd_backlight_device;
+	unsigned int caps;
+
+	mutex_lock(&gigabyte_kbd_config_lock);
+	caps = gigabyte_kbd_config->profile.caps;
+	mutex_unlock(&gigabyte_kbd_config_lock);
+
+	if (level >= 0 && bd)
+		backlight_device_set_brightness(bd, DIV_ROUND_CLOSEST(bd->props.max_brightness *
+								     min(level, 100), 100));
+
+	if (touchpad >= 0 && (caps & GIGABYTE_KBD_CAP_TOUCHPAD))
+		gigabyte_kbd_power_apply_touchpad(touchpad);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block gigabyte_kbd_power_nb = {
+	.notifier_call = gigabyte_kbd_power_notify,
+};
+
+static int __init gigabyte_kbd_init(void)
+{
+	const struct dmi_system_id *dmi;
+	int ret;
+
+	dmi = dmi_first_match(gigabyte_kbd_dmi_table);
+	gigabyte_kbd_builtin_config.profile = dmi ?
+		*(const struct gigabyte_kbd_profile *)dmi->driver_data :
+		gigabyte_kbd_profile_generic;
+	pr_debug("gigabytekbd: using %s profile\n", gigabyte_kbd_builtin_config.profile.name);
+
+	gigabyte_kbd_capture_init();
+	gigabyte_kbd_volume_init();
+	register_pm_notifier(&gigabyte_kbd_pm_nb);
+
+	ret = bus_register_notifier(&i2c_bus_type, &gigabyte_kbd_i2c_nb);
+	if (ret)
+		goto err_pm;
+
+	ret = hid_register_driver(&gigabyte_kbd_driver);
+	if (ret)
+		goto err_i2c;
+
+	/* After the driver, so the current source applies to bound keyboards */
+	ret = gigabyte_core_power_register(&gigabyte_kbd_power_nb);
+	if (ret)
+		goto err_driver;
+	return 0;
+
+err_driver:
+	hid_unregister_driver(&gigabyte_kbd_driver);
+err_i2c:
+	bus_unregister_notifier(&i2c_bus_type, &gigabyte_kbd_i2c_nb);
+err_pm:
+	unregister_pm_notifier(&gigabyte_kbd_pm_nb);
+	gigabyte_kbd_capture_exit();
+	return ret;
+}
+
+static void __exit gigabyte_kbd_exit(void)
+{
+	gigabyte_core_power_unregister(&gigabyte_kbd_power_nb);
+	unregister_pm_notifier(&gigabyte_kbd_pm_nb);
+	cancel_work_sync(&gigabyte_kbd_touchpad_pm_work);
+	hid_unregister_driver(&gigabyte_kbd_driver);
+	bus_unregister_notifier(&i2c_bus_type, &gigabyte_kbd_i2c_nb);
+	gigabyte_kbd_capture_exit();
+
+	if (gigabyte_kbd_touchpad_device)
+		gigabyte_kbd_touchpad_detach();
+	acpi_dev_put(gigabyte_kbd_touchpad_adev);
+	if (gigabyte_kbd_backlight_device)
+		put_device(&gigabyte_kbd_backlight_device->dev);
+	gigabyte_kbd_config_free(gigabyte_kbd_config);
+}
+
+module_init(gigabyte_kbd_init);
+module_exit(gigabyte_kbd_exit);
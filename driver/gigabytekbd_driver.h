@@ -2,27 +2,13 @@
 #ifndef __HID_GIGABYTE_KBD_H
 #define __HID_GIGABYTE_KBD_H
 
-/* Gigabyte laptop USB VID/PID pairs */
-#define USB_VENDOR_ID_GIGABYTE_AERO15XV8	0x1044
-#define USB_DEVICE_ID_GIGABYTE_AERO15XV8	0x7A39
+#include <linux/types.h>
 
-#define USB_VENDOR_ID_GIGABYTE_AERO15SA		0x1044
-#define USB_DEVICE_ID_GIGABYTE_AERO15SA		0x7A3F
+/* Device tables, generated from config/devices.json */
+#include "gigabytekbd_devices.h"
 
-#define USB_VENDOR_ID_GIGABYTE_AORUS15P		0x1044
-#define USB_DEVICE_ID_GIGABYTE_AORUS15P		0x7A3B
-
-#define USB_VENDOR_ID_GIGABYTE_AORUS15G		0x1044
-#define USB_DEVICE_ID_GIGABYTE_AORUS15G		0x7A3C
-
-#define USB_VENDOR_ID_GIGABYTE_AORUS16X		0x0414
-#define USB_DEVICE_ID_GIGABYTE_AORUS16X		0x8005
-
-#define USB_VENDOR_ID_GIGABYTE_AORUS15_9KF_1	0x0414
-#define USB_DEVICE_ID_GIGABYTE_AORUS15_9KF_1	0x7a43
-
-#define USB_VENDOR_ID_GIGABYTE_AORUS15_9KF_2	0x0414
-#define USB_DEVICE_ID_GIGABYTE_AORUS15_9KF_2	0x7a44
+/* Set in the press code of keys that report press and release separately */
+#define HIDRAW_FN_PRESS_FLAG	0x00000100
 
 /* Backlight device name in /sys/class/backlight/ */
 #define GIGABYTE_KBD_BACKLIGHT_DEVICE_NAME	"intel_backlight"
@@ -34,12 +20,11 @@ struct gigabyte_kbd_touchpad_device_identifier {
 	int instance_no;
 };
 
+#define GIGABYTE_KBD_TOUCHPAD_ENTRY(hid, bid, instance_no)	{ hid, bid, instance_no },
+
 static const struct gigabyte_kbd_touchpad_device_identifier
 gigabyte_kbd_touchpad_device_identifiers[] = {
-	{ "PNP0C50",  "TPD0", 1 },	/* Aero 15P and similar */
-	{ "ELAN0A02", "TPD0", 0 },	/* Aorus 17X and similar */
-	{ "ELAN0A03", "TPD0", 1 },	/* Aorus 15 9KF */
-	{ "ELAN0A04", "TPD0", 0 },	/* Aorus 16X and similar */
+	GIGABYTE_KBD_TOUCHPADS(GIGABYTE_KBD_TOUCHPAD_ENTRY)
 };
 
 #endif /* __HID_GIGABYTE_KBD_H */
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gigabytekbd
+
+#if !defined(__HID_GIGABYTE_KBD_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __HID_GIGABYTE_KBD_TRACE_H
+
+#include <linux/hid.h>
+#include <linux/tracepoint.h>
+
+/*
+ * Time spent restoring driver state on resume, for finding what the
+ * driver adds to lid-open latency:
+ *
+ *   echo 1 > /sys/kernel/tracing/events/gigabytekbd/gigabytekbd_resume/enable
+ */
+TRACE_EVENT(gigabytekbd_resume,
+	TP_PROTO(struct hid_device *hdev, bool reset, unsigned int restored, u64 duration_ns),
+	TP_ARGS(hdev, reset, restored, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(u16, vendor)
+		__field(u16, product)
+		__field(bool, reset)
+		__field(unsigned int, restored)
+		__field(u64, duration_ns)
+	),
+
+	TP_fast_assign(
+		__entry->vendor = hdev->vendor;
+		__entry->product = hdev->product;
+		__entry->reset = reset;
+		__entry->restored = restored;
+		__entry->duration_ns = duration_ns;
+	),
+
+	TP_printk("%04x:%04x reset=%d restored=%#x duration=%llu ns",
+		  __entry->vendor, __entry->product, __entry->reset, __entry->restored,
+		  __entry->duration_ns)
+);
+
+#endif /* __HID_GIGABYTE_KBD_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE gigabytekbd_trace
+#include <trace/define_trace.h>
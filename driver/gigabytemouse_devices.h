@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Generated from config/devices.json by tools/gen-devices.py, do not edit. */
+#ifndef __HID_GIGABYTE_MOUSE_DEVICES_H
+#define __HID_GIGABYTE_MOUSE_DEVICES_H
+
+/* Gigabyte mouse USB VID/PID pairs */
+/*
+ * Mice handled by gigabytemouse, as X(vendor, product, name, max poll
+ * rate in Hz, min DPI, max DPI, DPI step, DPI stages).
+ */
+#define GIGABYTE_MOUSE_MODELS(X)
+
+#endif /* __HID_GIGABYTE_MOUSE_DEVICES_H */
@@ -0,0 +1,796 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * HID driver for Gigabyte Mice
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Experimental: none of the reports below has been captured from a real
+ * mouse, so no mouse is listed and it is not built by default.
+ *
+ * Exposes the settings the mouse keeps in a feature report in sysfs:
+ *   - poll_rate: report rate in Hz, one of poll_rates
+ *   - dpi_stages: DPI of each stage, within dpi_range
+ *   - dpi_stage: the active stage
+ *   - lift_off_distance: in mm
+ *   - profile: the onboard profile memory, read once and cached; the
+ *     image size and chunk format are a guess, not read off a mouse
+ * Input reports go through hid-input untouched. Writes go through the
+ * gigabytecore queue, so a store returns without waiting for the mouse.
+ */
+
+#include <linux/hid.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/usb.h>
+#include <linux/version.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include "gigabytecore.h"
+#include "gigabytemouse_driver.h"
+
+MODULE_AUTHOR("Hemanth Bollamreddi <blmhemu@gmail.com>");
+MODULE_DESCRIPTION("HID driver for Gigabyte Mice.");
+MODULE_LICENSE("GPL v2");
+
+static const unsigned int gigabyte_mouse_poll_rates[] = {
+	125, 250, 500, 1000, 2000, 4000, 8000
+};
+
+/* Limits of a mouse model */
+struct gigabyte_mouse_model {
+	const char *name;
+	unsigned int max_rate;		/* Hz */
+	unsigned int dpi_min;
+	unsigned int dpi_max;
+	unsigned int dpi_step;
+	unsigned int stages;		/* At most GIGABYTE_MOUSE_MAX_STAGES */
+};
+
+/* Mice bound through new_id, which have no table entry */
+static const struct gigabyte_mouse_model gigabyte_mouse_generic = {
+	.name = "generic",
+	.max_rate = 1000,
+	.dpi_min = 100,
+	.dpi_max = 16000,
+	.dpi_step = 50,
+	.stages = 5,
+};
+
+/* Known models, see config/devices.json */
+#define GIGABYTE_MOUSE_MODEL(vendor, product, _name, _max_rate, _dpi_min,	\
+			     _dpi_max, _dpi_step, _stages)			\
+	static const struct gigabyte_mouse_model gigabyte_mouse_##product = {	\
+		.name = _name,							\
+		.max_rate = _max_rate,						\
+		.dpi_min = _dpi_min,						\
+		.dpi_max = _dpi_max,						\
+		.dpi_step = _dpi_step,						\
+		.stages = _stages,						\
+	};
+
+GIGABYTE_MOUSE_MODELS(GIGABYTE_MOUSE_MODEL)
+
+/*
+ * Queue keys: a settings write supersedes any older one still waiting,
+ * profile writes each cover different bytes and all go out
+ */
+#define GIGABYTE_MOUSE_KEY_SETTINGS	1
+#define GIGABYTE_MOUSE_KEY_PROFILE	GIGABYTE_CORE_KEY_NONE
+
+/* profile_state while the image is being read; 0 once read, or an error */
+#define GIGABYTE_MOUSE_PROFILE_LOADING	1
+
+/* Decoded struct gigabyte_mouse_settings_report */
+struct gigabyte_mouse_settings {
+	unsigned int poll_rate;
+	unsigned int lift_off;
+	unsigned int num_stages;
+	unsigned int active_stage;
+	unsigned int dpi[GIGABYTE_MOUSE_MAX_STAGES];
+};
+
+/* Driver private data */
+struct gigabyte_mouse_data {
+	struct hid_device *hdev;
+	const struct gigabyte_mouse_model *model;
+	unsigned int max_rate;		/* Lower of the model's and the endpoint's */
+	bool has_settings;
+	struct gigabyte_core_queue *queue;
+
+	struct mutex lock;		/* Serializes settings reads and writes */
+	struct gigabyte_mouse_settings settings;	/* As last read or queued */
+	struct gigabyte_mouse_settings_report report;	/* Same, unknown bytes kept */
+
+	bool has_profile;
+	struct mutex profile_lock;	/* Protects the fields below */
+	u8 *profile;			/* Image as last read or queued */
+	int profile_state;
+	bool removing;			/* No more loads */
+	wait_queue_head_t profile_wait;
+	struct work_struct profile_work;
+};
+
+/*
+ * Fastest rate the host polls the interface at. The mouse can't usefully
+ * report faster than that, whatever it supports.
+ */
+static unsigned int gigabyte_mouse_host_rate(struct hid_device *hdev)
+{
+	struct usb_endpoint_descriptor *ep;
+	struct usb_interface *intf;
+	unsigned int interval;
+
+	if (!hid_is_usb(hdev))
+		return UINT_MAX;
+
+	intf = to_usb_interface(hdev->dev.parent);
+	if (usb_find_int_in_endpoint(intf->cur_altsetting, &ep) || !ep->bInterval)
+		return UINT_MAX;
+
+	/* Full and low speed count in frames, faster buses in 2^(n-1) microframes */
+	interval = ep->bInterval;
+	if (interface_to_usbdev(intf)->speed >= USB_SPEED_HIGH)
+		return 8000 >> min(interval - 1, 15U);
+	return 1000 / interval;
+}
+
+static bool gigabyte_mouse_rate_ok(struct gigabyte_mouse_data *priv, unsigned int rate)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(gigabyte_mouse_poll_rates); i++) {
+		if (gigabyte_mouse_poll_rates[i] == rate)
+			return rate <= priv->max_rate;
+	}
+	return false;
+}
+
+static bool gigabyte_mouse_dpi_ok(const struct gigabyte_mouse_model *model, unsigned int dpi)
+{
+	return dpi >= model->dpi_min && dpi <= model->dpi_max &&
+	       (dpi - model->dpi_min) % model->dpi_step == 0;
+}
+
+/* Called with priv->lock held */
+static int gigabyte_mouse_read(struct gigabyte_mouse_data *priv)
+{
+	const struct gigabyte_mouse_model *model = priv->model;
+	struct gigabyte_mouse_settings_report *rep;
+	struct gigabyte_mouse_settings s = { };
+	unsigned int i;
+	int ret;
+
+	/* hid_hw_raw_request() may DMA from the buffer */
+	rep = kzalloc(GIGABYTE_MOUSE_SETTINGS_SIZE, GFP_KERNEL);
+	if (!rep)
+		return -ENOMEM;
+
+	rep->report_id = GIGABYTE_MOUSE_SETTINGS_REPORT_ID;
+	ret = gigabyte_core_get_report(priv->queue, (u8 *)rep, GIGABYTE_MOUSE_SETTINGS_SIZE);
+	if (ret < 0)
+		goto out;
+	if (ret < GIGABYTE_MOUSE_SETTINGS_SIZE ||
+	    rep->report_id != GIGABYTE_MOUSE_SETTINGS_REPORT_ID ||
+	    !rep->num_stages || rep->num_stages > model->stages ||
+	    rep->active_stage >= rep->num_stages) {
+		ret = -EPROTO;
+		goto out;
+	}
+
+	s.poll_rate = le16_to_cpu(rep->poll_rate);
+	s.lift_off = rep->lift_off;
+	s.num_stages = rep->num_stages;
+	s.active_stage = rep->active_stage;
+	for (i = 0; i < s.num_stages; i++)
+		s.dpi[i] = le16_to_cpu(rep->dpi[i]);
+	priv->settings = s;
+	priv->report = *rep;
+	ret = 0;
+out:
+	kfree(rep);
+	return ret;
+}
+
+/*
+ * Called with priv->lock held. The cache moves on as soon as the write is
+ * queued; gigabyte_mouse_write_done() takes it back if the write is lost.
+ */
+static int gigabyte_mouse_write(struct gigabyte_mouse_data *priv,
+				const struct gigabyte_mouse_settings *s)
+{
+	/* The queue copies it into its own transfer buffer */
+	struct gigabyte_mouse_settings_report rep = priv->report;
+	unsigned int i;
+	int ret;
+
+	rep.lift_off = s->lift_off;
+	rep.poll_rate = cpu_to_le16(s->poll_rate);
+	rep.num_stages = s->num_stages;
+	rep.active_stage = s->active_stage;
+	for (i = 0; i < s->num_stages; i++)
+		rep.dpi[i] = cpu_to_le16(s->dpi[i]);
+
+	ret = gigabyte_core_set_report(priv->queue, GIGABYTE_MOUSE_KEY_SETTINGS, (u8 *)&rep,
+				       GIGABYTE_MOUSE_SETTINGS_SIZE);
+	if (ret)
+		return ret;
+
+	priv->settings = *s;
+	priv->report = rep;
+	return 0;
+}
+
+/* Called with priv->profile_lock held */
+static void gigabyte_mouse_profile_reload(struct gigabyte_mouse_data *priv)
+{
+	if (priv->removing || priv->profile_state == GIGABYTE_MOUSE_PROFILE_LOADING)
+		return;
+	priv->profile_state = GIGABYTE_MOUSE_PROFILE_LOADING;
+	schedule_work(&priv->profile_work);
+}
+
+/* Called from the queue worker once a write is sent or dropped */
+static void gigabyte_mouse_write_done(void *ctx, u32 key, int err)
+{
+	struct gigabyte_mouse_data *priv = ctx;
+
+	if (!err)
+		return;
+
+	if (key == GIGABYTE_MOUSE_KEY_PROFILE) {
+		hid_warn(priv->hdev, "Failed to write mouse profile: %d\n", err);
+		/* The cache is ahead of the mouse somewhere, read it all again */
+		mutex_lock(&priv->profile_lock);
+		gigabyte_mouse_profile_reload(priv);
+		mutex_unlock(&priv->profile_lock);
+		return;
+	}
+
+	hid_warn(priv->hdev, "Failed to write mouse settings: %d\n", err);
+
+	/*
+	 * Stores queue under priv->lock, so with it held and nothing waiting
+	 * no newer write can still fix up what the mouse has.
+	 */
+	mutex_lock(&priv->lock);
+	if (!gigabyte_core_depth(priv->queue) && gigabyte_mouse_read(priv))
+		hid_warn(priv->hdev, "Mouse settings out of sync\n");
+	mutex_unlock(&priv->lock);
+}
+
+static const struct gigabyte_core_ops gigabyte_mouse_core_ops = {
+	.done = gigabyte_mouse_write_done,
+};
+
+/*
+ * Read the whole profile image into the cache, one chunk per request.
+ * This is the only time the mouse is asked: profile reads are served
+ * from the cache.
+ */
+static void gigabyte_mouse_profile_load(struct work_struct *work)
+{
+	struct gigabyte_mouse_data *priv =
+		container_of(work, struct gigabyte_mouse_data, profile_work);
+	struct gigabyte_mouse_profile_report *rep;
+	ktime_t start = ktime_get();
+	unsigned int off, len;
+	int ret = 0;
+
+	/* Read back what the mouse has after the writes still on their way */
+	gigabyte_core_flush(priv->queue, 1000);
+
+	/* hid_hw_raw_request() may DMA from the buffer */
+	rep = kmalloc(GIGABYTE_MOUSE_PROFILE_REPORT_SIZE, GFP_KERNEL);
+	if (!rep)
+		ret = -ENOMEM;
+
+	/* Readers and writers wait for the load, so the image is ours until then */
+	for (off = 0; !ret && off < GIGABYTE_MOUSE_PROFILE_SIZE; off += len) {
+		len = min_t(unsigned int, GIGABYTE_MOUSE_PROFILE_CHUNK,
+			    GIGABYTE_MOUSE_PROFILE_SIZE - off);
+
+		memset(rep, 0, GIGABYTE_MOUSE_PROFILE_REPORT_SIZE);
+		rep->report_id = GIGABYTE_MOUSE_PROFILE_REPORT_ID;
+		rep->op = GIGABYTE_MOUSE_PROFILE_READ;
+		rep->offset = cpu_to_le16(off);
+		rep->len = len;
+		ret = gigabyte_core_transact(priv->queue, (u8 *)rep,
+					     GIGABYTE_MOUSE_PROFILE_REPORT_SIZE);
+		if (ret < 0)
+			break;
+		if (ret < GIGABYTE_MOUSE_PROFILE_REPORT_SIZE ||
+		    rep->op != GIGABYTE_MOUSE_PROFILE_READ ||
+		    le16_to_cpu(rep->offset) != off || rep->len != len) {
+			ret = -EPROTO;
+			break;
+		}
+		memcpy(priv->profile + off, rep->data, len);
+		ret = 0;
+	}
+	kfree(rep);
+
+	if (ret)
+		hid_warn(priv->hdev, "Failed to read mouse profile: %d\n", ret);
+	else
+		hid_dbg(priv->hdev, "Read mouse profile in %lld us\n",
+			ktime_us_delta(ktime_get(), start));
+
+	mutex_lock(&priv->profile_lock);
+	priv->profile_state = ret;
+	mutex_unlock(&priv->profile_lock);
+	wake_up_all(&priv->profile_wait);
+}
+
+/*
+ * Wait for the image and take priv->profile_lock. A load that failed is
+ * tried once more.
+ */
+static int gigabyte_mouse_profile_lock(struct gigabyte_mouse_data *priv)
+{
+	bool retried = false;
+	int ret;
+
+	for (;;) {
+		mutex_lock(&priv->profile_lock);
+		ret = priv->profile_state;
+		if (!ret)
+			return 0;
+		if (ret < 0) {
+			if (retried) {
+				mutex_unlock(&priv->profile_lock);
+				return ret;
+			}
+			gigabyte_mouse_profile_reload(priv);
+			retried = true;
+		}
+		mutex_unlock(&priv->profile_lock);
+
+		ret = wait_event_interruptible(priv->profile_wait,
+					       READ_ONCE(priv->profile_state) !=
+					       GIGABYTE_MOUSE_PROFILE_LOADING);
+		if (ret)
+			return ret;
+	}
+}
+
+/*
+ * Called with priv->profile_lock held. Queue the fewest writes that cover
+ * the bytes of buf that differ from the cache: every transfer costs a
+ * whole report, so each one takes all the changes within a chunk of its
+ * first.
+ */
+static int gigabyte_mouse_profile_write(struct gigabyte_mouse_data *priv, const u8 *buf,
+					unsigned int off, unsigned int count)
+{
+	struct gigabyte_mouse_profile_report rep = {
+		.report_id = GIGABYTE_MOUSE_PROFILE_REPORT_ID,
+		.op = GIGABYTE_MOUSE_PROFILE_WRITE,
+	};
+	unsigned int pos = off, end = off + count, start, last;
+	int ret;
+
+	while (pos < end) {
+		if (priv->profile[pos] == buf[pos - off]) {
+			pos++;
+			continue;
+		}
+
+		start = last = pos;
+		for (pos++; pos < end && pos < start + GIGABYTE_MOUSE_PROFILE_CHUNK; pos++) {
+			if (priv->profile[pos] != buf[pos - off])
+				last = pos;
+		}
+
+		rep.offset = cpu_to_le16(start);
+		rep.len = last - start + 1;
+		memset(rep.data, 0, sizeof(rep.data));
+		memcpy(rep.data, buf + start - off, rep.len);
+		ret = gigabyte_core_set_report(priv->queue, GIGABYTE_MOUSE_KEY_PROFILE,
+					       (u8 *)&rep, GIGABYTE_MOUSE_PROFILE_REPORT_SIZE);
+		if (ret)
+			return ret;
+
+		memcpy(priv->profile + start, rep.data, rep.len);
+		pos = last + 1;
+	}
+	return 0;
+}
+
+/* The bin_attribute argument went const in 6.13, under new names until 6.16 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+#define GIGABYTE_MOUSE_BIN_ATTR	const struct bin_attribute
+#else
+#define GIGABYTE_MOUSE_BIN_ATTR	struct bin_attribute
+#endif
+
+static ssize_t gigabyte_mouse_profile_read(struct file *file, struct kobject *kobj,
+					   GIGABYTE_MOUSE_BIN_ATTR *attr, char *buf,
+					   loff_t off, size_t count)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(kobj_to_dev(kobj));
+	int ret;
+
+	/* sysfs keeps off and count within the attribute's size */
+	ret = gigabyte_mouse_profile_lock(priv);
+	if (ret)
+		return ret;
+	memcpy(buf, priv->profile + off, count);
+	mutex_unlock(&priv->profile_lock);
+
+	return count;
+}
+
+static ssize_t gigabyte_mouse_profile_store(struct file *file, struct kobject *kobj,
+					    GIGABYTE_MOUSE_BIN_ATTR *attr, char *buf,
+					    loff_t off, size_t count)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(kobj_to_dev(kobj));
+	int ret;
+
+	ret = gigabyte_mouse_profile_lock(priv);
+	if (ret)
+		return ret;
+	ret = gigabyte_mouse_profile_write(priv, (const u8 *)buf, off, count);
+	mutex_unlock(&priv->profile_lock);
+
+	return ret ?: count;
+}
+
+static struct bin_attribute gigabyte_mouse_profile_attr = {
+	.attr = { .name = "profile", .mode = 0644 },
+	.size = GIGABYTE_MOUSE_PROFILE_SIZE,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0) && \
+    LINUX_VERSION_CODE < KERNEL_VERSION(6, 16, 0)
+	.read_new = gigabyte_mouse_profile_read,
+	.write_new = gigabyte_mouse_profile_store,
+#else
+	.read = gigabyte_mouse_profile_read,
+	.write = gigabyte_mouse_profile_store,
+#endif
+};
+
+static ssize_t poll_rate_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(dev);
+	unsigned int rate;
+
+	mutex_lock(&priv->lock);
+	rate = priv->settings.poll_rate;
+	mutex_unlock(&priv->lock);
+
+	return sysfs_emit(buf, "%u\n", rate);
+}
+
+static ssize_t poll_rate_store(struct device *dev, struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(dev);
+	struct gigabyte_mouse_settings s;
+	unsigned int rate;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &rate);
+	if (ret)
+		return ret;
+	if (!gigabyte_mouse_rate_ok(priv, rate))
+		return -EINVAL;
+
+	mutex_lock(&priv->lock);
+	s = priv->settings;
+	s.poll_rate = rate;
+	ret = gigabyte_mouse_write(priv, &s);
+	mutex_unlock(&priv->lock);
+
+	return ret ?: count;
+}
+static DEVICE_ATTR_RW(poll_rate);
+
+static ssize_t poll_rates_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(dev);
+	ssize_t len = 0;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(gigabyte_mouse_poll_rates); i++) {
+		if (gigabyte_mouse_poll_rates[i] <= priv->max_rate)
+			len += sysfs_emit_at(buf, len, "%s%u", len ? " " : "",
+					     gigabyte_mouse_poll_rates[i]);
+	}
+	return len + sysfs_emit_at(buf, len, "\n");
+}
+static DEVICE_ATTR_RO(poll_rates);
+
+static ssize_t dpi_stages_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(dev);
+	ssize_t len = 0;
+	unsigned int i;
+
+	mutex_lock(&priv->lock);
+	for (i = 0; i < priv->settings.num_stages; i++)
+		len += sysfs_emit_at(buf, len, "%s%u", i ? " " : "", priv->settings.dpi[i]);
+	mutex_unlock(&priv->lock);
+
+	return len + sysfs_emit_at(buf, len, "\n");
+}
+
+/* Space separated DPI values, one per stage */
+static ssize_t dpi_stages_store(struct device *dev, struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(dev);
+	const struct gigabyte_mouse_model *model = priv->model;
+	unsigned int dpi[GIGABYTE_MOUSE_MAX_STAGES];
+	struct gigabyte_mouse_settings s;
+	unsigned int n = 0;
+	char *copy, *cur, *tok;
+	int ret = 0;
+
+	copy = kstrdup(buf, GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+
+	cur = strim(copy);
+	while ((tok = strsep(&cur, " ")) && !ret) {
+		if (!*tok)
+			continue;
+		if (n == model->stages)
+			ret = -EINVAL;
+		else if (!kstrtouint(tok, 10, &dpi[n]) && gigabyte_mouse_dpi_ok(model, dpi[n]))
+			n++;
+		else
+			ret = -EINVAL;
+	}
+	kfree(copy);
+	if (ret)
+		return ret;
+	if (!n)
+		return -EINVAL;
+
+	mutex_lock(&priv->lock);
+	s = priv->settings;
+	memcpy(s.dpi, dpi, n * sizeof(dpi[0]));
+	s.num_stages = n;
+	if (s.active_stage >= n)
+		s.active_stage = n - 1;
+	ret = gigabyte_mouse_write(priv, &s);
+	mutex_unlock(&priv->lock);
+
+	return ret ?: count;
+}
+static DEVICE_ATTR_RW(dpi_stages);
+
+static ssize_t dpi_stage_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(dev);
+	unsigned int stage;
+
+	mutex_lock(&priv->lock);
+	stage = priv->settings.active_stage;
+	mutex_unlock(&priv->lock);
+
+	return sysfs_emit(buf, "%u\n", stage);
+}
+
+static ssize_t dpi_stage_store(struct device *dev, struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(dev);
+	struct gigabyte_mouse_settings s;
+	unsigned int stage;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &stage);
+	if (ret)
+		return ret;
+
+	mutex_lock(&priv->lock);
+	s = priv->settings;
+	if (stage < s.num_stages) {
+		s.active_stage = stage;
+		ret = gigabyte_mouse_write(priv, &s);
+	} else {
+		ret = -EINVAL;
+	}
+	mutex_unlock(&priv->lock);
+
+	return ret ?: count;
+}
+static DEVICE_ATTR_RW(dpi_stage);
+
+static ssize_t dpi_range_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(dev);
+	const struct gigabyte_mouse_model *model = priv->model;
+
+	return sysfs_emit(buf, "%u %u %u\n", model->dpi_min, model->dpi_max, model->dpi_step);
+}
+static DEVICE_ATTR_RO(dpi_range);
+
+static ssize_t lift_off_distance_show(struct device *dev, struct device_attribute *attr,
+				      char *buf)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(dev);
+	unsigned int lift_off;
+
+	mutex_lock(&priv->lock);
+	lift_off = priv->settings.lift_off;
+	mutex_unlock(&priv->lock);
+
+	return sysfs_emit(buf, "%u\n", lift_off);
+}
+
+static ssize_t lift_off_distance_store(struct device *dev, struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(dev);
+	struct gigabyte_mouse_settings s;
+	unsigned int lift_off;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &lift_off);
+	if (ret)
+		return ret;
+	if (lift_off < GIGABYTE_MOUSE_LIFT_OFF_MIN || lift_off > GIGABYTE_MOUSE_LIFT_OFF_MAX)
+		return -EINVAL;
+
+	mutex_lock(&priv->lock);
+	s = priv->settings;
+	s.lift_off = lift_off;
+	ret = gigabyte_mouse_write(priv, &s);
+	mutex_unlock(&priv->lock);
+
+	return ret ?: count;
+}
+static DEVICE_ATTR_RW(lift_off_distance);
+
+static struct attribute *gigabyte_mouse_attrs[] = {
+	&dev_attr_poll_rate.attr,
+	&dev_attr_poll_rates.attr,
+	&dev_attr_dpi_stages.attr,
+	&dev_attr_dpi_stage.attr,
+	&dev_attr_dpi_range.attr,
+	&dev_attr_lift_off_distance.attr,
+	NULL
+};
+
+/* Only the interface that has the settings report gets the attributes */
+static umode_t gigabyte_mouse_attr_visible(struct kobject *kobj, struct attribute *attr, int n)
+{
+	struct gigabyte_mouse_data *priv = dev_get_drvdata(kobj_to_dev(kobj));
+
+	return priv && priv->has_settings ? attr->mode : 0;
+}
+
+static const struct attribute_group gigabyte_mouse_group = {
+	.attrs = gigabyte_mouse_attrs,
+	.is_visible = gigabyte_mouse_attr_visible,
+};
+__ATTRIBUTE_GROUPS(gigabyte_mouse);
+
+static int gigabyte_mouse_probe(struct hid_device *hdev,
+				const struct hid_device_id *id)
+{
+	struct gigabyte_mouse_data *priv;
+	struct hid_report *report;
+	bool settings, profile;
+	int ret;
+
+	priv = devm_kzalloc(&hdev->dev, sizeof(*priv), GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+
+	priv->hdev = hdev;
+	priv->model = id->driver_data ? (const void *)id->driver_data : &gigabyte_mouse_generic;
+	mutex_init(&priv->lock);
+	mutex_init(&priv->profile_lock);
+	init_waitqueue_head(&priv->profile_wait);
+	INIT_WORK(&priv->profile_work, gigabyte_mouse_profile_load);
+	hid_set_drvdata(hdev, priv);
+
+	ret = hid_parse(hdev);
+	if (ret)
+		return ret;
+
+	ret = hid_hw_start(hdev, HID_CONNECT_DEFAULT);
+	if (ret)
+		return ret;
+
+	report = hdev->report_enum[HID_FEATURE_REPORT].report_id_hash[GIGABYTE_MOUSE_SETTINGS_REPORT_ID];
+	settings = report && hid_report_len(report) >= GIGABYTE_MOUSE_SETTINGS_SIZE;
+	report = hdev->report_enum[HID_FEATURE_REPORT].report_id_hash[GIGABYTE_MOUSE_PROFILE_REPORT_ID];
+	profile = report && hid_report_len(report) >= GIGABYTE_MOUSE_PROFILE_REPORT_SIZE;
+	if (!settings && !profile)
+		return 0;
+
+	priv->max_rate = min(priv->model->max_rate, gigabyte_mouse_host_rate(hdev));
+
+	priv->queue = gigabyte_core_queue_create(hdev, &gigabyte_mouse_core_ops, priv,
+						 max(GIGABYTE_MOUSE_SETTINGS_SIZE,
+						     GIGABYTE_MOUSE_PROFILE_REPORT_SIZE));
+	if (!priv->queue) {
+		hid_hw_stop(hdev);
+		return -ENOMEM;
+	}
+
+	if (profile) {
+		priv->profile = devm_kzalloc(&hdev->dev, GIGABYTE_MOUSE_PROFILE_SIZE, GFP_KERNEL);
+		if (!priv->profile) {
+			ret = -ENOMEM;
+			goto err_queue;
+		}
+
+		/* Read in the background: probe doesn't wait, the first reader does */
+		priv->profile_state = GIGABYTE_MOUSE_PROFILE_LOADING;
+		schedule_work(&priv->profile_work);
+
+		ret = device_create_bin_file(&hdev->dev, &gigabyte_mouse_profile_attr);
+		if (ret)
+			goto err_profile;
+		priv->has_profile = true;
+	}
+
+	if (!settings)
+		return 0;
+
+	mutex_lock(&priv->lock);
+	ret = gigabyte_mouse_read(priv);
+	mutex_unlock(&priv->lock);
+	if (ret) {
+		hid_warn(hdev, "Failed to read mouse settings: %d\n", ret);
+		return 0;
+	}
+
+	priv->has_settings = true;
+	hid_info(hdev, "%s mouse, %u Hz, up to %u Hz\n", priv->model->name,
+		 priv->settings.poll_rate, priv->max_rate);
+	return 0;
+
+err_profile:
+	cancel_work_sync(&priv->profile_work);
+err_queue:
+	gigabyte_core_queue_destroy(priv->queue);
+	hid_hw_stop(hdev);
+	return ret;
+}
+
+static void gigabyte_mouse_remove(struct hid_device *hdev)
+{
+	struct gigabyte_mouse_data *priv = hid_get_drvdata(hdev);
+
+	if (priv->has_profile) {
+		device_remove_bin_file(&hdev->dev, &gigabyte_mouse_profile_attr);
+
+		/* A lost write in the queue must not start another load */
+		mutex_lock(&priv->profile_lock);
+		priv->removing = true;
+		mutex_unlock(&priv->profile_lock);
+		cancel_work_sync(&priv->profile_work);
+	}
+
+	gigabyte_core_queue_destroy(priv->queue);
+	hid_hw_stop(hdev);
+}
+
+#define GIGABYTE_MOUSE_HID_DEVICE(vendor, product, ...)				\
+	{ HID_USB_DEVICE(vendor, product),					\
+	  .driver_data = (kernel_ulong_t)&gigabyte_mouse_##product },
+
+static const struct hid_device_id gigabyte_mouse_devices[] = {
+	GIGABYTE_MOUSE_MODELS(GIGABYTE_MOUSE_HID_DEVICE)
+	{ }
+};
+MODULE_DEVICE_TABLE(hid, gigabyte_mouse_devices);
+
+static struct hid_driver gigabyte_mouse_driver = {
+	.name = "gigabytemouse",
+	.id_table = gigabyte_mouse_devices,
+	.probe = gigabyte_mouse_probe,
+	.remove = gigabyte_mouse_remove,
+	.driver = {
+		.dev_groups = gigabyte_mouse_groups,
+	},
+};
+module_hid_driver(gigabyte_mouse_driver);
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __HID_GIGABYTE_MOUSE_H
+#define __HID_GIGABYTE_MOUSE_H
+
+#include <linux/types.h>
+
+/* Device tables, generated from config/devices.json */
+#include "gigabytemouse_devices.h"
+
+/*
+ * Mouse settings are one vendor feature report, read with GET_REPORT and
+ * written back whole with SET_REPORT, bytes the driver doesn't know as
+ * they were read. All fields are little-endian. Not yet checked against a
+ * real mouse.
+ * Interfaces without this report in their descriptor get no settings
+ * attributes.
+ */
+#define GIGABYTE_MOUSE_SETTINGS_REPORT_ID	0x0b
+#define GIGABYTE_MOUSE_MAX_STAGES		8
+
+#define GIGABYTE_MOUSE_LIFT_OFF_MIN		1	/* mm */
+#define GIGABYTE_MOUSE_LIFT_OFF_MAX		3
+
+struct gigabyte_mouse_settings_report {
+	__u8 report_id;		/* GIGABYTE_MOUSE_SETTINGS_REPORT_ID */
+	__u8 lift_off;		/* mm */
+	__le16 poll_rate;	/* Hz */
+	__u8 num_stages;
+	__u8 active_stage;	/* Index into dpi[] */
+	__le16 dpi[GIGABYTE_MOUSE_MAX_STAGES];
+	__u8 reserved[10];
+};
+
+#define GIGABYTE_MOUSE_SETTINGS_SIZE	sizeof(struct gigabyte_mouse_settings_report)
+
+/*
+ * Onboard profile memory (DPI, buttons and lighting of every profile) is
+ * one GIGABYTE_MOUSE_PROFILE_SIZE byte image, accessed a chunk at a time
+ * through another feature report. To read, SET_REPORT a read request for
+ * offset and len, then GET_REPORT the same report back with the data;
+ * gigabyte_core_transact() keeps the pair together. To write, SET_REPORT a
+ * write request carrying the data. Not yet checked against a real mouse.
+ */
+#define GIGABYTE_MOUSE_PROFILE_REPORT_ID	0x0d
+#define GIGABYTE_MOUSE_PROFILE_SIZE		4096
+#define GIGABYTE_MOUSE_PROFILE_CHUNK		56
+
+#define GIGABYTE_MOUSE_PROFILE_READ		0x01
+#define GIGABYTE_MOUSE_PROFILE_WRITE		0x02
+
+struct gigabyte_mouse_profile_report {
+	__u8 report_id;		/* GIGABYTE_MOUSE_PROFILE_REPORT_ID */
+	__u8 op;		/* GIGABYTE_MOUSE_PROFILE_READ or _WRITE */
+	__le16 offset;
+	__u8 len;		/* At most GIGABYTE_MOUSE_PROFILE_CHUNK */
+	__u8 reserved[3];
+	__u8 data[GIGABYTE_MOUSE_PROFILE_CHUNK];
+};
+
+#define GIGABYTE_MOUSE_PROFILE_REPORT_SIZE	sizeof(struct gigabyte_mouse_profile_report)
+
+#endif /* __HID_GIGABYTE_MOUSE_H */
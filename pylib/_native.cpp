@@ -0,0 +1,488 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Native part of the opengigabyte Python library
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * StatusReader maps the daemon's status block and builds Python objects
+ * straight from a seqlock snapshot of it, so a read is a few hundred
+ * byte memcpy and no syscall. wait() sleeps on the block's futex with
+ * the GIL released. Control sends fixed size requests over the daemon's
+ * SOCK_SEQPACKET control socket. Layouts come from the daemon headers.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../daemon/ipc.hpp"
+#include "../daemon/status.hpp"
+
+using namespace opengigabyte;
+
+namespace {
+
+/* Status: a named tuple of one snapshot */
+
+PyStructSequence_Field status_fields[] = {
+	{ "profile", "Profile in effect, None before the first" },
+	{ "power", "'ac', 'battery' or None" },
+	{ "workload", "True while a workload holds the profile" },
+	{ "touchpad", "True if on, False if off, None if unknown" },
+	{ "backlight", "Brightness, None if unknown" },
+	{ "backlight_max", "Highest brightness, None if unknown" },
+	{ "backlight_on", "False while blanked, None if unknown" },
+	{ "fans", "Fan speeds in RPM" },
+	{ "temps", "(label, degrees Celsius) per sensor chip" },
+	{ "updated", "CLOCK_MONOTONIC time of the update in seconds" },
+	{ "seq", "Update count this snapshot belongs to" },
+	{ nullptr, nullptr },
+};
+
+PyStructSequence_Desc status_desc = {
+	"opengigabyte.Status",
+	"Snapshot of the daemon's status block",
+	status_fields,
+	11,
+};
+
+PyTypeObject *status_type;
+
+PyObject *optional_int(std::int64_t value)
+{
+	if (value < 0)
+		Py_RETURN_NONE;
+	return PyLong_FromLongLong(value);
+}
+
+PyObject *optional_bool(std::int8_t value)
+{
+	if (value < 0)
+		Py_RETURN_NONE;
+	return PyBool_FromLong(value);
+}
+
+PyObject *build_status(const StatusData &d, std::uint32_t seq)
+{
+	PyObject *st = PyStructSequence_New(status_type);
+	PyObject *fans, *temps;
+
+	if (!st)
+		return nullptr;
+
+	std::uint32_t nfans = d.fan_count < kStatusFans ? d.fan_count : kStatusFans;
+	std::uint32_t ntemps = d.temp_count < kStatusTemps ? d.temp_count : kStatusTemps;
+
+	fans = PyTuple_New(nfans);
+	temps = PyTuple_New(ntemps);
+	if (!fans || !temps) {
+		Py_XDECREF(fans);
+		Py_XDECREF(temps);
+		Py_DECREF(st);
+		return nullptr;
+	}
+	for (std::uint32_t i = 0; i < nfans; i++)
+		PyTuple_SET_ITEM(fans, i, PyLong_FromLong(d.fan_rpm[i]));
+	for (std::uint32_t i = 0; i < ntemps; i++)
+		PyTuple_SET_ITEM(temps, i, Py_BuildValue("(s#d)", d.temp_label[i],
+			static_cast<Py_ssize_t>(strnlen(d.temp_label[i], sizeof(d.temp_label[i]))),
+			d.temp_mc[i] / 1000.0));
+
+	PyStructSequence_SET_ITEM(st, 0, d.profile[0] ?
+		PyUnicode_FromStringAndSize(d.profile, strnlen(d.profile, sizeof(d.profile))) :
+		Py_NewRef(Py_None));
+	PyStructSequence_SET_ITEM(st, 1, d.power == kStatusPowerAC ? PyUnicode_FromString("ac") :
+		d.power == kStatusPowerBattery ? PyUnicode_FromString("battery") :
+		Py_NewRef(Py_None));
+	PyStructSequence_SET_ITEM(st, 2, PyBool_FromLong(d.workload));
+	PyStructSequence_SET_ITEM(st, 3, optional_bool(d.touchpad));
+	PyStructSequence_SET_ITEM(st, 4, optional_int(d.backlight));
+	PyStructSequence_SET_ITEM(st, 5, optional_int(d.backlight_max));
+	PyStructSequence_SET_ITEM(st, 6, optional_bool(d.backlight_power));
+	PyStructSequence_SET_ITEM(st, 7, fans);
+	PyStructSequence_SET_ITEM(st, 8, temps);
+	PyStructSequence_SET_ITEM(st, 9, PyFloat_FromDouble(d.updated_ns / 1e9));
+	PyStructSequence_SET_ITEM(st, 10, PyLong_FromUnsignedLong(seq));
+
+	if (PyErr_Occurred()) {
+		Py_DECREF(st);
+		return nullptr;
+	}
+	return st;
+}
+
+/* StatusReader */
+
+struct StatusReaderObject {
+	PyObject_HEAD
+	int fd;
+	const StatusBlock *block;
+};
+
+const StatusBlock *reader_block(StatusReaderObject *self)
+{
+	if (!self->block)
+		PyErr_SetString(PyExc_ValueError, "status reader is closed");
+	return self->block;
+}
+
+void reader_close_block(StatusReaderObject *self)
+{
+	if (self->block)
+		munmap(const_cast<StatusBlock *>(self->block), sizeof(StatusBlock));
+	if (self->fd >= 0)
+		close(self->fd);
+	self->block = nullptr;
+	self->fd = -1;
+}
+
+int StatusReader_init(StatusReaderObject *self, PyObject *args, PyObject *kwds)
+{
+	static const char *kwlist[] = { "path", nullptr };
+	const char *path = kStatusPath;
+	void *map;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s", const_cast<char **>(kwlist), &path))
+		return -1;
+	reader_close_block(self);
+
+	/* The open fd is what tells the daemon to keep sensors sampled */
+	self->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (self->fd < 0) {
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+		return -1;
+	}
+	map = mmap(nullptr, sizeof(StatusBlock), PROT_READ, MAP_SHARED, self->fd, 0);
+	if (map == MAP_FAILED) {
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+		reader_close_block(self);
+		return -1;
+	}
+	self->block = static_cast<const StatusBlock *>(map);
+	if (!status_valid(self->block)) {
+		PyErr_Format(PyExc_ValueError, "%s: not a version %u status block", path,
+			     kStatusVersion);
+		reader_close_block(self);
+		return -1;
+	}
+	return 0;
+}
+
+PyObject *StatusReader_new(PyTypeObject *type, PyObject *, PyObject *)
+{
+	auto *self = reinterpret_cast<StatusReaderObject *>(type->tp_alloc(type, 0));
+
+	if (self) {
+		self->fd = -1;
+		self->block = nullptr;
+	}
+	return reinterpret_cast<PyObject *>(self);
+}
+
+void StatusReader_dealloc(StatusReaderObject *self)
+{
+	reader_close_block(self);
+	PyTypeObject *type = Py_TYPE(self);
+
+	type->tp_free(reinterpret_cast<PyObject *>(self));
+	Py_DECREF(type);
+}
+
+PyObject *StatusReader_read(StatusReaderObject *self, PyObject *)
+{
+	const StatusBlock *block = reader_block(self);
+	StatusData data;
+	std::uint32_t seq;
+
+	if (!block)
+		return nullptr;
+	seq = status_read(block, data);
+	return build_status(data, seq);
+}
+
+PyObject *StatusReader_wait(StatusReaderObject *self, PyObject *args, PyObject *kwds)
+{
+	static const char *kwlist[] = { "seq", "timeout", nullptr };
+	const StatusBlock *block = reader_block(self);
+	unsigned long seq;
+	PyObject *timeout_obj = Py_None;
+	timespec timeout, *tp = nullptr;
+	int ret;
+
+	if (!block)
+		return nullptr;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "k|O", const_cast<char **>(kwlist),
+					 &seq, &timeout_obj))
+		return nullptr;
+	if (timeout_obj != Py_None) {
+		double t = PyFloat_AsDouble(timeout_obj);
+
+		if (t == -1.0 && PyErr_Occurred())
+			return nullptr;
+		if (t < 0)
+			t = 0;
+		timeout.tv_sec = static_cast<time_t>(t);
+		timeout.tv_nsec = static_cast<long>((t - std::floor(t)) * 1e9);
+		tp = &timeout;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = status_wait(block, static_cast<std::uint32_t>(seq), tp);
+	Py_END_ALLOW_THREADS
+
+	if (ret == -EINTR && PyErr_CheckSignals())
+		return nullptr;
+	return PyBool_FromLong(ret == 0);
+}
+
+PyObject *StatusReader_close(StatusReaderObject *self, PyObject *)
+{
+	reader_close_block(self);
+	Py_RETURN_NONE;
+}
+
+PyObject *enter_self(PyObject *self, PyObject *)
+{
+	return Py_NewRef(self);
+}
+
+PyObject *StatusReader_get_seq(StatusReaderObject *self, void *)
+{
+	const StatusBlock *block = reader_block(self);
+
+	if (!block)
+		return nullptr;
+	return PyLong_FromUnsignedLong(__atomic_load_n(&block->seq, __ATOMIC_ACQUIRE));
+}
+
+PyMethodDef StatusReader_methods[] = {
+	{ "read", reinterpret_cast<PyCFunction>(StatusReader_read), METH_NOARGS,
+	  "read() -> Status\n\nConsistent snapshot of the status block." },
+	{ "wait", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(StatusReader_wait)),
+	  METH_VARARGS | METH_KEYWORDS,
+	  "wait(seq, timeout=None) -> bool\n\n"
+	  "Sleep until an update newer than Status.seq == seq is published.\n"
+	  "Returns False on timeout." },
+	{ "close", reinterpret_cast<PyCFunction>(StatusReader_close), METH_NOARGS,
+	  "Unmap the block." },
+	{ "__enter__", enter_self, METH_NOARGS, nullptr },
+	{ "__exit__", reinterpret_cast<PyCFunction>(StatusReader_close), METH_VARARGS, nullptr },
+	{ nullptr, nullptr, 0, nullptr },
+};
+
+PyGetSetDef StatusReader_getset[] = {
+	{ "seq", reinterpret_cast<getter>(StatusReader_get_seq), nullptr,
+	  "Current update count, odd while the daemon writes", nullptr },
+	{ nullptr, nullptr, nullptr, nullptr, nullptr },
+};
+
+PyType_Slot StatusReader_slots[] = {
+	{ Py_tp_doc, const_cast<char *>("StatusReader(path='/run/opengigabyte/status')") },
+	{ Py_tp_new, reinterpret_cast<void *>(StatusReader_new) },
+	{ Py_tp_init, reinterpret_cast<void *>(StatusReader_init) },
+	{ Py_tp_dealloc, reinterpret_cast<void *>(StatusReader_dealloc) },
+	{ Py_tp_methods, StatusReader_methods },
+	{ Py_tp_getset, StatusReader_getset },
+	{ 0, nullptr },
+};
+
+PyType_Spec StatusReader_spec = {
+	"opengigabyte.StatusReader",
+	sizeof(StatusReaderObject),
+	0,
+	Py_TPFLAGS_DEFAULT,
+	StatusReader_slots,
+};
+
+/* Control */
+
+struct ControlObject {
+	PyObject_HEAD
+	int fd;
+};
+
+int Control_init(ControlObject *self, PyObject *args, PyObject *kwds)
+{
+	static const char *kwlist[] = { "path", nullptr };
+	const char *path = kControlPath;
+	sockaddr_un addr {};
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s", const_cast<char **>(kwlist), &path))
+		return -1;
+	if (std::strlen(path) >= sizeof(addr.sun_path)) {
+		PyErr_Format(PyExc_ValueError, "%s: path too long", path);
+		return -1;
+	}
+	if (self->fd >= 0)
+		close(self->fd);
+
+	self->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (self->fd < 0) {
+		PyErr_SetFromErrno(PyExc_OSError);
+		return -1;
+	}
+	addr.sun_family = AF_UNIX;
+	std::strcpy(addr.sun_path, path);
+	if (connect(self->fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+		close(self->fd);
+		self->fd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+PyObject *Control_new(PyTypeObject *type, PyObject *, PyObject *)
+{
+	auto *self = reinterpret_cast<ControlObject *>(type->tp_alloc(type, 0));
+
+	if (self)
+		self->fd = -1;
+	return reinterpret_cast<PyObject *>(self);
+}
+
+void Control_dealloc(ControlObject *self)
+{
+	if (self->fd >= 0)
+		close(self->fd);
+	PyTypeObject *type = Py_TYPE(self);
+
+	type->tp_free(reinterpret_cast<PyObject *>(self));
+	Py_DECREF(type);
+}
+
+/* One request, one reply; returns the profile in effect */
+PyObject *control_call(ControlObject *self, std::uint16_t op, const char *arg)
+{
+	IpcRequest req {};
+	IpcReply reply {};
+	ssize_t len = -1;
+
+	if (self->fd < 0) {
+		PyErr_SetString(PyExc_ValueError, "control connection is closed");
+		return nullptr;
+	}
+	if (arg && std::strlen(arg) >= sizeof(req.arg)) {
+		PyErr_Format(PyExc_ValueError, "%s: name too long", arg);
+		return nullptr;
+	}
+	req.version = kIpcVersion;
+	req.op = op;
+	if (arg)
+		std::strcpy(req.arg, arg);
+
+	Py_BEGIN_ALLOW_THREADS
+	if (send(self->fd, &req, sizeof(req), MSG_NOSIGNAL) == sizeof(req))
+		len = recv(self->fd, &reply, sizeof(reply), 0);
+	Py_END_ALLOW_THREADS
+
+	if (len < 0)
+		return PyErr_SetFromErrno(PyExc_OSError);
+	if (len != sizeof(reply)) {
+		errno = len ? EPROTO : ECONNRESET;
+		return PyErr_SetFromErrno(PyExc_OSError);
+	}
+	if (reply.error) {
+		errno = -reply.error;
+		return PyErr_SetFromErrno(PyExc_OSError);
+	}
+	return PyUnicode_FromStringAndSize(reply.profile, strnlen(reply.profile, sizeof(reply.profile)));
+}
+
+PyObject *Control_set_profile(ControlObject *self, PyObject *args)
+{
+	const char *name;
+
+	if (!PyArg_ParseTuple(args, "s", &name))
+		return nullptr;
+	return control_call(self, kIpcSetProfile, name);
+}
+
+PyObject *Control_cycle_profile(ControlObject *self, PyObject *)
+{
+	return control_call(self, kIpcCycleProfile, nullptr);
+}
+
+PyObject *Control_close(ControlObject *self, PyObject *)
+{
+	if (self->fd >= 0)
+		close(self->fd);
+	self->fd = -1;
+	Py_RETURN_NONE;
+}
+
+PyMethodDef Control_methods[] = {
+	{ "set_profile", reinterpret_cast<PyCFunction>(Control_set_profile), METH_VARARGS,
+	  "set_profile(name) -> str\n\n"
+	  "Select a profile from the daemon's config. Returns the profile in\n"
+	  "effect, which stays the workload's while one runs." },
+	{ "cycle_profile", reinterpret_cast<PyCFunction>(Control_cycle_profile), METH_NOARGS,
+	  "cycle_profile() -> str\n\nSwitch to the next profile, like Fn+ESC." },
+	{ "close", reinterpret_cast<PyCFunction>(Control_close), METH_NOARGS,
+	  "Close the connection." },
+	{ "__enter__", enter_self, METH_NOARGS, nullptr },
+	{ "__exit__", reinterpret_cast<PyCFunction>(Control_close), METH_VARARGS, nullptr },
+	{ nullptr, nullptr, 0, nullptr },
+};
+
+PyType_Slot Control_slots[] = {
+	{ Py_tp_doc, const_cast<char *>("Control(path='/run/opengigabyte/control')") },
+	{ Py_tp_new, reinterpret_cast<void *>(Control_new) },
+	{ Py_tp_init, reinterpret_cast<void *>(Control_init) },
+	{ Py_tp_dealloc, reinterpret_cast<void *>(Control_dealloc) },
+	{ Py_tp_methods, Control_methods },
+	{ 0, nullptr },
+};
+
+PyType_Spec Control_spec = {
+	"opengigabyte.Control",
+	sizeof(ControlObject),
+	0,
+	Py_TPFLAGS_DEFAULT,
+	Control_slots,
+};
+
+PyModuleDef native_module = {
+	PyModuleDef_HEAD_INIT,
+	"opengigabyte._native",
+	"Status block reader and control client for opengigabyte-daemon.",
+	-1,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit__native(void)
+{
+	PyObject *m, *reader, *control;
+
+	status_type = PyStructSequence_NewType(&status_desc);
+	if (!status_type)
+		return nullptr;
+	reader = PyType_FromSpec(&StatusReader_spec);
+	control = PyType_FromSpec(&Control_spec);
+	m = PyModule_Create(&native_module);
+	if (!reader || !control || !m ||
+	    PyModule_AddObjectRef(m, "Status", reinterpret_cast<PyObject *>(status_type)) < 0 ||
+	    PyModule_AddObjectRef(m, "StatusReader", reader) < 0 ||
+	    PyModule_AddObjectRef(m, "Control", control) < 0 ||
+	    PyModule_AddStringConstant(m, "STATUS_PATH", kStatusPath) < 0 ||
+	    PyModule_AddStringConstant(m, "CONTROL_PATH", kControlPath) < 0)
+		Py_CLEAR(m);
+	Py_XDECREF(reader);
+	Py_XDECREF(control);
+	return m;
+}
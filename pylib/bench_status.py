@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+"""Status read throughput of the opengigabyte python library.
+
+Starts a private opengigabyte-daemon with profiles that touch nothing,
+then counts for a few seconds each: StatusReader.read() snapshots, seq
+polls, and set_profile() round trips over the control socket.
+
+Usage: bench_status.py [daemon] [seconds]
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import opengigabyte  # noqa: E402
+
+CONFIG = """\
+profile quiet
+profile balanced
+sensor_interval 0.1
+"""
+
+
+def rate(name, fn, seconds):
+    # Batches of 1000 keep the clock out of the measurement
+    n = 0
+    start = time.perf_counter()
+    end = start + seconds
+    while True:
+        for _ in range(1000):
+            fn()
+        n += 1000
+        now = time.perf_counter()
+        if now >= end:
+            break
+    per_s = n / (now - start)
+    print(f"{name:<16} {per_s:>12,.0f}/s  {1e9 / per_s:8.0f} ns")
+
+
+def wait_for(path, proc):
+    for _ in range(100):
+        if os.path.exists(path):
+            return
+        if proc.poll() is not None:
+            sys.exit(f"daemon exited with {proc.returncode}")
+        time.sleep(0.05)
+    sys.exit(f"{path} did not appear")
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    daemon = sys.argv[1] if len(sys.argv) > 1 else \
+        os.path.join(here, "..", "daemon", "opengigabyte-daemon")
+    seconds = float(sys.argv[2]) if len(sys.argv) > 2 else 2
+
+    with tempfile.TemporaryDirectory() as tmp:
+        config = os.path.join(tmp, "daemon.conf")
+        status = os.path.join(tmp, "status")
+        control = os.path.join(tmp, "control")
+        with open(config, "w") as f:
+            f.write(CONFIG)
+
+        proc = subprocess.Popen([daemon, "--foreground", "--config", config,
+                                 "--status", status, "--control", control,
+                                 "--group", ""])
+        try:
+            wait_for(status, proc)
+            wait_for(control, proc)
+
+            with opengigabyte.StatusReader(status) as reader, \
+                    opengigabyte.Control(control) as ctl:
+                st = reader.read()
+                print(f"profile {st.profile}, {len(st.fans)} fans, "
+                      f"{len(st.temps)} temps, seq {st.seq}")
+                rate("read()", reader.read, seconds)
+                rate("seq", lambda: reader.seq, seconds)
+                names = iter(["quiet", "balanced"] * 10**7)
+                rate("set_profile()", lambda: ctl.set_profile(next(names)),
+                     seconds / 2)
+        finally:
+            proc.terminate()
+            proc.wait()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,47 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+"""Python access to opengigabyte-daemon.
+
+Status is read from the daemon's shared memory block without a round
+trip: StatusReader maps it once and read() takes a consistent snapshot.
+Profile changes go over the daemon's control socket, which only root
+and members of the opengigabyte group may use.
+
+    import opengigabyte
+
+    with opengigabyte.StatusReader() as reader:
+        st = reader.read()
+        print(st.profile, st.fans, st.temps)
+        reader.wait(st.seq, timeout=5)    # until the next update
+
+    opengigabyte.Control().set_profile("quiet")
+"""
+
+from ._native import (CONTROL_PATH, STATUS_PATH, Control, Status,
+                      StatusReader)
+
+__all__ = ["CONTROL_PATH", "STATUS_PATH", "Control", "Status",
+           "StatusReader", "status", "set_profile", "cycle_profile"]
+
+
+def status(path=STATUS_PATH):
+    """One snapshot of the daemon's status."""
+    with StatusReader(path) as reader:
+        return reader.read()
+
+
+def set_profile(name, path=CONTROL_PATH):
+    """Select a profile; returns the one in effect."""
+    control = Control(path)
+    try:
+        return control.set_profile(name)
+    finally:
+        control.close()
+
+
+def cycle_profile(path=CONTROL_PATH):
+    """Switch to the next profile; returns the one in effect."""
+    control = Control(path)
+    try:
+        return control.cycle_profile()
+    finally:
+        control.close()
@@ -0,0 +1,65 @@
+#!/bin/bash
+#
+# Count the hidraw, hiddev and input nodes gigabytekbd creates and the
+# uevents it takes to create them, with minimal_nodes off and on. Rebinds
+# every interface gigabytekbd drives, so run it as root from a VT or over
+# ssh: the keyboard goes away for a moment.
+
+set -e
+
+DRIVER=/sys/bus/hid/drivers/gigabytekbd
+PARAM=/sys/module/gigabytekbd/parameters/minimal_nodes
+
+if [ ! -d "${DRIVER}" ]; then
+	echo "gigabytekbd is not loaded" >&2
+	exit 1
+fi
+
+DEVICES=$(basename -a "${DRIVER}"/*:*:*.* 2>/dev/null || true)
+if [ -z "${DEVICES}" ]; then
+	echo "No device is bound to gigabytekbd" >&2
+	exit 1
+fi
+
+count_nodes() {
+	local hidraw=0 hiddev=0 input=0 dev
+
+	for dev in ${DEVICES}; do
+		hidraw=$((hidraw + $(ls "${DRIVER}/${dev}/hidraw" 2>/dev/null | wc -l)))
+		hiddev=$((hiddev + $(ls -d "${DRIVER}/${dev}"/usbmisc/hiddev* 2>/dev/null | wc -l)))
+		input=$((input + $(ls -d "${DRIVER}/${dev}"/input/input* 2>/dev/null | wc -l)))
+	done
+	echo "hidraw ${hidraw}, hiddev ${hiddev}, input ${input}"
+}
+
+rebind() {
+	local log dev pid
+
+	log=$(mktemp)
+	udevadm monitor --kernel > "${log}" &
+	pid=$!
+	sleep 1
+
+	for dev in ${DEVICES}; do
+		echo "${dev}" > "${DRIVER}/unbind"
+	done
+	echo "$1" > "${PARAM}"
+	for dev in ${DEVICES}; do
+		echo "${dev}" > "${DRIVER}/bind"
+	done
+
+	udevadm settle
+	kill "${pid}"
+	wait "${pid}" 2>/dev/null || true
+	echo "  $(grep -c '^KERNEL\[' "${log}") uevents for unbind and bind"
+	rm -f "${log}"
+}
+
+ORIG=$(cat "${PARAM}")
+trap 'echo "${ORIG}" > "${PARAM}"' EXIT
+
+for mode in N Y; do
+	echo "minimal_nodes=${mode}:"
+	rebind "${mode}"
+	echo "  $(count_nodes)"
+done
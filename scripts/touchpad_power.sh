@@ -0,0 +1,104 @@
+#!/bin/bash
+#
+# Measure what turning the touchpad off with Fn+F10 saves: touchpad
+# interrupts per second with it on and off, and how long turning it back
+# on takes. Asks for Fn+F10 presses, so run it as root at the laptop and
+# keep a finger moving on the touchpad while it counts.
+#
+#   sudo ./scripts/touchpad_power.sh [seconds]
+#
+# With --suspend, checks instead that a touchpad turned off stays off over
+# a suspend to RAM, woken by the RTC after 10 seconds.
+
+set -e
+
+SUSPEND=
+if [ "$1" = --suspend ]; then
+	SUSPEND=1
+	shift
+fi
+SECONDS_PER_RUN=${1:-10}
+DRIVER=/sys/bus/hid/drivers/gigabytekbd
+RESUME_US=/sys/kernel/debug/gigabytekbd/touchpad_resume_us
+
+ATTR=$(ls "${DRIVER}"/*/touchpad 2>/dev/null | head -n 1)
+if [ -z "${ATTR}" ]; then
+	echo "No device is bound to gigabytekbd" >&2
+	exit 1
+fi
+if [ "$(cat "${ATTR}")" != 1 ]; then
+	echo "Turn the touchpad on with Fn+F10 first" >&2
+	exit 1
+fi
+
+# The ACPI-enumerated I2C HID device, named as its IRQ is in /proc/interrupts
+TOUCHPAD=
+for dev in /sys/bus/i2c/drivers/i2c_hid*/*-*; do
+	if [ -e "${dev}/firmware_node" ]; then
+		TOUCHPAD=$(cat "${dev}/name")
+		break
+	fi
+done
+if [ -z "${TOUCHPAD}" ]; then
+	echo "No I2C HID touchpad found" >&2
+	exit 1
+fi
+
+# Sum of the per-CPU counts on the touchpad's line, 0 once its IRQ is freed
+irq_count() {
+	local cpus
+
+	cpus=$(head -n 1 /proc/interrupts | wc -w)
+	awk -v name="${TOUCHPAD}" -v cpus="${cpus}" '
+		$NF == name { for (i = 2; i <= cpus + 1; i++) sum += $i }
+		END { print sum + 0 }' /proc/interrupts
+}
+
+irq_rate() {
+	local before after
+
+	before=$(irq_count)
+	sleep "${SECONDS_PER_RUN}"
+	after=$(irq_count)
+	# A freed IRQ takes its counts with it
+	[ "${after}" -ge "${before}" ] || before=0
+	echo "$(( (after - before) / SECONDS_PER_RUN ))"
+}
+
+wait_for() {
+	while [ "$(cat "${ATTR}")" != "$1" ]; do
+		sleep 0.1
+	done
+}
+
+if [ -n "${SUSPEND}" ]; then
+	echo "Press Fn+F10 to turn the touchpad off"
+	wait_for 0
+	rtcwake -m mem -s 10 > /dev/null
+	# A re-enumerated touchpad is turned off again once probing is done
+	sleep 3
+	if [ "$(cat "${ATTR}")" = 0 ] && ! grep -q " ${TOUCHPAD}\$" /proc/interrupts; then
+		echo "PASS: touchpad still off after resume"
+		status=0
+	else
+		echo "FAIL: touchpad came back on over suspend"
+		status=1
+	fi
+	echo "Press Fn+F10 to turn the touchpad back on"
+	wait_for 1
+	exit "${status}"
+fi
+
+echo "Touchpad ${TOUCHPAD}, ${SECONDS_PER_RUN} s per run"
+echo "Keep a finger moving on the touchpad..."
+echo "on:  $(irq_rate) interrupts/s"
+
+echo "Press Fn+F10 to turn the touchpad off, then keep moving"
+wait_for 0
+echo "off: $(irq_rate) interrupts/s"
+
+echo "Press Fn+F10 to turn the touchpad back on"
+wait_for 1
+if [ -r "${RESUME_US}" ]; then
+	echo "back on in $(cat "${RESUME_US}") us"
+fi
@@ -0,0 +1,444 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Generate everything that lists supported devices from config/devices.json:
+#
+#   driver/gigabytekbd_devices.h        VID/PIDs, Fn codes, keymap, touchpads,
+#                                       model profiles and DMI matches
+#   driver/gigabytemouse_devices.h      Mouse VID/PIDs and limits
+#   driver/gigabytefirefly_devices.h    Mouse pad VID/PIDs, zones and frame rate
+#   config/gigabytekbd.conf             Source of the firmware config
+#   install_files/udev/99-gigabyte.rules
+#   install_files/hwdb/70-gigabyte-fn.hwdb
+#   README.md                           Supported devices table
+#
+# With --check nothing is written and the exit status tells whether the
+# generated files are up to date.
+#
+# Copyright (c) 2020 Hemanth Bollamreddi
+
+import argparse
+import json
+import os
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+DATABASE = 'config/devices.json'
+GENERATED = f'Generated from {DATABASE} by tools/gen-devices.py, do not edit.'
+
+CAPS = ['backlight', 'touchpad']
+CONNECTS = ['hidinput', 'hidraw', 'hiddev']
+APPS = ['keyboard', 'mouse', 'system', 'wireless', 'consumer']
+DEFAULT_CONNECT = ['hidinput', 'hidraw']
+DEFAULT_VENDOR_CONNECT = ['hidraw']
+DEFAULT_BACKLIGHT = 'intel_backlight'
+POLL_RATES = [125, 250, 500, 1000, 2000, 4000, 8000]
+MOUSE_MAX_STAGES = 8
+FIREFLY_MAX_ZONES = 15
+FIREFLY_MAX_FPS = 1000
+
+README_BEGIN = '<!-- Generated from config/devices.json, edit that instead -->'
+README_END = '<!-- End of generated table -->'
+
+
+class DatabaseError(Exception):
+    pass
+
+
+def tab_pad(text, column):
+    """Pad text with tabs up to column, kernel style."""
+    width = len(text.expandtabs())
+    pad = ''
+    while width < column:
+        pad += '\t'
+        width = (width // 8 + 1) * 8
+    return text + (pad or ' ')
+
+
+def c_macro(name, entries):
+    """X-macro with one X() per entry; an entry may be a list of lines."""
+    lines = [f'#define {name}(X)']
+    for e in entries:
+        lines += [f'\t{line}' for line in e] if isinstance(e, list) else [f'\tX({", ".join(e)})']
+    column = max(len(line.expandtabs()) for line in lines) + 1
+    column = (column + 7) // 8 * 8
+    out = [tab_pad(line, column) + '\\' for line in lines[:-1]]
+    return '\n'.join(out + [lines[-1]]) + '\n'
+
+
+def c_define(name, value, comment=None):
+    line = tab_pad(f'#define {name}', 48) + value
+    if comment:
+        line += f'\t/* {comment} */'
+    return line + '\n'
+
+
+def c_mask(prefix, names):
+    return [f'{prefix}{name.upper()}' for name in names] or ['0']
+
+
+def c_str(value):
+    return 'NULL' if value is None else json.dumps(value)
+
+
+def load(path):
+    with open(path) as f:
+        db = json.load(f)
+
+    hids = {tp['hid'] for tp in db['touchpads']}
+    for pid, profile in db['profiles'].items():
+        for field, known in (('caps', CAPS), ('connect', CONNECTS),
+                             ('vendor_connect', CONNECTS), ('ignore_apps', APPS)):
+            for value in profile.get(field, []):
+                if value not in known:
+                    raise DatabaseError(f'profile {pid}: unknown {field} value {value}')
+        if profile.get('touchpad') and profile['touchpad'] not in hids:
+            raise DatabaseError(f'profile {pid}: unknown touchpad {profile["touchpad"]}')
+
+    usb = {}
+    for model in db['models']:
+        if model['profile'] not in db['profiles']:
+            raise DatabaseError(f'{model["name"]}: unknown profile {model["profile"]}')
+        for dev in model['usb']:
+            dev['vid'], dev['pid'] = dev['vid'].upper(), dev['pid'].upper()
+            old = usb.setdefault(dev['id'], dev)
+            if (old['vid'], old['pid']) != (dev['vid'], dev['pid']):
+                raise DatabaseError(f'{model["name"]}: USB id {dev["id"]} redefined')
+
+    for mouse in db.get('mice', []):
+        if mouse['max_rate'] not in POLL_RATES:
+            raise DatabaseError(f'{mouse["name"]}: max_rate must be one of {POLL_RATES}')
+        dpi_min, dpi_max, dpi_step = mouse['dpi']
+        if not 0 < dpi_min <= dpi_max or dpi_step <= 0 or (dpi_max - dpi_min) % dpi_step:
+            raise DatabaseError(f'{mouse["name"]}: bad dpi range {mouse["dpi"]}')
+        if not 0 < mouse['stages'] <= MOUSE_MAX_STAGES:
+            raise DatabaseError(f'{mouse["name"]}: stages must be 1 to {MOUSE_MAX_STAGES}')
+        for dev in mouse['usb']:
+            dev['vid'], dev['pid'] = dev['vid'].upper(), dev['pid'].upper()
+            if dev['id'] in usb:
+                raise DatabaseError(f'{mouse["name"]}: USB id {dev["id"]} redefined')
+            usb[dev['id']] = dev
+
+    for pad in db.get('mousepads', []):
+        if not 0 < pad['zones'] <= FIREFLY_MAX_ZONES:
+            raise DatabaseError(f'{pad["name"]}: zones must be 1 to {FIREFLY_MAX_ZONES}')
+        if not 0 < pad['max_fps'] <= FIREFLY_MAX_FPS:
+            raise DatabaseError(f'{pad["name"]}: max_fps must be 1 to {FIREFLY_MAX_FPS}')
+        for dev in pad['usb']:
+            dev['vid'], dev['pid'] = dev['vid'].upper(), dev['pid'].upper()
+            if dev['id'] in usb:
+                raise DatabaseError(f'{pad["name"]}: USB id {dev["id"]} redefined')
+            usb[dev['id']] = dev
+
+    # DMI matches are substrings and the first one wins
+    dmi = dmi_models(db)
+    for i, (product, _) in enumerate(dmi):
+        for earlier, _ in dmi[:i]:
+            if earlier in product:
+                raise DatabaseError(f'DMI product "{earlier}" shadows "{product}"')
+    return db
+
+
+def usb_devices(db):
+    """Unique USB ids in database order."""
+    seen = {}
+    for model in db['models']:
+        for dev in model['usb']:
+            seen.setdefault(dev['id'], dev)
+    return list(seen.values())
+
+
+def dmi_models(db):
+    """Unique (DMI product, profile) pairs in database order."""
+    seen = {}
+    for model in db['models']:
+        if model.get('dmi'):
+            seen.setdefault(model['dmi'], model['profile'])
+    return list(seen.items())
+
+
+def keymap(db):
+    return [k for k in db['fn_keys'] if 'key' in k]
+
+
+def gen_header(db):
+    out = ['/* SPDX-License-Identifier: GPL-2.0-or-later */\n',
+           f'/* {GENERATED} */\n',
+           '#ifndef __HID_GIGABYTE_KBD_DEVICES_H\n',
+           '#define __HID_GIGABYTE_KBD_DEVICES_H\n\n',
+           '/* Gigabyte laptop USB VID/PID pairs */\n']
+    devices = usb_devices(db)
+    for dev in devices:
+        out.append(c_define(f'USB_VENDOR_ID_GIGABYTE_{dev["id"]}', f'0x{dev["vid"]}'))
+        out.append(c_define(f'USB_DEVICE_ID_GIGABYTE_{dev["id"]}', f'0x{dev["pid"]}'))
+        out.append('\n')
+
+    out.append('/*\n'
+               ' * All keyboards handled by gigabytekbd, as X(vendor, product). Shared with\n'
+               ' * the userspace driver so both bind to the same devices.\n'
+               ' */\n')
+    out.append(c_macro('GIGABYTE_KBD_USB_DEVICES',
+                       [(f'USB_VENDOR_ID_GIGABYTE_{d["id"]}', f'USB_DEVICE_ID_GIGABYTE_{d["id"]}')
+                        for d in devices]))
+
+    out.append('\n/* Fn key HID raw event codes (report 4, big endian including the report ID) */\n')
+    for key in db['fn_keys']:
+        out.append(c_define(f'HIDRAW_FN_{key["name"]}', key['code'], key.get('comment')))
+
+    out.append('\n/*\n'
+               ' * Fn keys that map straight to a keycode, as X(scancode, keycode).\n'
+               ' * The other codes are handled by the driver itself.\n'
+               ' */\n')
+    out.append(c_macro('GIGABYTE_KBD_FN_KEYMAP',
+                       [(f'HIDRAW_FN_{k["name"]}', k['key']) for k in keymap(db)]))
+
+    out.append('\n/* Touchpads toggled by Fn+F10, as X(ACPI HID, bus id, instance) */\n')
+    out.append(c_macro('GIGABYTE_KBD_TOUCHPADS',
+                       [(json.dumps(tp['hid']), json.dumps(tp['bid']), str(tp['instance']))
+                        for tp in db['touchpads']]))
+
+    out.append('\n/*\n'
+               ' * Model profiles, as X(id, name, touchpad HID or NULL, backlight, caps,\n'
+               ' * connect, vendor_connect, ignore_apps). caps is a mask of GIGABYTE_KBD_CAP_*\n'
+               ' * bits, the connects are HID_CONNECT_* masks for interfaces with standard\n'
+               ' * application collections and for those with only the vendor Fn report,\n'
+               ' * and ignore_apps is a mask of GIGABYTE_KBD_APP_* collections that get no\n'
+               ' * input device.\n'
+               ' */\n')
+    entries = []
+    for pid, profile in db['profiles'].items():
+        entry = [f'X({pid}, {json.dumps(profile["name"])}, {c_str(profile.get("touchpad"))}, '
+                 f'{json.dumps(profile.get("backlight", DEFAULT_BACKLIGHT))},']
+        masks = [c_mask('GIGABYTE_KBD_CAP_', profile['caps']),
+                 c_mask('HID_CONNECT_', profile.get('connect', DEFAULT_CONNECT)),
+                 c_mask('HID_CONNECT_', profile.get('vendor_connect', DEFAULT_VENDOR_CONNECT)),
+                 c_mask('GIGABYTE_KBD_APP_', profile.get('ignore_apps', []))]
+        for i, mask in enumerate(masks):
+            sep = ')' if i == len(masks) - 1 else ','
+            for j in range(0, len(mask), 2):
+                more = j + 2 < len(mask)
+                entry.append('  ' + ' | '.join(mask[j:j + 2]) + (' |' if more else sep))
+        entries.append(entry)
+    out.append(c_macro('GIGABYTE_KBD_PROFILES', entries))
+
+    out.append('\n/* DMI product name substrings, as X(product, profile id); first match wins */\n')
+    out.append(c_macro('GIGABYTE_KBD_DMI_MODELS',
+                       [(json.dumps(product), profile) for product, profile in dmi_models(db)]))
+
+    out.append('\n#endif /* __HID_GIGABYTE_KBD_DEVICES_H */\n')
+    return ''.join(out)
+
+
+def gen_mouse_header(db):
+    out = ['/* SPDX-License-Identifier: GPL-2.0-or-later */\n',
+           f'/* {GENERATED} */\n',
+           '#ifndef __HID_GIGABYTE_MOUSE_DEVICES_H\n',
+           '#define __HID_GIGABYTE_MOUSE_DEVICES_H\n\n',
+           '/* Gigabyte mouse USB VID/PID pairs */\n']
+    entries = []
+    for mouse in db.get('mice', []):
+        for dev in mouse['usb']:
+            out.append(c_define(f'USB_VENDOR_ID_GIGABYTE_{dev["id"]}', f'0x{dev["vid"]}'))
+            out.append(c_define(f'USB_DEVICE_ID_GIGABYTE_{dev["id"]}', f'0x{dev["pid"]}'))
+            out.append('\n')
+            entries.append([f'X(USB_VENDOR_ID_GIGABYTE_{dev["id"]}, '
+                            f'USB_DEVICE_ID_GIGABYTE_{dev["id"]},',
+                            f'  {json.dumps(mouse["name"])}, {mouse["max_rate"]}, '
+                            f'{", ".join(map(str, mouse["dpi"]))}, {mouse["stages"]})'])
+
+    out.append('/*\n'
+               ' * Mice handled by gigabytemouse, as X(vendor, product, name, max poll\n'
+               ' * rate in Hz, min DPI, max DPI, DPI step, DPI stages).\n'
+               ' */\n')
+    out.append(c_macro('GIGABYTE_MOUSE_MODELS', entries))
+    out.append('\n#endif /* __HID_GIGABYTE_MOUSE_DEVICES_H */\n')
+    return ''.join(out)
+
+
+def gen_firefly_header(db):
+    out = ['/* SPDX-License-Identifier: GPL-2.0-or-later */\n',
+           f'/* {GENERATED} */\n',
+           '#ifndef __HID_GIGABYTE_FIREFLY_DEVICES_H\n',
+           '#define __HID_GIGABYTE_FIREFLY_DEVICES_H\n\n',
+           '/* Gigabyte mouse pad USB VID/PID pairs */\n']
+    entries = []
+    for pad in db.get('mousepads', []):
+        for dev in pad['usb']:
+            out.append(c_define(f'USB_VENDOR_ID_GIGABYTE_{dev["id"]}', f'0x{dev["vid"]}'))
+            out.append(c_define(f'USB_DEVICE_ID_GIGABYTE_{dev["id"]}', f'0x{dev["pid"]}'))
+            out.append('\n')
+            entries.append([f'X(USB_VENDOR_ID_GIGABYTE_{dev["id"]}, '
+                            f'USB_DEVICE_ID_GIGABYTE_{dev["id"]},',
+                            f'  {json.dumps(pad["name"])}, {pad["zones"]}, {pad["max_fps"]})'])
+
+    out.append('/*\n'
+               ' * Mouse pads handled by gigabytefirefly, as X(vendor, product, name,\n'
+               ' * RGB zones, most frames per second the pad keeps up with).\n'
+               ' */\n')
+    out.append(c_macro('GIGABYTE_FIREFLY_MODELS', entries))
+    out.append('\n#endif /* __HID_GIGABYTE_FIREFLY_DEVICES_H */\n')
+    return ''.join(out)
+
+
+def gen_config(db):
+    out = [f'# {GENERATED}\n',
+           '#\n'
+           '# Keymap and model config for gigabytekbd.\n'
+           '#\n'
+           '# Compiled with tools/gigabytekbd-config.py into gigabytekbd.bin, which the\n'
+           '# driver loads as firmware from /lib/firmware/opengigabyte/. Changes take\n'
+           '# effect on the next module load, without rebuilding the driver.\n\n'
+           '# Fn keys: key <report 4 code> <keycode>\n']
+    for key in keymap(db):
+        entry = f'key {key["code"]} {key["key"]}'
+        out.append(f'{tab_pad(entry, 40)}# {key["label"]}\n')
+
+    out.append('\n# Touchpads toggled by Fn+F10: touchpad <ACPI HID> <bus id> <instance>\n')
+    for tp in db['touchpads']:
+        entry = f'touchpad {tp["hid"]} {tp["bid"]} {tp["instance"]}'
+        out.append(f'{tab_pad(entry, 32)}# {tp["comment"]}\n')
+
+    out.append('\n# Models, first match wins: model <name> [key=value ...]\n'
+               '#   vendor, product  Substrings of the DMI system vendor and product name\n'
+               '#   touchpad         Try this touchpad HID before the others\n'
+               '#   backlight        Device in /sys/class/backlight/\n'
+               '#   caps             Comma separated: ' + ', '.join(CAPS) + '\n'
+               '# Machines no model matches keep the driver\'s built-in profile.\n')
+    for product, pid in dmi_models(db):
+        profile = db['profiles'][pid]
+        fields = [f'model "{profile["name"]}"', 'vendor=GIGABYTE', f'product="{product}"']
+        if profile.get('touchpad'):
+            fields.append(f'touchpad={profile["touchpad"]}')
+        fields.append(f'backlight={profile.get("backlight", DEFAULT_BACKLIGHT)}')
+        fields.append('caps=' + ','.join(profile['caps']))
+        out.append(' '.join(fields) + '\n')
+    return ''.join(out)
+
+
+def by_vendor(devices):
+    vendors = {}
+    for dev in devices:
+        vendors.setdefault(dev['vid'].lower(), []).append(dev['pid'].lower())
+    return vendors
+
+
+def udev_match(vendors, driver):
+    return [f'ATTRS{{idProduct}}=="{"|".join(sorted(vendors[vid]))}", \\\n'
+            f'    ATTRS{{idVendor}}=="{vid}", \\\n'
+            f'    ENV{{GIGABYTE_DRIVER}}="{driver}"\n\n' for vid in sorted(vendors)]
+
+
+def gen_udev(db):
+    keyboards = by_vendor(usb_devices(db))
+    mice = by_vendor(dev for mouse in db.get('mice', []) for dev in mouse['usb'])
+    pads = by_vendor(dev for pad in db.get('mousepads', []) for dev in pad['usb'])
+
+    out = [f'# {GENERATED}\n\n',
+           'ACTION!="add", GOTO="gigabyte_end"\n',
+           f'SUBSYSTEMS=="usb|input|hid", ATTRS{{idVendor}}=="{"|".join(sorted(keyboards | mice | pads))}", '
+           'GOTO="gigabyte_vendor"\n',
+           'GOTO="gigabyte_end"\n\n',
+           'LABEL="gigabyte_vendor"\n\n',
+           '# Keyboards\n']
+    out += udev_match(keyboards, 'gigabytekbd')
+    if mice:
+        out.append('# Mice\n')
+        out += udev_match(mice, 'gigabytemouse')
+    if pads:
+        out.append('# Mouse pads\n')
+        out += udev_match(pads, 'gigabytefirefly')
+    out.append('# Set permissions if this is an input node\n'
+               '# SUBSYSTEM=="input|hid", GROUP:="plugdev"\n\n'
+               '# We\'re done unless it\'s the hid node\n'
+               'SUBSYSTEM!="hid", GOTO="gigabyte_end"\n\n'
+               '# Rebind if needed\n'
+               'SUBSYSTEM=="hid", RUN+="gigabyte_mount $env{GIGABYTE_DRIVER} $kernel"\n\n'
+               'LABEL="gigabyte_end"\n')
+    return ''.join(out)
+
+
+def gen_hwdb(db):
+    out = [f'# {GENERATED}\n',
+           '#\n'
+           '# Fn key mapping of the "Gigabyte Fn Keys" device per model, the same as\n'
+           '# the driver\'s built-in keymap. Override keys from a later file such as\n'
+           '# /etc/udev/hwdb.d/71-gigabyte-fn-local.hwdb, then run\n'
+           '# "systemd-hwdb update && udevadm trigger". DMI modaliases have no spaces.\n']
+    for product, _ in dmi_models(db):
+        names = [m['name'] for m in db['models'] if m.get('dmi') == product]
+        out.append(f'\n# {", ".join(names)}\n')
+        out.append(f'evdev:name:Gigabyte Fn Keys:dmi:*:svnGIGABYTE*:pn*{product.replace(" ", "")}*\n')
+        for key in keymap(db):
+            name = key['key'].removeprefix('KEY_').lower()
+            out.append(f' KEYBOARD_KEY_{int(key["code"], 16):x}={name}\n')
+    return ''.join(out)
+
+
+def readme_table(readme, marker, models):
+    begin = readme.index(marker) + len(marker)
+    end = readme.index(README_END, begin)
+    rows = [('Device', 'VID:PID')]
+    for model in models:
+        if model['usb']:
+            rows.append((model['name'],
+                         ', '.join(f'{d["vid"]}:{d["pid"]}' for d in model['usb'])))
+    if len(rows) == 1:
+        lines = ['None yet.']
+    else:
+        width = [max(len(r[i]) for r in rows) for i in range(2)]
+        lines = [f'| {rows[0][0]:<{width[0]}} | {rows[0][1]:<{width[1]}} |',
+                 f'| {"-" * width[0]} | {"-" * width[1]} |']
+        lines += [f'| {name:<{width[0]}} | {ids:<{width[1]}} |' for name, ids in rows[1:]]
+    return readme[:begin] + '\n' + '\n'.join(lines) + '\n' + readme[end:]
+
+
+def gen_readme(db, readme):
+    return readme_table(readme, README_BEGIN, db['models'])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=f'Generate device tables from {DATABASE}.')
+    parser.add_argument('--check', action='store_true',
+                        help='only check that the generated files are up to date')
+    args = parser.parse_args()
+
+    try:
+        db = load(os.path.join(ROOT, DATABASE))
+        with open(os.path.join(ROOT, 'README.md')) as f:
+            readme = f.read()
+        outputs = {
+            'driver/gigabytekbd_devices.h': gen_header(db),
+            'driver/gigabytemouse_devices.h': gen_mouse_header(db),
+            'driver/gigabytefirefly_devices.h': gen_firefly_header(db),
+            'config/gigabytekbd.conf': gen_config(db),
+            'install_files/udev/99-gigabyte.rules': gen_udev(db),
+            'install_files/hwdb/70-gigabyte-fn.hwdb': gen_hwdb(db),
+            'README.md': gen_readme(db, readme),
+        }
+    except (DatabaseError, KeyError, ValueError, OSError) as e:
+        print(f'gen-devices: {e}', file=sys.stderr)
+        return 1
+
+    stale = []
+    for name, content in outputs.items():
+        path = os.path.join(ROOT, name)
+        try:
+            with open(path) as f:
+                if f.read() == content:
+                    continue
+        except FileNotFoundError:
+            pass
+        stale.append(name)
+        if not args.check:
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            with open(path, 'w') as f:
+                f.write(content)
+
+    if args.check and stale:
+        print(f'gen-devices: out of date, run make generate: {" ".join(stale)}', file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Compile config/gigabytekbd.conf into the binary config gigabytekbd loads
+# as firmware. The format is documented in driver/gigabytekbd_config.h.
+#
+# Copyright (c) 2020 Hemanth Bollamreddi
+
+import argparse
+import re
+import shlex
+import struct
+import sys
+import zlib
+
+MAGIC = 0x434b474f
+VERSION = 2
+MAX_KEYS = 256
+MAX_ENTRIES = 64
+KEY_MAX = 0x2ff
+
+HEADER = struct.Struct('<IHHIIHHHH')
+KEY = struct.Struct('<IHH')
+TOUCHPAD = struct.Struct('<16s8sI')
+MODEL = struct.Struct('<32s32s32s16s32sI')
+
+CAPS = {
+    'backlight': 1 << 0,
+    'touchpad': 1 << 1,
+}
+
+HANDLED_BY_DRIVER = {0x0400007D, 0x0400007E, 0x04000080, 0x04000081}
+
+
+class ConfigError(Exception):
+    pass
+
+
+def load_keycodes(path):
+    codes = {}
+    define = re.compile(r'#define\s+((?:KEY|BTN)_\w+)\s+(\w+)')
+
+    with open(path) as f:
+        for line in f:
+            m = define.match(line)
+            if not m:
+                continue
+            name, value = m.groups()
+            try:
+                codes[name] = int(value, 0)
+            except ValueError:
+                if value in codes:
+                    codes[name] = codes[value]
+    return codes
+
+
+def encode_str(value, size, what):
+    data = value.encode()
+    if len(data) >= size:
+        raise ConfigError(f'{what} "{value}" is longer than {size - 1} bytes')
+    return data
+
+
+def parse_keycode(value, keycodes):
+    if value in keycodes:
+        code = keycodes[value]
+    else:
+        try:
+            code = int(value, 0)
+        except ValueError:
+            raise ConfigError(f'unknown keycode {value}') from None
+    if not 0 < code <= KEY_MAX:
+        raise ConfigError(f'keycode {value} is out of range')
+    return code
+
+
+def parse_model(args):
+    if not args:
+        raise ConfigError('model needs a name')
+    model = {'name': args[0], 'vendor': '', 'product': '', 'touchpad': '',
+             'backlight': '', 'caps': 0}
+
+    for arg in args[1:]:
+        key, sep, value = arg.partition('=')
+        if not sep or key not in model or key == 'name':
+            raise ConfigError(f'unknown model option {arg}')
+        if key == 'caps':
+            for cap in filter(None, value.split(',')):
+                if cap not in CAPS:
+                    raise ConfigError(f'unknown capability {cap}')
+                model['caps'] |= CAPS[cap]
+        else:
+            model[key] = value
+    if model['caps'] & CAPS['backlight'] and not model['backlight']:
+        raise ConfigError(f'model "{model["name"]}" has the backlight capability but no backlight')
+    return model
+
+
+def parse(path, keycodes):
+    keys, touchpads, models = [], [], []
+
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            try:
+                words = shlex.split(line, comments=True)
+                if not words:
+                    continue
+                kind, args = words[0], words[1:]
+                if kind == 'key':
+                    if len(args) != 2:
+                        raise ConfigError('expected key <code> <keycode>')
+                    code = int(args[0], 0)
+                    if code in HANDLED_BY_DRIVER:
+                        raise ConfigError(f'{args[0]} is handled by the driver and can\'t be mapped')
+                    keys.append((code, parse_keycode(args[1], keycodes)))
+                elif kind == 'touchpad':
+                    if len(args) != 3:
+                        raise ConfigError('expected touchpad <hid> <bus id> <instance>')
+                    touchpads.append((args[0], args[1], int(args[2], 0)))
+                elif kind == 'model':
+                    models.append(parse_model(args))
+                else:
+                    raise ConfigError(f'unknown entry {kind}')
+            except (ConfigError, ValueError) as e:
+                raise ConfigError(f'{path}:{lineno}: {e}') from None
+
+    if not keys:
+        raise ConfigError(f'{path}: no keys')
+    if len(keys) > MAX_KEYS:
+        raise ConfigError(f'{path}: more than {MAX_KEYS} keys')
+    if len(touchpads) > MAX_ENTRIES or len(models) > MAX_ENTRIES:
+        raise ConfigError(f'{path}: more than {MAX_ENTRIES} touchpads or models')
+    return keys, touchpads, models
+
+
+def compile_config(keys, touchpads, models):
+    payload = bytearray()
+
+    for code, keycode in keys:
+        payload += KEY.pack(code, keycode, 0)
+    for hid, bid, instance in touchpads:
+        payload += TOUCHPAD.pack(encode_str(hid, 16, 'touchpad HID'),
+                                 encode_str(bid, 8, 'touchpad bus id'), instance)
+    for m in models:
+        payload += MODEL.pack(encode_str(m['vendor'], 32, 'vendor'),
+                              encode_str(m['product'], 32, 'product'),
+                              encode_str(m['name'], 32, 'name'),
+                              encode_str(m['touchpad'], 16, 'touchpad HID'),
+                              encode_str(m['backlight'], 32, 'backlight'),
+                              m['caps'])
+
+    header = HEADER.pack(MAGIC, VERSION, HEADER.size, HEADER.size + len(payload),
+                         zlib.crc32(payload), len(keys), len(touchpads), len(models), 0)
+    return header + payload
+
+
+def cstr(field):
+    return field.split(b'\0', 1)[0].decode()
+
+
+def dump(path):
+    with open(path, 'rb') as f:
+        blob = f.read()
+
+    (magic, version, header_size, size, crc, num_keys, num_touchpads,
+     num_models, _) = HEADER.unpack_from(blob)
+    if magic != MAGIC or size != len(blob):
+        raise ConfigError(f'{path}: not a gigabytekbd config')
+    payload = blob[header_size:]
+    print(f'# version {version}, {size} bytes, crc32 {crc:08x}'
+          f'{"" if zlib.crc32(payload) == crc else " (MISMATCH)"}')
+
+    off = header_size
+    for _ in range(num_keys):
+        code, keycode, _ = KEY.unpack_from(blob, off)
+        print(f'key 0x{code:08X} {keycode}')
+        off += KEY.size
+    for _ in range(num_touchpads):
+        hid, bid, instance = TOUCHPAD.unpack_from(blob, off)
+        print(f'touchpad {cstr(hid)} {cstr(bid)} {instance}')
+        off += TOUCHPAD.size
+    for _ in range(num_models):
+        vendor, product, name, touchpad, backlight, caps = MODEL.unpack_from(blob, off)
+        fields = [shlex.quote(cstr(name))]
+        for key, value in (('vendor', vendor), ('product', product),
+                           ('touchpad', touchpad), ('backlight', backlight)):
+            value = cstr(value)
+            if value:
+                fields.append(f'{key}={shlex.quote(value)}')
+        fields.append('caps=' + ','.join(c for c, bit in CAPS.items() if caps & bit))
+        print('model ' + ' '.join(fields))
+        off += MODEL.size
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compile the gigabytekbd keymap and model config.')
+    parser.add_argument('source', help='config source, or a compiled blob with --dump')
+    parser.add_argument('-o', '--output', help='compiled config (default: gigabytekbd.bin)',
+                        default='gigabytekbd.bin')
+    parser.add_argument('-I', '--input-codes', default='/usr/include/linux/input-event-codes.h',
+                        help='header to resolve KEY_* names from')
+    parser.add_argument('-d', '--dump', action='store_true', help='print a compiled config')
+    args = parser.parse_args()
+
+    try:
+        if args.dump:
+            dump(args.source)
+            return 0
+        blob = compile_config(*parse(args.source, load_keycodes(args.input_codes)))
+    except (ConfigError, OSError) as e:
+        print(f'gigabytekbd-config: {e}', file=sys.stderr)
+        return 1
+
+    with open(args.output, 'wb') as f:
+        f.write(blob)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Fn key report decoding shared by the userspace tools.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "fn_keys.hpp"
+
+#include <linux/input-event-codes.h>
+
+#include "../driver/gigabytekbd_driver.h"
+
+namespace opengigabyte {
+
+namespace {
+
+struct KeymapEntry {
+	std::uint32_t scancode;
+	std::uint16_t keycode;
+};
+
+#define GIGABYTE_KBD_KEY_ENTRY(code, key)	{ code, key },
+
+constexpr KeymapEntry kKeymap[] = {
+	GIGABYTE_KBD_FN_KEYMAP(GIGABYTE_KBD_KEY_ENTRY)
+};
+
+#undef GIGABYTE_KBD_KEY_ENTRY
+
+std::uint16_t keymap_lookup(std::uint32_t scancode)
+{
+	for (const KeymapEntry &entry : kKeymap)
+		if (entry.scancode == scancode)
+			return entry.keycode;
+	return KEY_RESERVED;
+}
+
+} // namespace
+
+FnEvent decode_fn_report(const std::uint8_t *data, std::size_t size)
+{
+	FnEvent ev;
+
+	/* Same check as the kernel: see gigabyte_kbd_handle_raw_event() */
+	if (size != 4 || data[0] != 4)
+		return ev;
+
+	ev.scancode = static_cast<std::uint32_t>(data[0]) << 24 |
+		      static_cast<std::uint32_t>(data[1]) << 16 |
+		      static_cast<std::uint32_t>(data[2]) << 8 | data[3];
+
+	switch (ev.scancode) {
+	case HIDRAW_FN_F3:
+		ev.action = FnAction::Key;
+		ev.keycode = KEY_BRIGHTNESSDOWN;
+		break;
+	case HIDRAW_FN_F4:
+		ev.action = FnAction::Key;
+		ev.keycode = KEY_BRIGHTNESSUP;
+		break;
+	case HIDRAW_FN_F6:
+		ev.action = FnAction::BacklightToggle;
+		break;
+	case HIDRAW_FN_F10:
+		/* Unbinding the touchpad needs the kernel driver; let the DE do it */
+		ev.action = FnAction::Key;
+		ev.keycode = KEY_TOUCHPAD_TOGGLE;
+		break;
+	case HIDRAW_FN_F8_PRESS:
+	case HIDRAW_FN_F9_PRESS:
+		ev.action = FnAction::Press;
+		ev.keycode = keymap_lookup(ev.scancode);
+		break;
+	case HIDRAW_FN_F8_RELEASE:
+	case HIDRAW_FN_F9_RELEASE:
+		ev.action = FnAction::Release;
+		ev.scancode |= HIDRAW_FN_PRESS_FLAG;
+		ev.keycode = keymap_lookup(ev.scancode);
+		break;
+	default:
+		ev.keycode = keymap_lookup(ev.scancode);
+		if (ev.keycode != KEY_RESERVED)
+			ev.action = FnAction::Key;
+		break;
+	}
+	return ev;
+}
+
+std::vector<std::uint16_t> fn_keycodes()
+{
+	std::vector<std::uint16_t> keys = {
+		KEY_BRIGHTNESSDOWN, KEY_BRIGHTNESSUP, KEY_TOUCHPAD_TOGGLE,
+	};
+
+	for (const KeymapEntry &entry : kKeymap)
+		keys.push_back(entry.keycode);
+	return keys;
+}
+
+} // namespace opengigabyte
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Fn key report decoding shared by the userspace tools.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+#ifndef OPENGIGABYTE_FN_KEYS_HPP
+#define OPENGIGABYTE_FN_KEYS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace opengigabyte {
+
+enum class FnAction {
+	None,			/* Not an Fn key report */
+	Key,			/* Press and release of keycode */
+	Press,			/* Separate press of keycode (volume) */
+	Release,		/* Separate release of keycode (volume) */
+	BacklightToggle,	/* Fn+F6 */
+};
+
+struct FnEvent {
+	FnAction action = FnAction::None;
+	std::uint32_t scancode = 0;
+	std::uint16_t keycode = 0;
+};
+
+/*
+ * Decode a raw report 4 exactly like gigabyte_kbd_raw_event() does.
+ * Keys the kernel handles in-kernel (brightness, touchpad) become plain
+ * key events here for the desktop to act on.
+ */
+FnEvent decode_fn_report(const std::uint8_t *data, std::size_t size);
+
+/* Every keycode decode_fn_report() can produce */
+std::vector<std::uint16_t> fn_keycodes();
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_FN_KEYS_HPP */
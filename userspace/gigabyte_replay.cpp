@@ -0,0 +1,521 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Replay tool for gigabytekbd raw report traces
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Reads a trace captured from /sys/kernel/debug/gigabytekbd/trace,
+ * recreates the keyboard as a uhid device so gigabytekbd binds to it and
+ * re-injects the reports at their original inter-arrival times (or as
+ * fast as possible). The evdev events that come out are logged and can
+ * be compared against an expected event log, which makes field bug
+ * reports reproducible in CI.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <endian.h>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../driver/gigabytekbd_capture.h"
+#include "uhid.hpp"
+
+using namespace opengigabyte;
+
+namespace {
+
+/* Devices gigabytekbd creates itself */
+constexpr const char *kDriverInputs[] = { "Gigabyte Fn Keys", "Gigabyte Consumer Control" };
+
+struct Options {
+	std::string trace;
+	std::string descriptor;
+	std::string output;
+	std::string expected;
+	std::uint16_t vendor = 0;
+	std::uint16_t product = 0;
+	std::string device;		/* VID:PID to take from a mixed trace */
+	bool fast = false;
+	bool timestamps = false;
+	unsigned int loops = 1;
+	unsigned int settle_ms = 200;
+};
+
+struct Report {
+	std::uint64_t timestamp;
+	std::uint16_t vendor;
+	std::uint16_t product;
+	std::vector<std::uint8_t> data;
+};
+
+struct LoggedEvent {
+	std::int64_t time_ns;
+	std::string line;
+};
+
+std::vector<Report> load_trace(const std::string &path)
+{
+	std::ifstream in(path, std::ios::binary);
+	std::vector<Report> reports;
+	gigabyte_kbd_capture_record rec;
+	bool warned = false;
+
+	if (!in)
+		throw std::runtime_error(path + ": " + std::strerror(errno));
+	while (in.read(reinterpret_cast<char *>(&rec), sizeof(rec))) {
+		Report r;
+		std::size_t size = le16toh(rec.size);
+		std::size_t captured = std::min<std::size_t>(size, GIGABYTE_KBD_CAPTURE_PAYLOAD);
+
+		r.timestamp = le64toh(rec.timestamp);
+		r.vendor = le16toh(rec.vendor);
+		r.product = le16toh(rec.product);
+		r.data.assign(rec.data, rec.data + captured);
+		if (size > captured) {
+			/* Payload was truncated at capture; pad so the size still matches */
+			r.data.resize(size, 0);
+			if (!warned)
+				std::fprintf(stderr, "warning: some reports were truncated in the trace\n");
+			warned = true;
+		}
+		reports.push_back(std::move(r));
+	}
+	if (in.gcount())
+		std::fprintf(stderr, "warning: ignoring %zd trailing bytes\n",
+			     static_cast<ssize_t>(in.gcount()));
+	return reports;
+}
+
+std::string device_id(std::uint16_t vendor, std::uint16_t product)
+{
+	char id[16];
+
+	std::snprintf(id, sizeof(id), "%04x:%04x", vendor, product);
+	return id;
+}
+
+/*
+ * One uhid device stands in for the keyboard, so a trace that recorded
+ * several keyboards is replayed one device at a time: @device picks it,
+ * and without it such a trace is refused rather than sent to one device.
+ */
+std::vector<Report> select_device(const std::vector<Report> &reports, const std::string &device,
+				  const std::string &path)
+{
+	std::vector<std::pair<std::string, std::size_t>> devices;
+	std::vector<Report> picked;
+	std::string list;
+
+	for (const Report &r : reports) {
+		std::string id = device_id(r.vendor, r.product);
+		auto it = std::find_if(devices.begin(), devices.end(),
+				       [&](const auto &d) { return d.first == id; });
+
+		if (it == devices.end())
+			devices.emplace_back(id, 1);
+		else
+			it->second++;
+		if (id == device)
+			picked.push_back(r);
+	}
+
+	if (device.empty() && devices.size() <= 1)
+		return reports;
+	if (!device.empty() && !picked.empty())
+		return picked;
+
+	for (const auto &d : devices)
+		list += "\n  " + d.first + " (" + std::to_string(d.second) + " reports)";
+	if (device.empty())
+		throw std::runtime_error(path + ": reports of several devices, pick one with -D:" +
+					 list);
+	throw std::runtime_error(path + ": no reports of " + device + ", the trace has:" + list);
+}
+
+std::vector<std::uint8_t> load_descriptor(const std::string &path)
+{
+	std::ifstream in(path, std::ios::binary);
+
+	if (!in)
+		throw std::runtime_error(path + ": " + std::strerror(errno));
+	return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+}
+
+std::vector<std::string> read_lines(const std::string &path)
+{
+	std::ifstream in(path);
+	std::vector<std::string> lines;
+	std::string line;
+
+	if (!in)
+		throw std::runtime_error(path + ": " + std::strerror(errno));
+	while (std::getline(in, line))
+		lines.push_back(line);
+	return lines;
+}
+
+std::string device_name(int fd)
+{
+	char name[256] = "";
+
+	ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+	return name;
+}
+
+std::string type_name(unsigned int type)
+{
+	switch (type) {
+	case EV_SYN: return "EV_SYN";
+	case EV_KEY: return "EV_KEY";
+	case EV_REL: return "EV_REL";
+	case EV_ABS: return "EV_ABS";
+	case EV_MSC: return "EV_MSC";
+	case EV_LED: return "EV_LED";
+	case EV_REP: return "EV_REP";
+	default: return std::to_string(type);
+	}
+}
+
+/* The driver's devices are shared by all interfaces, so they may hang off another one */
+std::string find_event_by_name(const std::string &wanted)
+{
+	DIR *dir = opendir("/dev/input");
+	struct dirent *ent;
+	std::string found;
+
+	if (!dir)
+		return found;
+	while ((ent = readdir(dir)) && found.empty()) {
+		std::string path = std::string("/dev/input/") + ent->d_name;
+		int fd;
+
+		if (std::strncmp(ent->d_name, "event", 5) != 0)
+			continue;
+		fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		if (device_name(fd) == wanted)
+			found = path;
+		close(fd);
+	}
+	closedir(dir);
+	return found;
+}
+
+class EventRecorder {
+public:
+	explicit EventRecorder(const std::vector<std::string> &nodes)
+	{
+		stop_fd_ = eventfd(0, EFD_CLOEXEC);
+		for (const std::string &node : nodes) {
+			int fd = open(node.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+			int clock = CLOCK_MONOTONIC;
+
+			if (fd < 0) {
+				std::fprintf(stderr, "%s: %s\n", node.c_str(), std::strerror(errno));
+				continue;
+			}
+			ioctl(fd, EVIOCSCLOCKID, &clock);
+			fds_.push_back(fd);
+			names_.push_back(device_name(fd));
+		}
+		thread_ = std::thread([this] { run(); });
+	}
+
+	~EventRecorder()
+	{
+		finish();
+		for (int fd : fds_)
+			close(fd);
+		close(stop_fd_);
+	}
+
+	/* Stop reading and return the events ordered by their timestamps */
+	std::vector<LoggedEvent> finish()
+	{
+		std::uint64_t one = 1;
+
+		if (thread_.joinable()) {
+			(void)write(stop_fd_, &one, sizeof(one));
+			thread_.join();
+			std::stable_sort(events_.begin(), events_.end(),
+					 [](const LoggedEvent &a, const LoggedEvent &b) {
+						 return a.time_ns < b.time_ns;
+					 });
+		}
+		return events_;
+	}
+
+private:
+	void run()
+	{
+		std::vector<pollfd> pfds;
+
+		for (int fd : fds_)
+			pfds.push_back({ fd, POLLIN, 0 });
+		pfds.push_back({ stop_fd_, POLLIN, 0 });
+
+		for (;;) {
+			if (poll(pfds.data(), pfds.size(), -1) < 0) {
+				if (errno == EINTR)
+					continue;
+				return;
+			}
+			for (std::size_t i = 0; i < fds_.size(); i++)
+				if (pfds[i].revents & POLLIN)
+					drain(i);
+			if (pfds.back().revents & POLLIN) {
+				/* Pick up anything that raced with the stop request */
+				for (std::size_t i = 0; i < fds_.size(); i++)
+					drain(i);
+				return;
+			}
+		}
+	}
+
+	void drain(std::size_t i)
+	{
+		input_event evs[64];
+		ssize_t len;
+
+		while ((len = read(fds_[i], evs, sizeof(evs))) > 0) {
+			for (std::size_t n = 0; n < len / sizeof(input_event); n++) {
+				const input_event &ev = evs[n];
+				LoggedEvent le;
+
+				le.time_ns = static_cast<std::int64_t>(ev.input_event_sec) * 1000000000 +
+					     static_cast<std::int64_t>(ev.input_event_usec) * 1000;
+				le.line = names_[i] + "\t" + type_name(ev.type) + "\t" +
+					  std::to_string(ev.code) + "\t" + std::to_string(ev.value);
+				events_.push_back(le);
+			}
+		}
+	}
+
+	int stop_fd_ = -1;
+	std::vector<int> fds_;
+	std::vector<std::string> names_;
+	std::vector<LoggedEvent> events_;
+	std::thread thread_;
+};
+
+std::string bound_driver(const UhidDevice &dev)
+{
+	char link[PATH_MAX];
+	ssize_t len = readlink((dev.sysfs_path() + "/driver").c_str(), link, sizeof(link) - 1);
+	std::string driver;
+
+	if (len <= 0)
+		return "";
+	link[len] = '\0';
+	driver = link;
+	return driver.substr(driver.rfind('/') + 1);
+}
+
+void sleep_until(const timespec &ts)
+{
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+		;
+}
+
+timespec add_ns(timespec ts, std::uint64_t ns)
+{
+	ns += ts.tv_nsec;
+	ts.tv_sec += static_cast<time_t>(ns / 1000000000);
+	ts.tv_nsec = static_cast<long>(ns % 1000000000);
+	return ts;
+}
+
+void replay(UhidDevice &dev, const std::vector<Report> &reports, const Options &opt)
+{
+	timespec start;
+	std::uint64_t offset = 0;
+	std::uint64_t span = reports.back().timestamp - reports.front().timestamp;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned int loop = 0; loop < opt.loops; loop++) {
+		for (const Report &r : reports) {
+			if (!opt.fast)
+				sleep_until(add_ns(start, offset + r.timestamp - reports.front().timestamp));
+			dev.input(r.data.data(), r.data.size());
+		}
+		/* Next loop starts 1 ms after the last report of this one */
+		offset += span + 1000000;
+	}
+}
+
+int compare(const std::vector<std::string> &got, const std::vector<std::string> &expected)
+{
+	std::size_t n = std::min(got.size(), expected.size());
+	std::size_t i = 0;
+
+	while (i < n && got[i] == expected[i])
+		i++;
+	if (i == got.size() && i == expected.size()) {
+		std::printf("event log matches (%zu events)\n", got.size());
+		return 0;
+	}
+
+	std::printf("event log differs at line %zu (got %zu events, expected %zu)\n",
+		    i + 1, got.size(), expected.size());
+	for (std::size_t j = i; j < std::min(i + 5, expected.size()); j++)
+		std::printf("- %s\n", expected[j].c_str());
+	for (std::size_t j = i; j < std::min(i + 5, got.size()); j++)
+		std::printf("+ %s\n", got[j].c_str());
+	return 1;
+}
+
+int run(const Options &opt)
+{
+	std::vector<Report> reports = load_trace(opt.trace);
+	std::vector<std::uint8_t> descriptor = opt.descriptor.empty() ?
+		kGigabyteKbdDescriptor : load_descriptor(opt.descriptor);
+	std::string uniq = "gigabyte-replay-" + std::to_string(getpid());
+	std::vector<std::string> nodes, lines;
+	std::string driver;
+
+	if (reports.empty())
+		throw std::runtime_error(opt.trace + ": no reports");
+	reports = select_device(reports, opt.device, opt.trace);
+
+	UhidDevice dev("Gigabyte Keyboard (replay)", uniq, BUS_USB,
+		       opt.vendor ? opt.vendor : reports.front().vendor,
+		       opt.product ? opt.product : reports.front().product, descriptor);
+	dev.wait_started(2000);
+
+	driver = bound_driver(dev);
+	if (driver != "gigabytekbd")
+		std::fprintf(stderr, "warning: bound to %s, not gigabytekbd (module loaded?)\n",
+			     driver.empty() ? "nothing" : driver.c_str());
+
+	/* Give hid-input and gigabytekbd time to register their input devices */
+	std::this_thread::sleep_for(std::chrono::milliseconds(opt.settle_ms));
+	nodes = dev.event_nodes();
+	for (const char *name : kDriverInputs) {
+		std::string node = find_event_by_name(name);
+
+		if (!node.empty() && std::find(nodes.begin(), nodes.end(), node) == nodes.end())
+			nodes.push_back(node);
+	}
+
+	EventRecorder recorder(nodes);
+	replay(dev, reports, opt);
+	/* Work items (backlight, touchpad) and synthesized releases settle */
+	std::this_thread::sleep_for(std::chrono::milliseconds(opt.settle_ms));
+	std::vector<LoggedEvent> events = recorder.finish();
+
+	std::printf("replayed %zu reports x %u, %zu events\n", reports.size(), opt.loops,
+		    events.size());
+
+	for (const LoggedEvent &ev : events) {
+		if (opt.timestamps)
+			lines.push_back(std::to_string(ev.time_ns - events.front().time_ns) + "\t" + ev.line);
+		else
+			lines.push_back(ev.line);
+	}
+
+	if (!opt.output.empty()) {
+		std::ofstream out(opt.output);
+
+		for (const std::string &line : lines)
+			out << line << '\n';
+	}
+	if (!opt.expected.empty())
+		return compare(lines, read_lines(opt.expected));
+	return 0;
+}
+
+void usage(const char *prog)
+{
+	std::fprintf(stderr,
+		     "Usage: %s [options] trace.bin\n"
+		     "  -f            replay as fast as possible instead of original timing\n"
+		     "  -n LOOPS      replay the trace LOOPS times (stress test)\n"
+		     "  -d FILE       binary report descriptor to use for the uhid device\n"
+		     "  -D VID:PID    replay only this device's reports (traces of several)\n"
+		     "  -V VID -P PID override the vendor/product recorded in the trace\n"
+		     "  -o FILE       write the resulting evdev event log to FILE\n"
+		     "  -e FILE       compare the event log with FILE, exit 1 on mismatch\n"
+		     "  -t            prefix logged events with relative timestamps (ns)\n"
+		     "  -s MS         settle time before and after the replay (default 200)\n",
+		     prog);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	int c;
+
+	while ((c = getopt(argc, argv, "fn:d:D:V:P:o:e:ts:h")) != -1) {
+		switch (c) {
+		case 'f':
+			opt.fast = true;
+			break;
+		case 'n':
+			opt.loops = static_cast<unsigned int>(std::max(1, std::atoi(optarg)));
+			break;
+		case 'd':
+			opt.descriptor = optarg;
+			break;
+		case 'D':
+			opt.device = optarg;
+			std::transform(opt.device.begin(), opt.device.end(), opt.device.begin(),
+				       [](unsigned char ch) { return std::tolower(ch); });
+			break;
+		case 'V':
+			opt.vendor = static_cast<std::uint16_t>(std::strtoul(optarg, nullptr, 16));
+			break;
+		case 'P':
+			opt.product = static_cast<std::uint16_t>(std::strtoul(optarg, nullptr, 16));
+			break;
+		case 'o':
+			opt.output = optarg;
+			break;
+		case 'e':
+			opt.expected = optarg;
+			break;
+		case 't':
+			opt.timestamps = true;
+			break;
+		case 's':
+			opt.settle_ms = static_cast<unsigned int>(std::atoi(optarg));
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 2;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 2;
+	}
+	opt.trace = argv[optind];
+
+	try {
+		return run(opt);
+	} catch (const std::exception &e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Userspace driver for Gigabyte Keyboards
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Equivalent of gigabytekbd for systems that can't load out-of-tree
+ * modules. Reads report 4 from the keyboard's hidraw nodes through
+ * io_uring multishot reads and emits the decoded Fn keys through a
+ * uinput device. The process sleeps in io_uring_enter() while idle.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/input.h>
+#include <unistd.h>
+
+#include "../driver/gigabytekbd_driver.h"
+#include "fn_keys.hpp"
+#include "hidraw.hpp"
+#include "io_uring.hpp"
+#include "uinput.hpp"
+
+using namespace opengigabyte;
+
+namespace {
+
+constexpr unsigned int kRingEntries = 16;
+constexpr std::uint16_t kBufferGroup = 0;
+constexpr unsigned int kBufferCount = 32;
+constexpr unsigned int kBufferSize = 64;	/* Largest report we expect */
+
+constexpr char kDeviceName[] = "Gigabyte Fn Keys";
+constexpr char kDevicePhys[] = "gigabytekbd-user/input0";
+
+volatile std::sig_atomic_t stop;
+bool verbose;
+
+struct Source {
+	HidrawNode node;
+	int fd = -1;
+};
+
+void handle_signal(int)
+{
+	stop = 1;
+}
+
+void backlight_toggle()
+{
+	const std::string path = std::string("/sys/class/backlight/")
+		+ GIGABYTE_KBD_BACKLIGHT_DEVICE_NAME + "/bl_power";
+	int power = 0;
+
+	std::ifstream(path) >> power;
+	/* FB_BLANK_UNBLANK = 0, FB_BLANK_POWERDOWN = 4 */
+	std::ofstream(path) << (power == 4 ? 0 : 4);
+}
+
+void handle_report(UinputDevice &out, const std::uint8_t *data, std::size_t size)
+{
+	FnEvent ev = decode_fn_report(data, size);
+
+	switch (ev.action) {
+	case FnAction::Key:
+		out.queue_key(ev.scancode, ev.keycode, 1);
+		out.queue_key(ev.scancode, ev.keycode, 0);
+		break;
+	case FnAction::Press:
+		out.queue_key(ev.scancode, ev.keycode, 1);
+		break;
+	case FnAction::Release:
+		out.queue_key(ev.scancode, ev.keycode, 0);
+		break;
+	case FnAction::BacklightToggle:
+		backlight_toggle();
+		break;
+	case FnAction::None:
+		break;
+	}
+}
+
+std::vector<Source> open_sources(int argc, char **argv)
+{
+	std::vector<HidrawNode> nodes;
+	std::vector<Source> sources;
+
+	if (argc > 0) {
+		for (int i = 0; i < argc; i++) {
+			HidrawNode node;
+
+			if (find_hidraw_node(argv[i], node))
+				nodes.push_back(node);
+			else
+				std::fprintf(stderr, "%s: not a hidraw node\n", argv[i]);
+		}
+	} else {
+		for (const HidrawNode &node : list_hidraw_nodes())
+			if (node.bus == BUS_USB && is_gigabyte_keyboard(node.vendor, node.product))
+				nodes.push_back(node);
+	}
+
+	/* Only the interface carrying report 4 is worth a read */
+	for (const HidrawNode &node : nodes) {
+		Source src;
+
+		if (!hidraw_has_input_report(node, 4))
+			continue;
+		src.node = node;
+		src.fd = open(node.devnode.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if (src.fd < 0) {
+			std::fprintf(stderr, "%s: %s\n", node.devnode.c_str(), std::strerror(errno));
+			continue;
+		}
+		if (verbose)
+			std::fprintf(stderr, "Reading %s (%04x:%04x)\n", node.devnode.c_str(),
+				     node.vendor, node.product);
+		sources.push_back(src);
+	}
+	return sources;
+}
+
+int run(std::vector<Source> &sources)
+{
+	UinputDevice out(kDeviceName, kDevicePhys, sources[0].node.vendor,
+			 sources[0].node.product, fn_keycodes());
+	IoUring ring(kRingEntries);
+	std::size_t open_count = sources.size();
+	bool multishot = true;
+
+	ring.setup_buffers(kBufferGroup, kBufferCount, kBufferSize);
+	for (std::size_t i = 0; i < sources.size(); i++)
+		ring.queue_read(sources[i].fd, i, multishot);
+
+	while (!stop && open_count) {
+		ring.submit_and_wait();
+		ring.drain([&](const io_uring_cqe &cqe) {
+			Source &src = sources[cqe.user_data];
+			bool more = cqe.flags & IORING_CQE_F_MORE;
+
+			if (cqe.flags & IORING_CQE_F_BUFFER) {
+				auto bid = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+				if (cqe.res > 0)
+					handle_report(out, ring.buffer(bid), static_cast<std::size_t>(cqe.res));
+				ring.recycle_buffer(bid);
+			}
+
+			if (cqe.res == -EINVAL && multishot) {
+				/* Kernel predates multishot reads: re-arm after each report */
+				multishot = false;
+				if (verbose)
+					std::fprintf(stderr, "Multishot reads unsupported, using single-shot\n");
+			} else if (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS &&
+						    cqe.res != -EAGAIN && cqe.res != -EINTR)) {
+				std::fprintf(stderr, "%s: %s\n", src.node.devnode.c_str(),
+					     cqe.res ? std::strerror(-cqe.res) : "closed");
+				close(src.fd);
+				src.fd = -1;
+				open_count--;
+				return;
+			}
+			if (!more && src.fd >= 0)
+				ring.queue_read(src.fd, cqe.user_data, multishot);
+		});
+		/* One write for everything decoded in this wakeup */
+		out.flush();
+	}
+
+	for (Source &src : sources)
+		if (src.fd >= 0)
+			close(src.fd);
+	return stop ? 0 : 1;
+}
+
+void usage(const char *prog)
+{
+	std::fprintf(stderr,
+		     "Usage: %s [-v] [/dev/hidrawN...]\n"
+		     "Without arguments every matching Gigabyte keyboard is used.\n", prog);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	struct sigaction sa {};
+	std::vector<Source> sources;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "vh")) != -1) {
+		switch (opt) {
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	/* No SA_RESTART so io_uring_enter() returns and we tear down uinput */
+	sa.sa_handler = handle_signal;
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+
+	try {
+		sources = open_sources(argc - optind, argv + optind);
+		if (sources.empty()) {
+			std::fprintf(stderr, "No Gigabyte keyboard hidraw node found\n");
+			return 1;
+		}
+		return run(sources);
+	} catch (const std::exception &e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}
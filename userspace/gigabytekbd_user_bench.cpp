@@ -0,0 +1,325 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Latency and idle wakeup benchmark for the userspace keyboard driver
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Creates a uhid clone of a Gigabyte keyboard, runs gigabytekbd-user on
+ * its hidraw node and measures:
+ *   - baseline: uhid report -> hid-input -> evdev (kernel only)
+ *   - driver:   uhid report -> hidraw -> gigabytekbd-user -> uinput -> evdev
+ * The difference is the latency the userspace driver adds. Afterwards
+ * the driver is left idle and its context switches are counted.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../driver/gigabytekbd_driver.h"
+#include "hidraw.hpp"
+#include "uhid.hpp"
+
+using namespace opengigabyte;
+
+namespace {
+
+constexpr char kDriverPhys[] = "gigabytekbd-user/input0";
+constexpr double kTargetAddedUs = 100.0;
+
+struct Options {
+	std::string driver = "./gigabytekbd-user";
+	unsigned int samples = 1000;
+	unsigned int idle_seconds = 10;
+	unsigned int interval_us = 1000;
+};
+
+std::int64_t now_ns()
+{
+	timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+int open_evdev(const std::string &path)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	int clock = CLOCK_MONOTONIC;
+
+	if (fd < 0)
+		throw std::runtime_error(path + ": " + std::strerror(errno));
+	ioctl(fd, EVIOCSCLOCKID, &clock);
+	return fd;
+}
+
+bool has_key(int fd, unsigned int key)
+{
+	unsigned long bits[KEY_MAX / (8 * sizeof(unsigned long)) + 1] = {};
+
+	if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(bits)), bits) < 0)
+		return false;
+	return bits[key / (8 * sizeof(unsigned long))] &
+	       (1UL << (key % (8 * sizeof(unsigned long))));
+}
+
+/* Read until @key reaches @value and its frame is synced; returns event time */
+std::int64_t wait_key(int fd, unsigned int key, int value)
+{
+	bool seen = false;
+
+	for (;;) {
+		input_event ev;
+		pollfd pfd = { fd, POLLIN, 0 };
+
+		if (poll(&pfd, 1, 1000) <= 0)
+			throw std::runtime_error("timed out waiting for key event");
+		if (read(fd, &ev, sizeof(ev)) != sizeof(ev))
+			throw std::runtime_error("short evdev read");
+		if (ev.type == EV_KEY && ev.code == key && ev.value == value)
+			seen = true;
+		else if (seen && ev.type == EV_SYN && ev.code == SYN_REPORT)
+			return static_cast<std::int64_t>(ev.input_event_sec) * 1000000000 +
+			       static_cast<std::int64_t>(ev.input_event_usec) * 1000;
+	}
+}
+
+std::string find_event_by_phys(const std::string &phys)
+{
+	DIR *dir = opendir("/sys/class/input");
+	struct dirent *ent;
+	std::string found;
+
+	if (!dir)
+		return found;
+	while ((ent = readdir(dir))) {
+		std::string name = ent->d_name;
+		std::string line;
+
+		if (name.rfind("event", 0) != 0)
+			continue;
+		std::ifstream in("/sys/class/input/" + name + "/device/phys");
+		std::getline(in, line);
+		if (line == phys) {
+			found = "/dev/input/" + name;
+			break;
+		}
+	}
+	closedir(dir);
+	return found;
+}
+
+template <typename Fn>
+std::string wait_for(Fn &&fn)
+{
+	for (int i = 0; i < 200; i++) {
+		std::string found = fn();
+
+		if (!found.empty())
+			return found;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return {};
+}
+
+struct Stats {
+	double min, p50, p99, max;
+};
+
+Stats summarize(std::vector<double> v)
+{
+	std::sort(v.begin(), v.end());
+	return { v.front(), v[v.size() / 2], v[v.size() * 99 / 100], v.back() };
+}
+
+void print_stats(const char *what, const Stats &s)
+{
+	std::printf("%-28s min %8.1f  p50 %8.1f  p99 %8.1f  max %8.1f us\n",
+		    what, s.min, s.p50, s.p99, s.max);
+}
+
+/* Round-trip latency of @samples press/release pairs */
+std::vector<double> measure(UhidDevice &dev, int fd, const Options &opt,
+			    const std::vector<std::uint8_t> &press,
+			    const std::vector<std::uint8_t> &release,
+			    unsigned int key, bool synth_release)
+{
+	std::vector<double> lat;
+
+	lat.reserve(opt.samples);
+	for (unsigned int i = 0; i < opt.samples; i++) {
+		std::int64_t start = now_ns();
+
+		dev.input(press.data(), press.size());
+		wait_key(fd, key, 1);
+		lat.push_back((now_ns() - start) / 1000.0);
+
+		if (synth_release) {
+			wait_key(fd, key, 0);
+		} else {
+			dev.input(release.data(), release.size());
+			wait_key(fd, key, 0);
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(opt.interval_us));
+	}
+	return lat;
+}
+
+unsigned long context_switches(pid_t pid)
+{
+	std::ifstream in("/proc/" + std::to_string(pid) + "/status");
+	std::string line;
+	unsigned long total = 0;
+
+	while (std::getline(in, line))
+		if (line.find("ctxt_switches:") != std::string::npos)
+			total += std::stoul(line.substr(line.find(':') + 1));
+	return total;
+}
+
+int run(const Options &opt)
+{
+	std::string uniq = "gigabytekbd-bench-" + std::to_string(getpid());
+	UhidDevice dev("Gigabyte Keyboard (bench)", uniq, BUS_USB,
+		       USB_VENDOR_ID_GIGABYTE_AERO15XV8, USB_DEVICE_ID_GIGABYTE_AERO15XV8,
+		       kGigabyteKbdDescriptor);
+	std::string hidraw, driver_event;
+	int kernel_fd = -1, driver_fd;
+	Stats base{}, drv;
+	pid_t pid;
+	int status;
+	bool pass;
+
+	dev.wait_started(2000);
+
+	hidraw = wait_for([&] {
+		for (const HidrawNode &node : list_hidraw_nodes())
+			if (node.uniq == uniq)
+				return node.devnode;
+		return std::string();
+	});
+	if (hidraw.empty())
+		throw std::runtime_error("no hidraw node for the uhid device");
+
+	/* Baseline through hid-input's own keyboard device */
+	wait_for([&] { return dev.event_nodes().empty() ? std::string() : std::string("ok"); });
+	for (const std::string &node : dev.event_nodes()) {
+		int fd = open_evdev(node);
+
+		if (has_key(fd, KEY_A)) {
+			kernel_fd = fd;
+			break;
+		}
+		close(fd);
+	}
+	if (kernel_fd >= 0) {
+		base = summarize(measure(dev, kernel_fd, opt,
+					 { 0x01, 0, 0, 0x04, 0, 0, 0, 0, 0 },
+					 { 0x01, 0, 0, 0, 0, 0, 0, 0, 0 }, KEY_A, false));
+		print_stats("baseline (hid-input)", base);
+		close(kernel_fd);
+	}
+
+	pid = fork();
+	if (pid == 0) {
+		execl(opt.driver.c_str(), opt.driver.c_str(), hidraw.c_str(), nullptr);
+		std::perror(opt.driver.c_str());
+		_exit(127);
+	}
+
+	driver_event = wait_for([] { return find_event_by_phys(kDriverPhys); });
+	if (driver_event.empty()) {
+		kill(pid, SIGTERM);
+		waitpid(pid, &status, 0);
+		throw std::runtime_error("gigabytekbd-user did not create its uinput device");
+	}
+	driver_fd = open_evdev(driver_event);
+
+	/* Fn+F2: a single report that the driver turns into press + release */
+	drv = summarize(measure(dev, driver_fd, opt, { 0x04, 0x00, 0x00, 0x7C }, {},
+				KEY_WLAN, true));
+	print_stats("gigabytekbd-user", drv);
+
+	unsigned long before = context_switches(pid);
+	std::this_thread::sleep_for(std::chrono::seconds(opt.idle_seconds));
+	unsigned long after = context_switches(pid);
+	double wakeups = static_cast<double>(after - before) / opt.idle_seconds;
+	std::printf("idle wakeups                 %.2f /s over %u s\n", wakeups, opt.idle_seconds);
+
+	close(driver_fd);
+	kill(pid, SIGTERM);
+	waitpid(pid, &status, 0);
+
+	pass = wakeups == 0;
+	if (kernel_fd >= 0) {
+		double added_p50 = drv.p50 - base.p50;
+		double added_p99 = drv.p99 - base.p99;
+
+		std::printf("added latency                p50 %8.1f  p99 %8.1f us\n",
+			    added_p50, added_p99);
+		pass = pass && added_p99 < kTargetAddedUs;
+	} else {
+		std::printf("added latency                n/a (no hid-input baseline device)\n");
+	}
+	std::printf("target: < %.0f us added, 0 idle wakeups: %s\n", kTargetAddedUs,
+		    pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
+
+void usage(const char *prog)
+{
+	std::fprintf(stderr,
+		     "Usage: %s [-d driver] [-n samples] [-i idle-seconds] [-p interval-us]\n",
+		     prog);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	int c;
+
+	while ((c = getopt(argc, argv, "d:n:i:p:h")) != -1) {
+		switch (c) {
+		case 'd':
+			opt.driver = optarg;
+			break;
+		case 'n':
+			opt.samples = std::max(1, std::atoi(optarg));
+			break;
+		case 'i':
+			opt.idle_seconds = std::max(1, std::atoi(optarg));
+			break;
+		case 'p':
+			opt.interval_us = static_cast<unsigned int>(std::atoi(optarg));
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 2;
+		}
+	}
+
+	try {
+		return run(opt);
+	} catch (const std::exception &e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}
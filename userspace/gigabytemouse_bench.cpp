@@ -0,0 +1,564 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Event throughput benchmark for gigabytemouse
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Binds a uhid mouse to gigabytemouse through new_id, answers the
+ * settings feature report like a mouse would and checks the items below.
+ * The mouse gets the report descriptor of a real one when given with -d,
+ * as captured from /sys/bus/hid/devices/<device>/report_descriptor, and a
+ * made-up one otherwise, which only exercises the driver:
+ *   - the sysfs settings round trip (poll_rate written and read back)
+ *   - that a burst of settings writes is coalesced by the gigabytecore
+ *     queue into fewer transfers, ending with the last value
+ *   - that the profile image is served from the driver's cache and a
+ *     write sends only the chunks that changed
+ *   - that reports sent at the requested rate (1000 Hz by default) all
+ *     reach evdev, at that rate, and how long they take to get there
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../driver/gigabytemouse_driver.h"
+#include "uhid.hpp"
+
+using namespace opengigabyte;
+
+namespace {
+
+constexpr char kDriverDir[] = "/sys/bus/hid/drivers/gigabytemouse";
+constexpr double kMinRateRatio = 0.95;
+
+struct Options {
+	std::uint16_t vendor = 0x1044;
+	std::uint16_t product = 0xfffe;	/* Not a real mouse */
+	unsigned int rate = 1000;
+	unsigned int reports = 5000;
+	std::string descriptor;		/* Captured report descriptor, if any */
+};
+
+std::int64_t now_ns()
+{
+	timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void sleep_until_ns(std::int64_t t)
+{
+	timespec ts = { static_cast<time_t>(t / 1000000000), static_cast<long>(t % 1000000000) };
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+		;
+}
+
+bool write_file(const std::string &path, const std::string &value)
+{
+	std::ofstream out(path);
+
+	out << value;
+	out.flush();
+	return static_cast<bool>(out);
+}
+
+std::string read_file(const std::string &path)
+{
+	std::ifstream in(path);
+	std::string line;
+
+	std::getline(in, line);
+	return line;
+}
+
+std::vector<std::uint8_t> read_descriptor(const std::string &path)
+{
+	std::ifstream in(path, std::ios::binary);
+
+	if (!in)
+		throw std::runtime_error(path + ": " + std::strerror(errno));
+
+	std::vector<std::uint8_t> rd((std::istreambuf_iterator<char>(in)),
+				     std::istreambuf_iterator<char>());
+	if (rd.empty())
+		throw std::runtime_error(path + ": empty report descriptor");
+	return rd;
+}
+
+std::string bound_driver(const UhidDevice &dev)
+{
+	char link[PATH_MAX];
+	ssize_t len = readlink((dev.sysfs_path() + "/driver").c_str(), link, sizeof(link) - 1);
+	std::string driver;
+
+	if (len <= 0)
+		return "";
+	link[len] = '\0';
+	driver = link;
+	return driver.substr(driver.rfind('/') + 1);
+}
+
+/* The settings and profile memory a mouse would keep, served over feature reports */
+class FakeSettings {
+public:
+	FakeSettings()
+	{
+		std::mt19937 rng(1);
+
+		for (auto &b : profile_)
+			b = static_cast<std::uint8_t>(rng());
+
+		report_.report_id = GIGABYTE_MOUSE_SETTINGS_REPORT_ID;
+		report_.lift_off = 2;
+		report_.poll_rate = 500;
+		report_.num_stages = 3;
+		report_.active_stage = 1;
+		report_.dpi[0] = 800;
+		report_.dpi[1] = 1600;
+		report_.dpi[2] = 3200;
+	}
+
+	bool get(std::uint8_t id, std::vector<std::uint8_t> &out)
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		const auto *p = reinterpret_cast<const std::uint8_t *>(&report_);
+
+		if (id == GIGABYTE_MOUSE_PROFILE_REPORT_ID) {
+			p = reinterpret_cast<const std::uint8_t *>(&reply_);
+			out.assign(p, p + sizeof(reply_));
+			return true;
+		}
+		if (id != GIGABYTE_MOUSE_SETTINGS_REPORT_ID)
+			return false;
+		out.assign(p, p + sizeof(report_));
+		return true;
+	}
+
+	bool set(const std::uint8_t *data, std::size_t size)
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+
+		if (size && data[0] == GIGABYTE_MOUSE_PROFILE_REPORT_ID)
+			return set_profile(data, size);
+		if (size < sizeof(report_) || data[0] != GIGABYTE_MOUSE_SETTINGS_REPORT_ID)
+			return false;
+		std::memcpy(&report_, data, sizeof(report_));
+		writes_++;
+		return true;
+	}
+
+	/* Little-endian hosts only, like the rest of the tools */
+	unsigned int poll_rate()
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		return report_.poll_rate;
+	}
+
+	unsigned int active_stage()
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		return report_.active_stage;
+	}
+
+	unsigned int writes()
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		return writes_;
+	}
+
+	unsigned int profile_requests()
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		return profile_requests_;
+	}
+
+	unsigned int profile_writes()
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		return profile_writes_;
+	}
+
+	std::vector<std::uint8_t> profile()
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		return std::vector<std::uint8_t>(profile_, profile_ + sizeof(profile_));
+	}
+
+	/* Writes are queued by the driver, wait for them to land */
+	template <typename Pred>
+	bool wait_for(Pred pred, int timeout_ms = 2000)
+	{
+		for (int i = 0; i < timeout_ms; i++) {
+			if (pred())
+				return true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return pred();
+	}
+
+private:
+	/* Called with lock_ held */
+	bool set_profile(const std::uint8_t *data, std::size_t size)
+	{
+		gigabyte_mouse_profile_report req;
+
+		if (size < sizeof(req))
+			return false;
+		std::memcpy(&req, data, sizeof(req));
+		if (req.len > GIGABYTE_MOUSE_PROFILE_CHUNK ||
+		    req.offset + req.len > GIGABYTE_MOUSE_PROFILE_SIZE)
+			return false;
+
+		profile_requests_++;
+		if (req.op == GIGABYTE_MOUSE_PROFILE_WRITE) {
+			std::memcpy(profile_ + req.offset, req.data, req.len);
+			profile_writes_++;
+			return true;
+		}
+		if (req.op != GIGABYTE_MOUSE_PROFILE_READ)
+			return false;
+
+		/* Answered by the next GET_REPORT */
+		reply_ = req;
+		std::memcpy(reply_.data, profile_ + req.offset, req.len);
+		return true;
+	}
+
+	std::mutex lock_;
+	gigabyte_mouse_settings_report report_{};
+	unsigned int writes_ = 0;
+	std::uint8_t profile_[GIGABYTE_MOUSE_PROFILE_SIZE];
+	gigabyte_mouse_profile_report reply_{};
+	unsigned int profile_requests_ = 0;
+	unsigned int profile_writes_ = 0;
+};
+
+/* Answers the driver's feature report requests until it goes out of scope */
+class ReportServer {
+public:
+	ReportServer(UhidDevice &dev, FakeSettings &settings)
+		: stop_fd_(eventfd(0, EFD_CLOEXEC))
+	{
+		thread_ = std::thread([this, &dev, &settings] {
+			try {
+				dev.serve_reports(stop_fd_,
+					[&](std::uint8_t id, std::vector<std::uint8_t> &r) {
+						return settings.get(id, r);
+					},
+					[&](const std::uint8_t *data, std::size_t size) {
+						return settings.set(data, size);
+					});
+			} catch (const std::exception &e) {
+				std::fprintf(stderr, "report server: %s\n", e.what());
+			}
+		});
+	}
+
+	~ReportServer()
+	{
+		std::uint64_t one = 1;
+
+		(void)write(stop_fd_, &one, sizeof(one));
+		thread_.join();
+		close(stop_fd_);
+	}
+
+	ReportServer(const ReportServer &) = delete;
+	ReportServer &operator=(const ReportServer &) = delete;
+
+private:
+	int stop_fd_;
+	std::thread thread_;
+};
+
+struct Stats {
+	double p50, p99, max;
+};
+
+Stats summarize(std::vector<double> v)
+{
+	if (v.empty())
+		return {};
+	std::sort(v.begin(), v.end());
+	return { v[v.size() / 2], v[v.size() * 99 / 100], v.back() };
+}
+
+bool check_sysfs(const UhidDevice &dev, FakeSettings &settings)
+{
+	std::string dir = dev.sysfs_path();
+	unsigned int writes = settings.writes();
+	bool ok;
+
+	std::printf("poll_rates                   %s\n", read_file(dir + "/poll_rates").c_str());
+	std::printf("dpi_stages                   %s (stage %s)\n",
+		    read_file(dir + "/dpi_stages").c_str(), read_file(dir + "/dpi_stage").c_str());
+
+	ok = write_file(dir + "/poll_rate", "1000") && read_file(dir + "/poll_rate") == "1000" &&
+	     settings.wait_for([&] { return settings.poll_rate() == 1000; }) &&
+	     settings.writes() == writes + 1;
+	std::printf("poll_rate 500 -> 1000        %s\n", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+bool check_coalescing(const UhidDevice &dev, FakeSettings &settings)
+{
+	constexpr unsigned int kWrites = 100;
+	std::string path = dev.sysfs_path() + "/dpi_stage";
+	unsigned int writes = settings.writes(), sent;
+	std::int64_t start = now_ns(), queued;
+	bool ok = true;
+
+	for (unsigned int i = 0; i < kWrites; i++)
+		ok = write_file(path, std::to_string(i % 3)) && ok;
+	queued = now_ns();
+
+	/* The last write must land; how many before it did is up to the queue */
+	ok = settings.wait_for([&] { return settings.active_stage() == (kWrites - 1) % 3; }) && ok;
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	sent = settings.writes() - writes;
+
+	std::printf("dpi_stage x %u                %u transfers, %.1f us per store, %s\n",
+		    kWrites, sent, (queued - start) / 1000.0 / kWrites, ok ? "ok" : "FAILED");
+	return ok && sent <= kWrites;
+}
+
+std::vector<std::uint8_t> read_profile(const std::string &path)
+{
+	std::vector<std::uint8_t> image(GIGABYTE_MOUSE_PROFILE_SIZE);
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	ssize_t n;
+
+	if (fd < 0)
+		throw std::runtime_error(path + ": " + std::strerror(errno));
+	n = pread(fd, image.data(), image.size(), 0);
+	close(fd);
+	image.resize(n > 0 ? n : 0);
+	return image;
+}
+
+bool write_profile(const std::string &path, const std::vector<std::uint8_t> &image)
+{
+	int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+	bool ok;
+
+	if (fd < 0)
+		return false;
+	ok = pwrite(fd, image.data(), image.size(), 0) == static_cast<ssize_t>(image.size());
+	close(fd);
+	return ok;
+}
+
+bool check_profile(const UhidDevice &dev, FakeSettings &settings)
+{
+	std::string path = dev.sysfs_path() + "/profile";
+	std::vector<std::uint8_t> image;
+	unsigned int requests, writes;
+	std::int64_t start, first, second;
+	bool ok;
+
+	/* The first read waits for the load probe started, the second is cached */
+	start = now_ns();
+	image = read_profile(path);
+	first = now_ns() - start;
+	requests = settings.profile_requests();
+	start = now_ns();
+	ok = read_profile(path) == image && image == settings.profile();
+	second = now_ns() - start;
+	ok = ok && settings.profile_requests() == requests;
+	std::printf("profile read                 %.1f us first, %.1f us cached, %s\n",
+		    first / 1000.0, second / 1000.0, ok ? "ok" : "FAILED");
+
+	/* Like a tool would: change a few bytes, write the whole image back */
+	writes = settings.profile_writes();
+	image[100] ^= 0xff;
+	image[120] ^= 0xff;
+	image[150] ^= 0xff;
+	image[3000] ^= 0xff;
+	ok = write_profile(path, image) &&
+	     settings.wait_for([&] { return settings.profile() == image; }) && ok;
+	std::printf("profile write, 4 bytes       %u transfers (expect 2), %s\n",
+		    settings.profile_writes() - writes, ok ? "ok" : "FAILED");
+	return ok && settings.profile_writes() - writes == 2;
+}
+
+bool measure(UhidDevice &dev, const std::string &node, const Options &opt)
+{
+	std::vector<std::int64_t> sent(opt.reports), stamped, received;
+	std::vector<double> latency, gaps;
+	int fd = open(node.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	int clock = CLOCK_MONOTONIC;
+	int stop_fd = eventfd(0, EFD_CLOEXEC);
+	std::uint64_t one = 1;
+	double rate;
+
+	if (fd < 0)
+		throw std::runtime_error(node + ": " + std::strerror(errno));
+	ioctl(fd, EVIOCSCLOCKID, &clock);
+	stamped.reserve(opt.reports);
+	received.reserve(opt.reports);
+
+	std::thread reader([&] {
+		pollfd pfds[2] = { { fd, POLLIN, 0 }, { stop_fd, POLLIN, 0 } };
+		input_event evs[64];
+		bool moved = false;
+
+		while (poll(pfds, 2, -1) > 0 && !pfds[1].revents) {
+			ssize_t n = read(fd, evs, sizeof(evs));
+			std::int64_t t = now_ns();
+
+			for (ssize_t i = 0; i < n / static_cast<ssize_t>(sizeof(evs[0])); i++) {
+				if (evs[i].type == EV_REL && evs[i].code == REL_X) {
+					moved = true;
+				} else if (moved && evs[i].type == EV_SYN && evs[i].code == SYN_REPORT) {
+					stamped.push_back(static_cast<std::int64_t>(evs[i].input_event_sec) *
+							  1000000000 + evs[i].input_event_usec * 1000LL);
+					received.push_back(t);
+					moved = false;
+				}
+			}
+		}
+	});
+
+	/* One count right per report: zero motion would be filtered out */
+	std::int64_t period = 1000000000LL / opt.rate;
+	std::int64_t next = now_ns() + 10000000;
+	std::uint8_t report[] = { 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00 };
+
+	for (unsigned int i = 0; i < opt.reports; i++, next += period) {
+		sleep_until_ns(next);
+		sent[i] = now_ns();
+		dev.input(report, sizeof(report));
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	(void)write(stop_fd, &one, sizeof(one));
+	reader.join();
+	close(stop_fd);
+	close(fd);
+
+	for (std::size_t i = 0; i < received.size() && i < sent.size(); i++)
+		latency.push_back((received[i] - sent[i]) / 1000.0);
+	for (std::size_t i = 1; i < stamped.size(); i++)
+		gaps.push_back((stamped[i] - stamped[i - 1]) / 1000.0);
+	rate = stamped.size() > 1 ?
+	       (stamped.size() - 1) * 1e9 / (stamped.back() - stamped.front()) : 0;
+
+	Stats lat = summarize(latency), gap = summarize(gaps);
+	std::printf("reports                      %zu of %u delivered\n", stamped.size(), opt.reports);
+	std::printf("event rate                   %.0f Hz (target %u Hz)\n", rate, opt.rate);
+	std::printf("event interval               p50 %8.1f  p99 %8.1f  max %8.1f us\n",
+		    gap.p50, gap.p99, gap.max);
+	std::printf("report -> read() latency     p50 %8.1f  p99 %8.1f  max %8.1f us\n",
+		    lat.p50, lat.p99, lat.max);
+
+	return stamped.size() == opt.reports && rate >= opt.rate * kMinRateRatio;
+}
+
+int run(const Options &opt)
+{
+	std::string uniq = "gigabytemouse-bench-" + std::to_string(getpid());
+	char id[32];
+	FakeSettings settings;
+	std::vector<std::string> nodes;
+	bool pass;
+
+	if (access(kDriverDir, F_OK))
+		throw std::runtime_error("gigabytemouse is not loaded");
+
+	/* Bind before the device exists so hid-generic never takes it */
+	std::snprintf(id, sizeof(id), "%04x %04x %04x", BUS_USB, opt.vendor, opt.product);
+	write_file(std::string(kDriverDir) + "/new_id", id);
+
+	std::vector<std::uint8_t> rd = opt.descriptor.empty() ? kGigabyteMouseDescriptor :
+				       read_descriptor(opt.descriptor);
+	std::printf("descriptor                   %s\n",
+		    opt.descriptor.empty() ? "made up (not a real mouse)" : opt.descriptor.c_str());
+
+	UhidDevice dev("Gigabyte Mouse (bench)", uniq, BUS_USB, opt.vendor, opt.product, rd);
+	dev.wait_started(2000);
+
+	ReportServer server(dev, settings);
+
+	for (int i = 0; i < 200 && (nodes = dev.event_nodes()).empty(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	if (bound_driver(dev) != "gigabytemouse")
+		throw std::runtime_error("uhid mouse is not bound to gigabytemouse");
+	if (nodes.empty())
+		throw std::runtime_error("no input device for the uhid mouse");
+
+	pass = check_sysfs(dev, settings);
+	pass = check_coalescing(dev, settings) && pass;
+	pass = check_profile(dev, settings) && pass;
+	pass = measure(dev, nodes.front(), opt) && pass;
+
+	std::printf("target: every report delivered at >= %.0f%% of %u Hz: %s\n",
+		    kMinRateRatio * 100, opt.rate, pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
+
+void usage(const char *prog)
+{
+	std::fprintf(stderr,
+		     "Usage: %s [-r rate-hz] [-n reports] [-d report-descriptor] [-V vid] [-P pid]\n",
+		     prog);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	int c;
+
+	while ((c = getopt(argc, argv, "r:n:d:V:P:h")) != -1) {
+		switch (c) {
+		case 'r':
+			opt.rate = std::max(1, std::atoi(optarg));
+			break;
+		case 'n':
+			opt.reports = std::max(2, std::atoi(optarg));
+			break;
+		case 'd':
+			opt.descriptor = optarg;
+			break;
+		case 'V':
+			opt.vendor = static_cast<std::uint16_t>(std::strtoul(optarg, nullptr, 16));
+			break;
+		case 'P':
+			opt.product = static_cast<std::uint16_t>(std::strtoul(optarg, nullptr, 16));
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 2;
+		}
+	}
+
+	try {
+		return run(opt);
+	} catch (const std::exception &e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * hidraw node discovery for the userspace keyboard driver.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "hidraw.hpp"
+
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+
+#include "../driver/gigabytekbd_driver.h"
+
+namespace opengigabyte {
+
+namespace {
+
+const char kHidrawClass[] = "/sys/class/hidraw";
+
+/* HID_ID=0003:00001044:00007A39 and HID_UNIQ= from the hid device uevent */
+bool parse_uevent(const std::string &path, HidrawNode &node)
+{
+	std::ifstream in(path);
+	std::string line;
+	bool have_id = false;
+
+	while (std::getline(in, line)) {
+		unsigned int bus, vendor, product;
+
+		if (std::sscanf(line.c_str(), "HID_ID=%x:%x:%x", &bus, &vendor, &product) == 3) {
+			node.bus = static_cast<std::uint16_t>(bus);
+			node.vendor = static_cast<std::uint16_t>(vendor);
+			node.product = static_cast<std::uint16_t>(product);
+			have_id = true;
+		} else if (line.rfind("HID_UNIQ=", 0) == 0) {
+			node.uniq = line.substr(9);
+		}
+	}
+	return have_id;
+}
+
+bool load_node(const std::string &name, HidrawNode &node)
+{
+	node.devnode = "/dev/" + name;
+	node.sysfs = std::string(kHidrawClass) + "/" + name + "/device";
+	return parse_uevent(node.sysfs + "/uevent", node);
+}
+
+} // namespace
+
+std::vector<HidrawNode> list_hidraw_nodes()
+{
+	std::vector<HidrawNode> nodes;
+	DIR *dir = opendir(kHidrawClass);
+	struct dirent *ent;
+
+	if (!dir)
+		return nodes;
+	while ((ent = readdir(dir))) {
+		HidrawNode node;
+
+		if (std::string(ent->d_name).rfind("hidraw", 0) != 0)
+			continue;
+		if (load_node(ent->d_name, node))
+			nodes.push_back(node);
+	}
+	closedir(dir);
+	return nodes;
+}
+
+bool find_hidraw_node(const std::string &devnode, HidrawNode &node)
+{
+	std::string::size_type slash = devnode.rfind('/');
+
+	return load_node(devnode.substr(slash == std::string::npos ? 0 : slash + 1), node);
+}
+
+bool hidraw_has_input_report(const HidrawNode &node, std::uint8_t report_id)
+{
+	std::ifstream in(node.sysfs + "/report_descriptor", std::ios::binary);
+	std::string rd((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	std::uint8_t current_id = 0;
+	std::size_t i = 0;
+
+	/* Walk the short items; long items (0xfe) are skipped whole */
+	while (i < rd.size()) {
+		auto prefix = static_cast<std::uint8_t>(rd[i]);
+		std::size_t size = prefix & 0x03;
+		std::uint32_t value = 0;
+
+		if (prefix == 0xfe) {
+			if (i + 1 >= rd.size())
+				break;
+			i += 3 + static_cast<std::uint8_t>(rd[i + 1]);
+			continue;
+		}
+		if (size == 3)
+			size = 4;
+		if (i + 1 + size > rd.size())
+			break;
+		for (std::size_t b = 0; b < size; b++)
+			value |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(rd[i + 1 + b])) << (8 * b);
+
+		switch (prefix & 0xfc) {
+		case 0x84:	/* Global: Report ID */
+			current_id = static_cast<std::uint8_t>(value);
+			break;
+		case 0x80:	/* Main: Input */
+			if (current_id == report_id)
+				return true;
+			break;
+		}
+		i += 1 + size;
+	}
+	return false;
+}
+
+bool is_gigabyte_keyboard(std::uint16_t vendor, std::uint16_t product)
+{
+#define GIGABYTE_KBD_MATCH(v, p)	if (vendor == (v) && product == (p)) return true;
+	GIGABYTE_KBD_USB_DEVICES(GIGABYTE_KBD_MATCH)
+#undef GIGABYTE_KBD_MATCH
+	return false;
+}
+
+} // namespace opengigabyte
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * hidraw node discovery for the userspace keyboard driver.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+#ifndef OPENGIGABYTE_HIDRAW_HPP
+#define OPENGIGABYTE_HIDRAW_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace opengigabyte {
+
+struct HidrawNode {
+	std::string devnode;		/* /dev/hidrawN */
+	std::string sysfs;		/* /sys/class/hidraw/hidrawN/device */
+	std::uint16_t bus = 0;
+	std::uint16_t vendor = 0;
+	std::uint16_t product = 0;
+	std::string uniq;
+};
+
+/* All hidraw nodes currently present, with their HID ids */
+std::vector<HidrawNode> list_hidraw_nodes();
+
+/* Look up a single node by its /dev path */
+bool find_hidraw_node(const std::string &devnode, HidrawNode &node);
+
+/* True if the node's report descriptor declares input report @report_id */
+bool hidraw_has_input_report(const HidrawNode &node, std::uint8_t report_id);
+
+/* Whether @vendor:@product is one of the keyboards gigabytekbd binds to */
+bool is_gigabyte_keyboard(std::uint16_t vendor, std::uint16_t product);
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_HIDRAW_HPP */
@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Minimal io_uring wrapper for the userspace keyboard driver.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "io_uring.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace opengigabyte {
+
+namespace {
+
+int sys_io_uring_setup(unsigned int entries, io_uring_params *p)
+{
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sys_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete,
+		       unsigned int flags)
+{
+	return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+					min_complete, flags, nullptr, 0));
+}
+
+int sys_io_uring_register(int fd, unsigned int opcode, void *arg, unsigned int nr_args)
+{
+	return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+[[noreturn]] void throw_errno(const char *what)
+{
+	throw std::system_error(errno, std::generic_category(), what);
+}
+
+void *map_ring(int fd, std::size_t len, off_t offset)
+{
+	void *ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, offset);
+
+	if (ptr == MAP_FAILED)
+		throw_errno("io_uring mmap");
+	return ptr;
+}
+
+template <typename T>
+T *ring_field(void *base, std::uint32_t offset)
+{
+	return reinterpret_cast<T *>(static_cast<std::uint8_t *>(base) + offset);
+}
+
+} // namespace
+
+IoUring::IoUring(unsigned int entries)
+{
+	io_uring_params p{};
+
+	/*
+	 * Completions are only reaped from io_uring_enter(), so defer task
+	 * work until then: the kernel never interrupts us for bookkeeping
+	 * and an idle ring costs no wakeups at all.
+	 */
+	p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+	fd_ = sys_io_uring_setup(entries, &p);
+	if (fd_ < 0 && errno == EINVAL) {
+		p = io_uring_params{};
+		fd_ = sys_io_uring_setup(entries, &p);
+	}
+	if (fd_ < 0)
+		throw_errno("io_uring_setup");
+	features_ = p.features;
+
+	sq_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+	if (features_ & IORING_FEAT_SINGLE_MMAP) {
+		sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+		sq_ptr_ = cq_ptr_ = map_ring(fd_, sq_len_, IORING_OFF_SQ_RING);
+	} else {
+		sq_ptr_ = map_ring(fd_, sq_len_, IORING_OFF_SQ_RING);
+		cq_ptr_ = map_ring(fd_, cq_len_, IORING_OFF_CQ_RING);
+	}
+	sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+	sqes_ = static_cast<io_uring_sqe *>(map_ring(fd_, sqes_len_, IORING_OFF_SQES));
+
+	sq_tail_ = ring_field<unsigned int>(sq_ptr_, p.sq_off.tail);
+	sq_array_ = ring_field<unsigned int>(sq_ptr_, p.sq_off.array);
+	sq_mask_ = *ring_field<unsigned int>(sq_ptr_, p.sq_off.ring_mask);
+	sq_entries_ = p.sq_entries;
+	sq_local_tail_ = *sq_tail_;
+
+	cq_head_ = ring_field<unsigned int>(cq_ptr_, p.cq_off.head);
+	cq_tail_ = ring_field<unsigned int>(cq_ptr_, p.cq_off.tail);
+	cq_mask_ = *ring_field<unsigned int>(cq_ptr_, p.cq_off.ring_mask);
+	cqes_ = ring_field<io_uring_cqe>(cq_ptr_, p.cq_off.cqes);
+}
+
+IoUring::~IoUring()
+{
+	if (buf_ring_)
+		munmap(buf_ring_, buf_ring_len_);
+	if (sqes_)
+		munmap(sqes_, sqes_len_);
+	if (cq_ptr_ && cq_ptr_ != sq_ptr_)
+		munmap(cq_ptr_, cq_len_);
+	if (sq_ptr_)
+		munmap(sq_ptr_, sq_len_);
+	if (fd_ >= 0)
+		close(fd_);
+}
+
+void IoUring::setup_buffers(std::uint16_t group, unsigned int count, unsigned int size)
+{
+	io_uring_buf_reg reg{};
+	std::size_t ring_len = count * sizeof(io_uring_buf);
+
+	if (!count || (count & (count - 1)) || count > 32768)
+		throw std::invalid_argument("buffer count must be a power of two");
+
+	/* Ring entries and the buffers themselves share one mapping */
+	buf_ring_len_ = ring_len + static_cast<std::size_t>(count) * size;
+	void *mem = mmap(nullptr, buf_ring_len_, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (mem == MAP_FAILED)
+		throw_errno("buffer ring mmap");
+	buf_ring_ = static_cast<io_uring_buf *>(mem);
+	buf_base_ = static_cast<std::uint8_t *>(mem) + ring_len;
+	buf_group_ = group;
+	buf_count_ = count;
+	buf_size_ = size;
+
+	reg.ring_addr = reinterpret_cast<std::uint64_t>(mem);
+	reg.ring_entries = count;
+	reg.bgid = group;
+	if (sys_io_uring_register(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+		throw_errno("IORING_REGISTER_PBUF_RING");
+
+	for (unsigned int i = 0; i < count; i++)
+		recycle_buffer(static_cast<std::uint16_t>(i));
+}
+
+std::uint8_t *IoUring::buffer(std::uint16_t bid) const
+{
+	return buf_base_ + static_cast<std::size_t>(bid) * buf_size_;
+}
+
+void IoUring::recycle_buffer(std::uint16_t bid)
+{
+	io_uring_buf *buf = &buf_ring_[buf_tail_ & (buf_count_ - 1)];
+	/* The ring tail overlays the reserved field of the first entry */
+	auto *tail = reinterpret_cast<std::uint16_t *>(
+		reinterpret_cast<std::uint8_t *>(buf_ring_) + offsetof(io_uring_buf, resv));
+
+	buf->addr = reinterpret_cast<std::uint64_t>(buffer(bid));
+	buf->len = buf_size_;
+	buf->bid = bid;
+	buf_tail_++;
+	__atomic_store_n(tail, buf_tail_, __ATOMIC_RELEASE);
+}
+
+io_uring_sqe *IoUring::get_sqe()
+{
+	io_uring_sqe *sqe;
+
+	if (to_submit_ >= sq_entries_)
+		submit(0);
+	sqe = &sqes_[sq_local_tail_ & sq_mask_];
+	std::memset(sqe, 0, sizeof(*sqe));
+	sq_array_[sq_local_tail_ & sq_mask_] = sq_local_tail_ & sq_mask_;
+	sq_local_tail_++;
+	to_submit_++;
+	return sqe;
+}
+
+void IoUring::queue_read(int fd, std::uint64_t user_data, bool multishot)
+{
+	io_uring_sqe *sqe = get_sqe();
+
+	sqe->opcode = multishot ? kOpReadMultishot
+				: static_cast<std::uint8_t>(IORING_OP_READ);
+	sqe->fd = fd;
+	sqe->off = static_cast<std::uint64_t>(-1);	/* Current position */
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = buf_group_;
+	sqe->len = multishot ? 0 : buf_size_;
+	sqe->user_data = user_data;
+}
+
+int IoUring::submit_and_wait()
+{
+	return submit(1);
+}
+
+int IoUring::submit(unsigned int wait_nr)
+{
+	unsigned int submit = to_submit_;
+	int ret;
+
+	__atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+	ret = sys_io_uring_enter(fd_, submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+	if (ret < 0) {
+		/* Interrupted before anything was submitted; let the caller retry */
+		if (errno == EINTR)
+			return 0;
+		throw_errno("io_uring_enter");
+	}
+	to_submit_ -= std::min(submit, static_cast<unsigned int>(ret));
+	return ret;
+}
+
+} // namespace opengigabyte
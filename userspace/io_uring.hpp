@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Minimal io_uring wrapper for the userspace keyboard driver.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ *
+ * Only what the driver needs: one ring, one provided buffer ring and
+ * (multishot) buffer-select reads. Talks to the kernel through raw
+ * syscalls so the build has no dependency on liburing.
+ */
+#ifndef OPENGIGABYTE_IO_URING_HPP
+#define OPENGIGABYTE_IO_URING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+namespace opengigabyte {
+
+/* IORING_OP_READ_MULTISHOT (Linux 6.7) is missing from older uapi headers */
+constexpr std::uint8_t kOpReadMultishot = 49;
+
+class IoUring {
+public:
+	explicit IoUring(unsigned int entries);
+	~IoUring();
+
+	IoUring(const IoUring &) = delete;
+	IoUring &operator=(const IoUring &) = delete;
+
+	/* Register @count buffers of @size bytes as buffer group @group */
+	void setup_buffers(std::uint16_t group, unsigned int count, unsigned int size);
+	std::uint8_t *buffer(std::uint16_t bid) const;
+	void recycle_buffer(std::uint16_t bid);
+
+	/* Queue a buffer-select read; multishot keeps it armed until it fails */
+	void queue_read(int fd, std::uint64_t user_data, bool multishot);
+
+	/* Submit queued SQEs and block until at least one completion arrives */
+	int submit_and_wait();
+
+	/* Call fn(const io_uring_cqe &) for every pending completion */
+	template <typename Fn>
+	unsigned int drain(Fn &&fn)
+	{
+		unsigned int head = *cq_head_;
+		unsigned int tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+		unsigned int n = 0;
+
+		for (; head != tail; head++, n++)
+			fn(cqes_[head & cq_mask_]);
+		__atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+		return n;
+	}
+
+private:
+	io_uring_sqe *get_sqe();
+	int submit(unsigned int wait_nr);
+
+	int fd_ = -1;
+	std::uint32_t features_ = 0;
+
+	void *sq_ptr_ = nullptr;
+	std::size_t sq_len_ = 0;
+	void *cq_ptr_ = nullptr;
+	std::size_t cq_len_ = 0;
+	io_uring_sqe *sqes_ = nullptr;
+	std::size_t sqes_len_ = 0;
+
+	unsigned int *sq_tail_ = nullptr;
+	unsigned int *sq_array_ = nullptr;
+	unsigned int sq_mask_ = 0;
+	unsigned int sq_entries_ = 0;
+	unsigned int sq_local_tail_ = 0;
+	unsigned int to_submit_ = 0;
+
+	unsigned int *cq_head_ = nullptr;
+	unsigned int *cq_tail_ = nullptr;
+	unsigned int cq_mask_ = 0;
+	io_uring_cqe *cqes_ = nullptr;
+
+	io_uring_buf *buf_ring_ = nullptr;
+	std::size_t buf_ring_len_ = 0;
+	std::uint8_t *buf_base_ = nullptr;
+	std::uint16_t buf_group_ = 0;
+	unsigned int buf_count_ = 0;
+	unsigned int buf_size_ = 0;
+	std::uint16_t buf_tail_ = 0;
+};
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_IO_URING_HPP */
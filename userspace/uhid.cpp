@@ -0,0 +1,326 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * uhid virtual HID device helper for the benchmarks and replay tool.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "uhid.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/uhid.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace opengigabyte {
+
+const std::vector<std::uint8_t> kGigabyteKbdDescriptor = {
+	0x05, 0x01,		/* Usage Page (Generic Desktop) */
+	0x09, 0x06,		/* Usage (Keyboard) */
+	0xa1, 0x01,		/* Collection (Application) */
+	0x85, 0x01,		/*   Report ID (1) */
+	0x05, 0x07,		/*   Usage Page (Keyboard) */
+	0x19, 0xe0,		/*   Usage Minimum (Left Control) */
+	0x29, 0xe7,		/*   Usage Maximum (Right GUI) */
+	0x15, 0x00,		/*   Logical Minimum (0) */
+	0x25, 0x01,		/*   Logical Maximum (1) */
+	0x75, 0x01,		/*   Report Size (1) */
+	0x95, 0x08,		/*   Report Count (8) */
+	0x81, 0x02,		/*   Input (Data,Var,Abs) */
+	0x95, 0x01,		/*   Report Count (1) */
+	0x75, 0x08,		/*   Report Size (8) */
+	0x81, 0x01,		/*   Input (Const) */
+	0x95, 0x06,		/*   Report Count (6) */
+	0x75, 0x08,		/*   Report Size (8) */
+	0x15, 0x00,		/*   Logical Minimum (0) */
+	0x25, 0x65,		/*   Logical Maximum (101) */
+	0x19, 0x00,		/*   Usage Minimum (0) */
+	0x29, 0x65,		/*   Usage Maximum (101) */
+	0x81, 0x00,		/*   Input (Data,Array) */
+	0xc0,			/* End Collection */
+
+	0x05, 0x0c,		/* Usage Page (Consumer) */
+	0x09, 0x01,		/* Usage (Consumer Control) */
+	0xa1, 0x01,		/* Collection (Application) */
+	0x85, 0x03,		/*   Report ID (3) */
+	0x19, 0x00,		/*   Usage Minimum (0) */
+	0x2a, 0x3c, 0x02,	/*   Usage Maximum (AC Format) */
+	0x15, 0x00,		/*   Logical Minimum (0) */
+	0x26, 0x3c, 0x02,	/*   Logical Maximum (572) */
+	0x75, 0x10,		/*   Report Size (16) */
+	0x95, 0x01,		/*   Report Count (1) */
+	0x81, 0x00,		/*   Input (Data,Array) */
+	0x75, 0x08,		/*   Report Size (8) */
+	0x81, 0x01,		/*   Input (Const) */
+	0xc0,			/* End Collection */
+
+	0x06, 0x00, 0xff,	/* Usage Page (Vendor 0xff00) */
+	0x09, 0x01,		/* Usage (1) */
+	0xa1, 0x01,		/* Collection (Application) */
+	0x85, 0x04,		/*   Report ID (4) */
+	0x15, 0x00,		/*   Logical Minimum (0) */
+	0x26, 0xff, 0x00,	/*   Logical Maximum (255) */
+	0x75, 0x08,		/*   Report Size (8) */
+	0x95, 0x03,		/*   Report Count (3) */
+	0x09, 0x02,		/*   Usage (2) */
+	0x81, 0x02,		/*   Input (Data,Var,Abs) */
+	0xc0,			/* End Collection */
+};
+
+const std::vector<std::uint8_t> kGigabyteMouseDescriptor = {
+	0x05, 0x01,		/* Usage Page (Generic Desktop) */
+	0x09, 0x02,		/* Usage (Mouse) */
+	0xa1, 0x01,		/* Collection (Application) */
+	0x85, 0x01,		/*   Report ID (1) */
+	0x09, 0x01,		/*   Usage (Pointer) */
+	0xa1, 0x00,		/*   Collection (Physical) */
+	0x05, 0x09,		/*     Usage Page (Button) */
+	0x19, 0x01,		/*     Usage Minimum (1) */
+	0x29, 0x05,		/*     Usage Maximum (5) */
+	0x15, 0x00,		/*     Logical Minimum (0) */
+	0x25, 0x01,		/*     Logical Maximum (1) */
+	0x95, 0x05,		/*     Report Count (5) */
+	0x75, 0x01,		/*     Report Size (1) */
+	0x81, 0x02,		/*     Input (Data,Var,Abs) */
+	0x95, 0x01,		/*     Report Count (1) */
+	0x75, 0x03,		/*     Report Size (3) */
+	0x81, 0x01,		/*     Input (Const) */
+	0x05, 0x01,		/*     Usage Page (Generic Desktop) */
+	0x09, 0x30,		/*     Usage (X) */
+	0x09, 0x31,		/*     Usage (Y) */
+	0x16, 0x01, 0x80,	/*     Logical Minimum (-32767) */
+	0x26, 0xff, 0x7f,	/*     Logical Maximum (32767) */
+	0x75, 0x10,		/*     Report Size (16) */
+	0x95, 0x02,		/*     Report Count (2) */
+	0x81, 0x06,		/*     Input (Data,Var,Rel) */
+	0x09, 0x38,		/*     Usage (Wheel) */
+	0x15, 0x81,		/*     Logical Minimum (-127) */
+	0x25, 0x7f,		/*     Logical Maximum (127) */
+	0x75, 0x08,		/*     Report Size (8) */
+	0x95, 0x01,		/*     Report Count (1) */
+	0x81, 0x06,		/*     Input (Data,Var,Rel) */
+	0xc0,			/*   End Collection */
+	0xc0,			/* End Collection */
+
+	0x06, 0x00, 0xff,	/* Usage Page (Vendor 0xff00) */
+	0x09, 0x01,		/* Usage (1) */
+	0xa1, 0x01,		/* Collection (Application) */
+	0x85, 0x0b,		/*   Report ID (GIGABYTE_MOUSE_SETTINGS_REPORT_ID) */
+	0x15, 0x00,		/*   Logical Minimum (0) */
+	0x26, 0xff, 0x00,	/*   Logical Maximum (255) */
+	0x75, 0x08,		/*   Report Size (8) */
+	0x95, 0x1f,		/*   Report Count (31) */
+	0x09, 0x02,		/*   Usage (2) */
+	0xb1, 0x02,		/*   Feature (Data,Var,Abs) */
+	0x85, 0x0d,		/*   Report ID (GIGABYTE_MOUSE_PROFILE_REPORT_ID) */
+	0x95, 0x3f,		/*   Report Count (63) */
+	0x09, 0x03,		/*   Usage (3) */
+	0xb1, 0x02,		/*   Feature (Data,Var,Abs) */
+	0xc0,			/* End Collection */
+};
+
+namespace {
+
+[[noreturn]] void throw_errno(const char *what)
+{
+	throw std::system_error(errno, std::generic_category(), what);
+}
+
+void uhid_write(int fd, const uhid_event &ev)
+{
+	ssize_t ret;
+
+	do {
+		ret = write(fd, &ev, sizeof(ev));
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		throw_errno("uhid write");
+}
+
+} // namespace
+
+UhidDevice::UhidDevice(const std::string &name, const std::string &uniq,
+		       std::uint16_t bus, std::uint16_t vendor, std::uint16_t product,
+		       const std::vector<std::uint8_t> &descriptor)
+	: uniq_(uniq)
+{
+	uhid_event ev{};
+
+	if (descriptor.size() > sizeof(ev.u.create2.rd_data))
+		throw std::invalid_argument("report descriptor too large");
+
+	fd_ = open("/dev/uhid", O_RDWR | O_CLOEXEC);
+	if (fd_ < 0)
+		throw_errno("/dev/uhid");
+
+	ev.type = UHID_CREATE2;
+	std::strncpy(reinterpret_cast<char *>(ev.u.create2.name), name.c_str(),
+		     sizeof(ev.u.create2.name) - 1);
+	std::strncpy(reinterpret_cast<char *>(ev.u.create2.uniq), uniq.c_str(),
+		     sizeof(ev.u.create2.uniq) - 1);
+	ev.u.create2.rd_size = static_cast<std::uint16_t>(descriptor.size());
+	ev.u.create2.bus = bus;
+	ev.u.create2.vendor = vendor;
+	ev.u.create2.product = product;
+	std::memcpy(ev.u.create2.rd_data, descriptor.data(), descriptor.size());
+	uhid_write(fd_, ev);
+}
+
+UhidDevice::~UhidDevice()
+{
+	if (fd_ >= 0) {
+		uhid_event ev{};
+
+		ev.type = UHID_DESTROY;
+		(void)write(fd_, &ev, sizeof(ev));
+		close(fd_);
+	}
+}
+
+void UhidDevice::wait_started(int timeout_ms)
+{
+	pollfd pfd = { fd_, POLLIN, 0 };
+
+	for (;;) {
+		uhid_event ev{};
+		int ret = poll(&pfd, 1, timeout_ms);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			throw_errno("uhid poll");
+		if (ret == 0)
+			throw std::runtime_error("uhid device was not started");
+		if (read(fd_, &ev, sizeof(ev)) < 0)
+			throw_errno("uhid read");
+		if (ev.type == UHID_START)
+			return;
+	}
+}
+
+void UhidDevice::input(const std::uint8_t *data, std::size_t size)
+{
+	uhid_event ev{};
+
+	if (size > sizeof(ev.u.input2.data))
+		throw std::invalid_argument("report too large");
+	ev.type = UHID_INPUT2;
+	ev.u.input2.size = static_cast<std::uint16_t>(size);
+	std::memcpy(ev.u.input2.data, data, size);
+	uhid_write(fd_, ev);
+}
+
+void UhidDevice::serve_reports(int stop_fd, const GetReport &get, const SetReport &set)
+{
+	pollfd pfds[2] = { { fd_, POLLIN, 0 }, { stop_fd, POLLIN, 0 } };
+
+	for (;;) {
+		uhid_event ev{}, reply{};
+		std::vector<std::uint8_t> report;
+
+		if (poll(pfds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			throw_errno("uhid poll");
+		}
+		if (pfds[1].revents)
+			return;
+		if (read(fd_, &ev, sizeof(ev)) < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			throw_errno("uhid read");
+		}
+
+		switch (ev.type) {
+		case UHID_GET_REPORT:
+			reply.type = UHID_GET_REPORT_REPLY;
+			reply.u.get_report_reply.id = ev.u.get_report.id;
+			if (get(ev.u.get_report.rnum, report) &&
+			    report.size() <= sizeof(reply.u.get_report_reply.data)) {
+				reply.u.get_report_reply.size = static_cast<std::uint16_t>(report.size());
+				std::memcpy(reply.u.get_report_reply.data, report.data(), report.size());
+			} else {
+				reply.u.get_report_reply.err = EIO;
+			}
+			uhid_write(fd_, reply);
+			break;
+		case UHID_SET_REPORT:
+			reply.type = UHID_SET_REPORT_REPLY;
+			reply.u.set_report_reply.id = ev.u.set_report.id;
+			if (!set(ev.u.set_report.data, std::min<std::size_t>(ev.u.set_report.size,
+									    sizeof(ev.u.set_report.data))))
+				reply.u.set_report_reply.err = EIO;
+			uhid_write(fd_, reply);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+std::string UhidDevice::sysfs_path() const
+{
+	const std::string base = "/sys/bus/hid/devices";
+	std::string found;
+	DIR *dir = opendir(base.c_str());
+	struct dirent *ent;
+
+	if (!dir)
+		return found;
+	while ((ent = readdir(dir))) {
+		std::string path = base + "/" + ent->d_name;
+		std::ifstream in(path + "/uevent");
+		std::string line;
+
+		if (ent->d_name[0] == '.')
+			continue;
+		while (std::getline(in, line))
+			if (line == "HID_UNIQ=" + uniq_)
+				found = path;
+		if (!found.empty())
+			break;
+	}
+	closedir(dir);
+	return found;
+}
+
+std::vector<std::string> UhidDevice::event_nodes() const
+{
+	std::vector<std::string> nodes;
+	std::string hid = sysfs_path();
+	char real_hid[PATH_MAX];
+	DIR *dir;
+	struct dirent *ent;
+
+	if (hid.empty() || !realpath(hid.c_str(), real_hid))
+		return nodes;
+	dir = opendir("/sys/class/input");
+	if (!dir)
+		return nodes;
+	while ((ent = readdir(dir))) {
+		std::string name = ent->d_name;
+		char real_event[PATH_MAX];
+
+		if (name.rfind("event", 0) != 0)
+			continue;
+		if (!realpath(("/sys/class/input/" + name).c_str(), real_event))
+			continue;
+		/* Input devices created for this hid device live below it in sysfs */
+		if (std::strncmp(real_event, real_hid, std::strlen(real_hid)) == 0 &&
+		    real_event[std::strlen(real_hid)] == '/')
+			nodes.push_back("/dev/input/" + name);
+	}
+	closedir(dir);
+	return nodes;
+}
+
+} // namespace opengigabyte
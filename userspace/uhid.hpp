@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * uhid virtual HID device helper for the benchmarks and replay tool.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+#ifndef OPENGIGABYTE_UHID_HPP
+#define OPENGIGABYTE_UHID_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace opengigabyte {
+
+/*
+ * Report descriptor close to the Gigabyte laptop keyboard interface that
+ * carries the Fn keys: boot keyboard (report 1), consumer control
+ * (report 3) and the vendor Fn report (report 4).
+ */
+extern const std::vector<std::uint8_t> kGigabyteKbdDescriptor;
+
+/*
+ * Five button mouse with 16-bit X/Y and a wheel (report 1), plus the
+ * gigabytemouse settings and profile feature reports.
+ */
+extern const std::vector<std::uint8_t> kGigabyteMouseDescriptor;
+
+class UhidDevice {
+public:
+	UhidDevice(const std::string &name, const std::string &uniq,
+		   std::uint16_t bus, std::uint16_t vendor, std::uint16_t product,
+		   const std::vector<std::uint8_t> &descriptor);
+	~UhidDevice();
+
+	UhidDevice(const UhidDevice &) = delete;
+	UhidDevice &operator=(const UhidDevice &) = delete;
+
+	/* Block until the kernel has started the device (a driver bound) */
+	void wait_started(int timeout_ms);
+
+	/* Inject one input report (report ID included when numbered) */
+	void input(const std::uint8_t *data, std::size_t size);
+
+	/*
+	 * Answer the driver's GET_REPORT and SET_REPORT requests until stop_fd
+	 * becomes readable. get fills in a report (ID included) and set takes
+	 * one; returning false fails the request with EIO.
+	 */
+	using GetReport = std::function<bool(std::uint8_t id, std::vector<std::uint8_t> &report)>;
+	using SetReport = std::function<bool(const std::uint8_t *report, std::size_t size)>;
+	void serve_reports(int stop_fd, const GetReport &get, const SetReport &set);
+
+	/* sysfs path of the hid device, e.g. /sys/bus/hid/devices/0003:1044:7A39.0007 */
+	std::string sysfs_path() const;
+
+	/* /dev/input/eventN nodes whose input device hangs off this hid device */
+	std::vector<std::string> event_nodes() const;
+
+	const std::string &uniq() const { return uniq_; }
+	int fd() const { return fd_; }
+
+private:
+	int fd_ = -1;
+	std::string uniq_;
+};
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_UHID_HPP */
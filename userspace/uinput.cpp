@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * uinput output device for the userspace keyboard driver.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+
+#include "uinput.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace opengigabyte {
+
+namespace {
+
+[[noreturn]] void throw_errno(const char *what)
+{
+	throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace
+
+UinputDevice::UinputDevice(const std::string &name, const std::string &phys,
+			   std::uint16_t vendor, std::uint16_t product,
+			   const std::vector<std::uint16_t> &keycodes)
+{
+	uinput_setup setup{};
+
+	fd_ = open("/dev/uinput", O_WRONLY | O_CLOEXEC);
+	if (fd_ < 0)
+		throw_errno("/dev/uinput");
+
+	/* No EV_REP: repeat would add a uinput timer we don't need */
+	if (ioctl(fd_, UI_SET_EVBIT, EV_KEY) < 0 ||
+	    ioctl(fd_, UI_SET_EVBIT, EV_MSC) < 0 ||
+	    ioctl(fd_, UI_SET_MSCBIT, MSC_SCAN) < 0)
+		throw_errno("uinput event bits");
+	for (std::uint16_t key : keycodes)
+		if (ioctl(fd_, UI_SET_KEYBIT, key) < 0)
+			throw_errno("UI_SET_KEYBIT");
+	if (ioctl(fd_, UI_SET_PHYS, phys.c_str()) < 0)
+		throw_errno("UI_SET_PHYS");
+
+	setup.id.bustype = BUS_USB;
+	setup.id.vendor = vendor;
+	setup.id.product = product;
+	std::strncpy(setup.name, name.c_str(), UINPUT_MAX_NAME_SIZE - 1);
+	if (ioctl(fd_, UI_DEV_SETUP, &setup) < 0)
+		throw_errno("UI_DEV_SETUP");
+	if (ioctl(fd_, UI_DEV_CREATE) < 0)
+		throw_errno("UI_DEV_CREATE");
+}
+
+UinputDevice::~UinputDevice()
+{
+	if (fd_ >= 0) {
+		ioctl(fd_, UI_DEV_DESTROY);
+		close(fd_);
+	}
+}
+
+void UinputDevice::queue(std::uint16_t type, std::uint16_t code, std::int32_t value)
+{
+	if (batched_ == batch_.size())
+		flush();
+	input_event &ev = batch_[batched_++];
+	ev.type = type;
+	ev.code = code;
+	ev.value = value;
+}
+
+void UinputDevice::queue_key(std::uint32_t scancode, std::uint16_t keycode, std::int32_t value)
+{
+	queue(EV_MSC, MSC_SCAN, static_cast<std::int32_t>(scancode));
+	queue(EV_KEY, keycode, value);
+	queue(EV_SYN, SYN_REPORT, 0);
+}
+
+void UinputDevice::flush()
+{
+	std::size_t len = batched_ * sizeof(input_event);
+	ssize_t ret;
+
+	if (!batched_)
+		return;
+	do {
+		ret = write(fd_, batch_.data(), len);
+	} while (ret < 0 && errno == EINTR);
+	batched_ = 0;
+	if (ret < 0)
+		throw_errno("uinput write");
+}
+
+} // namespace opengigabyte
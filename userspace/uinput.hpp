@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * uinput output device for the userspace keyboard driver.
+ * Copyright (c) 2020 Hemanth Bollamreddi
+ */
+#ifndef OPENGIGABYTE_UINPUT_HPP
+#define OPENGIGABYTE_UINPUT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <linux/input.h>
+
+namespace opengigabyte {
+
+class UinputDevice {
+public:
+	UinputDevice(const std::string &name, const std::string &phys,
+		     std::uint16_t vendor, std::uint16_t product,
+		     const std::vector<std::uint16_t> &keycodes);
+	~UinputDevice();
+
+	UinputDevice(const UinputDevice &) = delete;
+	UinputDevice &operator=(const UinputDevice &) = delete;
+
+	/* Queue an event; SYN_REPORT frames are only written by flush() */
+	void queue(std::uint16_t type, std::uint16_t code, std::int32_t value);
+	void queue_key(std::uint32_t scancode, std::uint16_t keycode, std::int32_t value);
+
+	/* Write every queued frame with a single write(2) */
+	void flush();
+
+private:
+	int fd_ = -1;
+	std::array<input_event, 16> batch_{};
+	std::size_t batched_ = 0;
+};
+
+} // namespace opengigabyte
+
+#endif /* OPENGIGABYTE_UINPUT_HPP */